@@ -1,8 +1,13 @@
 #include "aes.h"
 
+// define AES128_FLASH_RKEYS if the round keys of K||K' are provisioned in flash
 cipher_ctx_t aes128_get_cipher_ctx() {
     cipher_ctx_t ctx = {
+#if defined(AES128_FLASH_RKEYS)
+        .kexpand = NULL,    // round keys read from flash (.rodata) as is
+#else
         .kexpand = aes128_keyschedule_sfs_lut,
+#endif
         .encrypt = aes128_encrypt_sfs,
         .rkeys_size = sizeof(aes128_roundkeys_t),
     };
@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// encrypt processes two blocks at once (see cymric-shape.h)
+#define CIPHER_CTX_ENCRYPT_2BLOCKS
+
 typedef struct {
     void* roundkeys;
     void (*encrypt)(uint8_t*, uint8_t*, const uint8_t*, const uint8_t*, const void*);
@@ -0,0 +1,143 @@
+/**
+ * @file cymric-pair.c
+ *
+ * @brief Cymric1 and Cymric2 over pairs of messages so that no slot of the
+ * two-block AES is wasted: Y0 and Y1 of each message take one call under K,
+ * and both tags share a single call under K', i.e. 1.5 two-block calls per
+ * message instead of 2. When the key is expanded online, K and K' are also
+ * expanded once per pair instead of once per message.
+ *
+ * Cymric1 and Cymric2 only differ by the presence of N in the tag input
+ * pad(N||M) vs pad(M), so both are implemented by the same routines where
+ * `cymric1` tells whether N is prepended to M.
+ */
+#include <string.h>
+#include "cymric-pair.h"
+#include "cymric-common.h"
+#include "cymric-trace.h"
+
+#define CYMRIC_PAIR_ENC 0
+#define CYMRIC_PAIR_DEC 1
+
+static void pair_process(cymric_pair_msg_t msg[2],
+            const uint8_t k[],
+            const cipher_ctx_t* ctx,
+            int variant, int dir)
+{
+    uint8_t tmp[2*BLOCKBYTES];
+    uint8_t* y0 = tmp + 1*BLOCKBYTES;
+    uint8_t* y1 = tmp + 0*BLOCKBYTES;
+    uint8_t tag[2][BLOCKBYTES] = {{0x00}};
+    size_t mlen[2];
+    unsigned int i, valid = 0;
+
+    // compute round keys if online key expansion is required
+    if (ctx->kexpand != NULL)
+        ctx->kexpand(ctx->roundkeys, k);
+
+    for (i = 0; i < 2; i++) {
+        cymric_pair_msg_t* p = &msg[i];
+        size_t off = (variant == 1) ? p->nlen : 0;
+        const uint8_t* m;
+
+        if (dir == CYMRIC_PAIR_ENC)
+            CYMRIC_TRACE_ENTRY(enc_entry, variant, p->nlen, p->inlen, p->alen, k);
+        else
+            CYMRIC_TRACE_ENTRY(dec_entry, variant, p->nlen, p->inlen, p->alen, k);
+
+        mlen[i] = (dir == CYMRIC_PAIR_ENC) ? p->inlen : p->inlen - TAGBYTES;
+        if ((dir == CYMRIC_PAIR_DEC && p->inlen < TAGBYTES) ||
+            mlen[i] + off > BLOCKBYTES || p->nlen + p->alen > BLOCKBYTES - 1) {
+            p->outlen = 0;
+            p->ret    = -1;
+            continue;
+        }
+        valid |= 1u << i;
+
+        // Y0 <- E_K(padn(N||A||b0)) and Y1 <- E_K(padn(N||A||b1)) in parallel
+        concat_block(tmp, p->n, p->nlen, p->a, p->alen);
+        tmp[p->nlen + p->alen] = ((mlen[i] + off == BLOCKBYTES) << 7) | 0x20;
+        memcpy(tmp + BLOCKBYTES, tmp, BLOCKBYTES);
+        tmp[BLOCKBYTES + p->nlen + p->alen] |= 0x40;
+        if (ctx->kexpand != NULL)
+            ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, ctx->roundkeys);
+        else
+            ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, k);
+
+        // C <- M ^ Y0 ^ Y1 (resp. M <- C ^ Y0 ^ Y1)
+        xor_bytes(p->out, y0, y1, mlen[i]);
+        xor_bytes(p->out, p->out, p->in, mlen[i]);
+        m = (dir == CYMRIC_PAIR_ENC) ? p->in : p->out;
+
+        // T <- Y0 ^ pad(N[0:off]||M)
+        xor_bytes(tag[i],       y0, p->n, off);
+        xor_bytes(tag[i] + off, y0 + off, m, mlen[i]);
+        memcpy(tag[i] + off + mlen[i], y0 + off + mlen[i], BLOCKBYTES - off - mlen[i]);
+        if (off + mlen[i] != BLOCKBYTES)
+            tag[i][off + mlen[i]] ^= 0x80;
+    }
+
+    // T = msb(E_K'(T)) for both messages at once
+    if (valid == 0)
+        return;
+    if (ctx->kexpand != NULL) {
+        ctx->kexpand(ctx->roundkeys, k + KEYBYTES);
+        ctx->encrypt(tag[0], tag[1], tag[0], tag[1], ctx->roundkeys);
+    }
+    else
+        ctx->encrypt(tag[0], tag[1], tag[0], tag[1], k + ctx->rkeys_size);
+
+    for (i = 0; i < 2; i++) {
+        cymric_pair_msg_t* p = &msg[i];
+
+        if (!((valid >> i) & 1))
+            continue;
+        if (dir == CYMRIC_PAIR_ENC) {
+            memcpy(p->out + mlen[i], tag[i], TAGBYTES);
+            p->outlen = mlen[i] + TAGBYTES;
+            p->ret    = 0;
+            CYMRIC_TRACE_RETURN(enc_return, variant, p->outlen, 0);
+        }
+        else if (sec_memcmp(tag[i], p->in + mlen[i], TAGBYTES) != 0) {
+            // do not release plaintext if erroneous tag
+            memset(p->out, 0x00, mlen[i]);
+            p->outlen = 0;
+            p->ret    = 1;
+            CYMRIC_TRACE_TAG_FAIL(variant, p->nlen, mlen[i], p->alen, k);
+            CYMRIC_TRACE_RETURN(dec_return, variant, 0, 1);
+        }
+        else {
+            p->outlen = mlen[i];
+            p->ret    = 0;
+            CYMRIC_TRACE_RETURN(dec_return, variant, p->outlen, 0);
+        }
+    }
+}
+
+void cymric1_enc_x2(cymric_pair_msg_t msg[2],
+            const uint8_t k[],
+            const cipher_ctx_t* ctx)
+{
+    pair_process(msg, k, ctx, 1, CYMRIC_PAIR_ENC);
+}
+
+void cymric1_dec_x2(cymric_pair_msg_t msg[2],
+            const uint8_t k[],
+            const cipher_ctx_t* ctx)
+{
+    pair_process(msg, k, ctx, 1, CYMRIC_PAIR_DEC);
+}
+
+void cymric2_enc_x2(cymric_pair_msg_t msg[2],
+            const uint8_t k[],
+            const cipher_ctx_t* ctx)
+{
+    pair_process(msg, k, ctx, 2, CYMRIC_PAIR_ENC);
+}
+
+void cymric2_dec_x2(cymric_pair_msg_t msg[2],
+            const uint8_t k[],
+            const cipher_ctx_t* ctx)
+{
+    pair_process(msg, k, ctx, 2, CYMRIC_PAIR_DEC);
+}
@@ -0,0 +1,71 @@
+#ifndef CYMRIC_PAIR_H_
+#define CYMRIC_PAIR_H_
+
+#include <stdint.h>
+#include "cymric.h"
+
+/**
+ * Message of a pair processed at once. Each message has its own nonce,
+ * associated data and result, only the key is shared.
+ */
+typedef struct {
+    const uint8_t* n;       // nonce
+    size_t nlen;
+    const uint8_t* a;       // additional data
+    size_t alen;
+    const uint8_t* in;      // message (resp. ciphertext) to encrypt (resp. decrypt)
+    size_t inlen;
+    uint8_t* out;           // ciphertext (resp. plaintext), see cymric*_enc/cymric*_dec
+    size_t outlen;
+    int ret;                // same as cymric*_enc/cymric*_dec
+} cymric_pair_msg_t;
+
+/**
+ * @brief Authenticated encryption of two messages using Cymric1, where the
+ * two tag blocks are encrypted by a single two-block call under K'.
+ *
+ * @param msg The two messages, whose outlen and ret are set on return
+ * @param k The encryption key
+ * @param ctx The cipher context
+ */
+void cymric1_enc_x2(cymric_pair_msg_t msg[2],
+        const uint8_t k[],
+        const cipher_ctx_t* ctx);
+
+/**
+ * @brief Authenticated decryption of two messages using Cymric1, where the
+ * two tag blocks are encrypted by a single two-block call under K'.
+ *
+ * @param msg The two messages, whose outlen and ret are set on return
+ * @param k The encryption key
+ * @param ctx The cipher context
+ */
+void cymric1_dec_x2(cymric_pair_msg_t msg[2],
+        const uint8_t k[],
+        const cipher_ctx_t* ctx);
+
+/**
+ * @brief Authenticated encryption of two messages using Cymric2, where the
+ * two tag blocks are encrypted by a single two-block call under K'.
+ *
+ * @param msg The two messages, whose outlen and ret are set on return
+ * @param k The encryption key
+ * @param ctx The cipher context
+ */
+void cymric2_enc_x2(cymric_pair_msg_t msg[2],
+        const uint8_t k[],
+        const cipher_ctx_t* ctx);
+
+/**
+ * @brief Authenticated decryption of two messages using Cymric2, where the
+ * two tag blocks are encrypted by a single two-block call under K'.
+ *
+ * @param msg The two messages, whose outlen and ret are set on return
+ * @param k The encryption key
+ * @param ctx The cipher context
+ */
+void cymric2_dec_x2(cymric_pair_msg_t msg[2],
+        const uint8_t k[],
+        const cipher_ctx_t* ctx);
+
+#endif
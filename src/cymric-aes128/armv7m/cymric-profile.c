@@ -0,0 +1 @@
+../../cymric/cymric-profile.c
\ No newline at end of file
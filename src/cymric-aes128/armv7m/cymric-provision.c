@@ -0,0 +1 @@
+../../cymric/cymric-provision.c
\ No newline at end of file
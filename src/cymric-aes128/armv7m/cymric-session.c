@@ -0,0 +1,200 @@
+/**
+ * @file cymric-session.c
+ *
+ * @brief Cymric1 and Cymric2 for counter-based nonces and a fixed associated
+ * data, where padn(N||A||b) is prebuilt once and updated in place.
+ *
+ * Cymric1 and Cymric2 only differ by the presence of N in the tag input
+ * pad(N||M) vs pad(M), so both are implemented by the same routines where
+ * `off` is the number of nonce bytes prepended to M (i.e. nlen or 0).
+ */
+#include <string.h>
+#include "cymric-session.h"
+#include "cymric-common.h"
+#include "cymric-trace.h"
+
+int cymric_session_init(cymric_session_t* s,
+            const uint8_t k[],
+            const uint8_t n[], size_t nlen,
+            size_t ctr_off, size_t ctr_len,
+            const uint8_t a[], size_t alen,
+            const cipher_ctx_t* ctx)
+{
+    if (nlen + alen > BLOCKBYTES - 1)
+        return -1;
+    if (ctr_len == 0 || ctr_off + ctr_len > nlen)
+        return -1;
+
+    memset(s->blk, 0x00, 2*BLOCKBYTES);
+    memcpy(s->blk,        n, nlen);
+    memcpy(s->blk + nlen, a, alen);
+    memcpy(s->blk + BLOCKBYTES, s->blk, BLOCKBYTES);
+    s->k         = k;
+    s->ctx       = ctx;
+    s->nlen      = nlen;
+    s->alen      = alen;
+    s->ctr_off   = ctr_off;
+    s->ctr_len   = ctr_len;
+    s->exhausted = 0;
+    return 0;
+}
+
+/**
+ * @brief Increment the big-endian counter field of the nonce in place in both
+ * templates.
+ */
+static void session_incr(cymric_session_t* s)
+{
+    uint8_t* ctr0 = s->blk + s->ctr_off;
+    uint8_t* ctr1 = s->blk + BLOCKBYTES + s->ctr_off;
+    unsigned int i = s->ctr_len;
+
+    while (i--) {
+        ctr1[i] = ++ctr0[i];
+        if (ctr0[i] != 0x00)
+            return;
+    }
+    s->exhausted = 1;
+}
+
+/**
+ * @brief Y0 <- E_K(padn(N||A||b0)) and Y1 <- E_K(padn(N||A||b1)) in parallel
+ * where only the flag bytes of the templates are updated.
+ */
+static void session_mask(cymric_session_t* s,
+            uint8_t y0[], uint8_t y1[], uint8_t b)
+{
+    const cipher_ctx_t* ctx = s->ctx;
+    uint8_t* flag = s->blk + s->nlen + s->alen;
+
+    // compute round keys if online key expansion is required
+    if (ctx->kexpand != NULL)
+        ctx->kexpand(ctx->roundkeys, s->k);
+
+    flag[0]          = b | 0x20;
+    flag[BLOCKBYTES] = b | 0x60;
+    if (ctx->kexpand != NULL)
+        ctx->encrypt(y0, y1, s->blk, s->blk + BLOCKBYTES, ctx->roundkeys);
+    else
+        ctx->encrypt(y0, y1, s->blk, s->blk + BLOCKBYTES, s->k);
+}
+
+/**
+ * @brief T <- msb(E_K'(Y0 ^ pad(N[0:off]||M))) computed in place over Y0.
+ */
+static void session_tag(cymric_session_t* s,
+            uint8_t y0[], const uint8_t m[], size_t mlen, size_t off)
+{
+    const cipher_ctx_t* ctx = s->ctx;
+
+    xor_bytes(y0,       y0, s->blk, off);
+    xor_bytes(y0 + off, y0 + off, m, mlen);
+    if (off + mlen != BLOCKBYTES)
+        y0[off + mlen] ^= 0x80;
+
+    if (ctx->kexpand != NULL) {
+        ctx->kexpand(ctx->roundkeys, s->k + KEYBYTES);
+        ctx->encrypt(y0, y0, y0, y0, ctx->roundkeys);
+    }
+    else
+        ctx->encrypt(y0, y0, y0, y0, s->k + ctx->rkeys_size);
+}
+
+static int session_enc(cymric_session_t* s,
+            uint8_t c[], size_t *clen,
+            const uint8_t m[], size_t mlen,
+            size_t off, int variant)
+{
+    uint8_t tmp[2*BLOCKBYTES];
+    uint8_t* y0 = tmp + 1*BLOCKBYTES;
+    uint8_t* y1 = tmp + 0*BLOCKBYTES;
+
+    CYMRIC_TRACE_ENTRY(enc_entry, variant, s->nlen, mlen, s->alen, s->k);
+
+    if (s->exhausted || mlen + off > BLOCKBYTES) {
+        CYMRIC_TRACE_RETURN(enc_return, variant, 0, -1);
+        return -1;
+    }
+
+    session_mask(s, y0, y1, (mlen + off == BLOCKBYTES) << 7);
+
+    // C <- M ^ Y0 ^ Y1
+    xor_bytes(c, y0, y1, mlen);
+    xor_bytes(c,  c,  m, mlen);
+
+    session_tag(s, y0, m, mlen, off);
+    memcpy(c + mlen, y0, TAGBYTES);
+    session_incr(s);
+
+    *clen = mlen + TAGBYTES;
+    CYMRIC_TRACE_RETURN(enc_return, variant, *clen, 0);
+    return 0;
+}
+
+static int session_dec(cymric_session_t* s,
+            uint8_t m[], size_t *mlen,
+            const uint8_t c[], size_t clen,
+            size_t off, int variant)
+{
+    uint8_t tmp[2*BLOCKBYTES];
+    uint8_t* y0 = tmp + 1*BLOCKBYTES;
+    uint8_t* y1 = tmp + 0*BLOCKBYTES;
+
+    CYMRIC_TRACE_ENTRY(dec_entry, variant, s->nlen, clen, s->alen, s->k);
+
+    if (s->exhausted || clen < TAGBYTES || clen - TAGBYTES + off > BLOCKBYTES) {
+        CYMRIC_TRACE_RETURN(dec_return, variant, 0, -1);
+        return -1;
+    }
+    clen -= TAGBYTES;
+
+    session_mask(s, y0, y1, (clen + off == BLOCKBYTES) << 7);
+
+    // M <- C ^ Y0 ^ Y1
+    xor_bytes(m, y0, y1, clen);
+    xor_bytes(m,  m,  c, clen);
+
+    session_tag(s, y0, m, clen, off);
+
+    // do not release plaintext if erroneous tag
+    if (sec_memcmp(y0, c + clen, TAGBYTES) != 0) {
+        memset(m, 0x00, clen);
+        *mlen = 0;
+        CYMRIC_TRACE_TAG_FAIL(variant, s->nlen, clen, s->alen, s->k);
+        CYMRIC_TRACE_RETURN(dec_return, variant, 0, 1);
+        return 1;
+    }
+    session_incr(s);
+
+    *mlen = clen;
+    CYMRIC_TRACE_RETURN(dec_return, variant, *mlen, 0);
+    return 0;
+}
+
+int cymric1_session_enc(cymric_session_t* s,
+            uint8_t c[], size_t *clen,
+            const uint8_t m[], size_t mlen)
+{
+    return session_enc(s, c, clen, m, mlen, s->nlen, 1);
+}
+
+int cymric1_session_dec(cymric_session_t* s,
+            uint8_t m[], size_t *mlen,
+            const uint8_t c[], size_t clen)
+{
+    return session_dec(s, m, mlen, c, clen, s->nlen, 1);
+}
+
+int cymric2_session_enc(cymric_session_t* s,
+            uint8_t c[], size_t *clen,
+            const uint8_t m[], size_t mlen)
+{
+    return session_enc(s, c, clen, m, mlen, 0, 2);
+}
+
+int cymric2_session_dec(cymric_session_t* s,
+            uint8_t m[], size_t *mlen,
+            const uint8_t c[], size_t clen)
+{
+    return session_dec(s, m, mlen, c, clen, 0, 2);
+}
@@ -24,6 +24,8 @@
 #include <string.h>
 #include "cymric.h"
 #include "cymric-common.h"
+#include "cymric-profile.h"
+#include "cymric-trace.h"
 
 int cymric1_enc(uint8_t c[], size_t *clen,
             const uint8_t k[],
@@ -32,58 +34,65 @@ int cymric1_enc(uint8_t c[], size_t *clen,
             const uint8_t a[], size_t alen,
             const cipher_ctx_t* ctx)
 {
-    uint8_t tmp[2*BLOCKBYTES] = {0x00};
+    uint8_t tmp[2*BLOCKBYTES];
     uint8_t* y0 = tmp + 1*BLOCKBYTES;
     uint8_t* y1 = tmp + 0*BLOCKBYTES;
     uint8_t b = 0x00;
 
+    CYMRIC_TRACE_ENTRY(enc_entry, 1, nlen, mlen, alen, k);
+
     // check inputs' validity
-    if (mlen + nlen > BLOCKBYTES)
-        return -1;
-    if (nlen + alen > BLOCKBYTES - 1)
+    if (mlen + nlen > BLOCKBYTES || nlen + alen > BLOCKBYTES - 1) {
+        CYMRIC_TRACE_RETURN(enc_return, 1, 0, -1);
         return -1;
+    }
 
     // if |N|+|M|== n then b=1, else b=0
     b = (mlen + nlen == BLOCKBYTES) << 7;
 
+    CYMRIC_PROF_BEGIN(CYMRIC_PROF_CYMRIC1_ENC);
+
     // compute round keys if online key expansion is required
     if (ctx->kexpand != NULL)
         ctx->kexpand(ctx->roundkeys, k);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_KEXPAND);
 
     // Y0 <- E_K(padn(N||A||b0)) and Y1 <- E_K(padn(N||A||b1)) in parallel
-    memcpy(tmp,        n, nlen);
-    memcpy(tmp + nlen, a, alen);
+    concat_block(tmp, n, nlen, a, alen);
     tmp[nlen + alen] = b | 0x20;
-    memcpy(tmp + BLOCKBYTES, tmp, nlen + alen + 1);
+    memcpy(tmp + BLOCKBYTES, tmp, BLOCKBYTES);
     tmp[BLOCKBYTES + nlen + alen] |= 0x40;
     if (ctx->kexpand != NULL)
         ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, ctx->roundkeys);
     else
         ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, k);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_ENCRYPT);
 
     // C <- M ^ Y0 ^ Y1
     xor_bytes(c, y0, y1, mlen);
     xor_bytes(c,  c,  m, mlen);
 
     // T <- Y0 ^ pad(N||M)
-    memset(tmp, 0x00, BLOCKBYTES);
-    memcpy(tmp,        n, nlen);
-    memcpy(tmp + nlen, m, mlen);
+    concat_block(tmp, n, nlen, m, mlen);
     if (mlen + nlen != BLOCKBYTES) {
         tmp[nlen + mlen] = 0x80;
     }
     xor_bytes(tmp, y0, tmp, BLOCKBYTES);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_XOR);
 
     // T = msb(E_K'(T))
     if (ctx->kexpand != NULL) {
         ctx->kexpand(ctx->roundkeys, k + KEYBYTES);
+        CYMRIC_PROF_MARK(CYMRIC_PHASE_KEXPAND_TAG);
         ctx->encrypt(tmp, tmp, tmp, tmp, ctx->roundkeys);
     }
     else
         ctx->encrypt(tmp, tmp, tmp, tmp, k + ctx->rkeys_size);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_ENCRYPT_TAG);
     memcpy(c + mlen, tmp, TAGBYTES);
 
     *clen = mlen + TAGBYTES;
+    CYMRIC_TRACE_RETURN(enc_return, 1, *clen, 0);
     return 0;
 }
 
@@ -94,64 +103,80 @@ int cymric1_dec(uint8_t m[], size_t *mlen,
             const uint8_t a[], size_t alen,
             const cipher_ctx_t* ctx)
 {
-    uint8_t tmp[2*BLOCKBYTES] = {0x00};
+    uint8_t tmp[2*BLOCKBYTES];
     uint8_t* y0 = tmp + 1*BLOCKBYTES;
     uint8_t* y1 = tmp + 0*BLOCKBYTES;
     uint8_t b = 0x00;
 
-    clen -= TAGBYTES;
+    CYMRIC_TRACE_ENTRY(dec_entry, 1, nlen, clen, alen, k);
 
-    if (clen + nlen > BLOCKBYTES)
+    // a ciphertext shorter than the tag would wrap around below
+    if (clen < TAGBYTES) {
+        CYMRIC_TRACE_RETURN(dec_return, 1, 0, -1);
         return -1;
-    if (nlen + alen > BLOCKBYTES - 1)
+    }
+    clen -= TAGBYTES;
+
+    if (clen + nlen > BLOCKBYTES || nlen + alen > BLOCKBYTES - 1) {
+        CYMRIC_TRACE_RETURN(dec_return, 1, 0, -1);
         return -1;
+    }
 
     // if |N|+|M|== n then b=1, else b=0
     b = (clen + nlen == BLOCKBYTES) << 7;
 
+    CYMRIC_PROF_BEGIN(CYMRIC_PROF_CYMRIC1_DEC);
+
     // compute round keys if online key expansion is required
     if (ctx->kexpand != NULL)
         ctx->kexpand(ctx->roundkeys, k);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_KEXPAND);
 
     // Y0 <- E_K(padn(N||A||b0)) and Y1 <- E_K(padn(N||A||b1)) in parallel
-    memcpy(tmp,        n, nlen);
-    memcpy(tmp + nlen, a, alen);
+    concat_block(tmp, n, nlen, a, alen);
     tmp[nlen + alen] = b | 0x20;
-    memcpy(tmp + BLOCKBYTES, tmp, nlen + alen + 1);
+    memcpy(tmp + BLOCKBYTES, tmp, BLOCKBYTES);
     tmp[BLOCKBYTES + nlen + alen] |= 0x40;
     if (ctx->kexpand != NULL)
         ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, ctx->roundkeys);
     else
         ctx->encrypt(y0, y1, tmp, tmp + BLOCKBYTES, k);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_ENCRYPT);
 
     // M <- C ^ Y0 ^ Y1
     xor_bytes(m, y0, y1, clen);
     xor_bytes(m,  m,  c, clen);
 
     // T <- Y0 ^ pad(N||M)
-    memset(tmp, 0x00, BLOCKBYTES);
-    memcpy(tmp,        n, nlen);
-    memcpy(tmp + nlen, m, clen);
+    concat_block(tmp, n, nlen, m, clen);
     if (clen + nlen != BLOCKBYTES) {
         tmp[nlen + clen] = 0x80;
     }
     xor_bytes(tmp, y0, tmp, BLOCKBYTES);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_XOR);
 
     // T = msb(E_K'(T))
     if (ctx->kexpand != NULL) {
         ctx->kexpand(ctx->roundkeys, k + KEYBYTES);
+        CYMRIC_PROF_MARK(CYMRIC_PHASE_KEXPAND_TAG);
         ctx->encrypt(tmp, tmp, tmp, tmp, ctx->roundkeys);
     }
     else
         ctx->encrypt(tmp, tmp, tmp, tmp, k + ctx->rkeys_size);
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_ENCRYPT_TAG);
 
     // do not release plaintext if erroneous tag
     if (sec_memcmp(tmp, c + clen, TAGBYTES) != 0) {
         memset(m, 0x00, clen);
         *mlen = 0;
+        CYMRIC_PROF_MARK(CYMRIC_PHASE_VERIFY);
+        CYMRIC_TRACE_TAG_FAIL(1, nlen, clen, alen, k);
+        CYMRIC_TRACE_RETURN(dec_return, 1, 0, 1);
         return 1;
     }
+    CYMRIC_PROF_MARK(CYMRIC_PHASE_VERIFY);
     
     *mlen = clen;
+    CYMRIC_TRACE_RETURN(dec_return, 1, *mlen, 0);
     return 0;
 }
@@ -1,11 +1,28 @@
 #include "rijndaelfast.h"
 
 cipher_ctx_t aes128_get_cipher_ctx(void) {
+#if defined(AES128_OTF)
+	cipher_ctx_t ctx = {
+		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))encrypt_data_otf,
+		.encrypt_x2 = NULL,
+		.kexpand = NULL,	// key is expanded on-the-fly => no kexpand func
+		.rkeys_size = 16,	// key is expanded on-the-fly => rkeys = key
+	};
+#elif defined(AES128_FLASH_RKEYS)
+	cipher_ctx_t ctx = {
+		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))encrypt_data_P,
+		.encrypt_x2 = NULL,
+		.kexpand = NULL,	// round keys of K||K' provisioned in program memory
+		.rkeys_size = sizeof(aes128_roundkeys_t),
+	};
+#else
 	cipher_ctx_t ctx = {
 		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))encrypt_data,
+		.encrypt_x2 = (void (*)(uint8_t*, uint8_t*, const uint8_t*, const uint8_t*, const void*))encrypt_data_x2,
 		.kexpand = (void (*)(void *, const uint8_t *))expand_key,
 		.rkeys_size = sizeof(aes128_roundkeys_t),
 	};
+#endif
 	return ctx;
 }
 
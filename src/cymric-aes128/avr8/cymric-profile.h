@@ -0,0 +1 @@
+../../cymric/cymric-profile.h
\ No newline at end of file
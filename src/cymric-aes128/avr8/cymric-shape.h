@@ -0,0 +1 @@
+../../cymric/cymric-shape.h
\ No newline at end of file
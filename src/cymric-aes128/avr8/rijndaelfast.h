@@ -9,5 +9,8 @@ cipher_ctx_t aes128_get_cipher_ctx(void);
 
 void expand_key(unsigned char *rkeys, const unsigned char* key);
 void encrypt_data(unsigned char * out, const unsigned char *in, const unsigned char *expanded);
+void encrypt_data_x2(unsigned char *out0, unsigned char *out1, const unsigned char *in0, const unsigned char *in1, const unsigned char *expanded);
+void encrypt_data_otf(unsigned char *out, const unsigned char *in, const unsigned char *key);
+void encrypt_data_P(unsigned char *out, const unsigned char *in, const unsigned char *expanded);
 
 #endif
\ No newline at end of file
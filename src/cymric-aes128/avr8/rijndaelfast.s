@@ -140,6 +140,8 @@
 #define ARG1 r24
 #define ARG2 r22
 #define ARG3 r20
+#define ARG4 r18
+#define ARG5 r16
 
 
 /**
@@ -272,26 +274,64 @@ encrypt_data:
 	ret
 	.size encrypt_data, .-encrypt_data
 
+; Encrypts two blocks under the same expanded key within a single call, so
+; that registers are saved and restored once. The state fills r0-r15 and the
+; round function uses the remaining scratch registers, hence the two blocks
+; are encrypted one after the other: keeping the second state in SRAM would
+; cost more than the round-key loads it saves (each round-key byte is fused
+; into the round by a "ldd" replacing a "mov").
+; Each output may overlap its own input, but not the other input.
+.global encrypt_data_x2
+encrypt_data_x2:
+	; Save registers r2-17,r28-29
+	push_registers 2,17
+	push_registers 28,29
+
+	; Pointers to the 1st plaintext (Z), the 2nd one (X) and the key (Y)
+	movw ZL, ARG3
+	movw XL, ARG4
+	movw YL, ARG5
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+	ld \param, Z+
+	.endr
+
+	rcall encrypt
+
+	movw ZL, ARG1
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+		st Z+, \param
+	.endr
+	; Rewind Y to the first round key for the 2nd block
+	subi YL, lo8(11*16)
+	sbci YH, hi8(11*16)
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+	ld \param, X+
+	.endr
+
+	rcall encrypt
+
+	movw ZL, ARG2
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+		st Z+, \param
+	.endr
+	; Restore registers r2-17,r28-29
+	pop_registers 28,29
+	pop_registers 2,17
+	clr r1
+	ret
+	.size encrypt_data_x2, .-encrypt_data_x2
+
 
 ;;; ***************************************************************************
 ;;; 
-;;; ENCRYPT 
-;;; This routine encrypts a 128 bit plaintext block (supplied in ST11-ST44), 
-;;; using an expanded key given in YH:YL. The resulting 128 bit ciphertext
-;;; block is stored in ST11-ST44.
-;;;
-;;; Parameters:
-;;;         YH:YL:	pointer to expanded key
-;;;         ST11-ST44:  128 bit plaintext block
-;;; Touched registers:
-;;;     ST11-ST41,H1-H5,I,ZH,ZL,YH,YL
-;;; Clock cycles:	2474
-		
-encrypt:
-	rcall encryp1
-	ldi ZH, hi8(sbox)
-	ldi I, 8
-encryp0:mov ZL, ST11		; 1
+;;; AES_ROUND / AES_LAST_ROUND
+;;; One round (resp. the last round, without MixColumns) of the encryption,
+;;; shared by the routines using precomputed and on-the-fly round keys. The
+;;; round key is read at YH:YL (aes_last_round does not add it), and ZH must
+;;; hold hi8(sbox) on entry. ZH holds hi8(sbox) on exit.
+
+.macro aes_round
+	mov ZL, ST11		; 1
 	ld H2, Z
 	mov H3, H2
 	mov H4, H2
@@ -464,11 +504,9 @@ encryp0:mov ZL, ST11		; 1
 	eor ST34, H3
 	ldd ST44, Y+15
 	eor ST44, H4
-	adiw Y, 16
-	dec I
-	sbrs I,7
-	jmp encryp0
-	; Omit MixColumns for the last round
+.endm
+
+.macro aes_last_round
 	mov ZL, ST11
 	ld ST11, Z
 	mov ZL, ST12
@@ -505,6 +543,35 @@ encryp0:mov ZL, ST11		; 1
 	ld ST43, Z
 	mov ZL, H1
 	ld ST42, Z
+.endm
+
+
+;;; ***************************************************************************
+;;; 
+;;; ENCRYPT 
+;;; This routine encrypts a 128 bit plaintext block (supplied in ST11-ST44), 
+;;; using an expanded key given in YH:YL. The resulting 128 bit ciphertext
+;;; block is stored in ST11-ST44.
+;;;
+;;; Parameters:
+;;;         YH:YL:	pointer to expanded key
+;;;         ST11-ST44:  128 bit plaintext block
+;;; Touched registers:
+;;;     ST11-ST41,H1-H5,I,ZH,ZL,YH,YL
+;;; Clock cycles:	2474
+		
+encrypt:
+	rcall encryp1
+	ldi ZH, hi8(sbox)
+	ldi I, 8
+encryp0:
+	aes_round
+	adiw Y, 16
+	dec I
+	sbrs I,7
+	jmp encryp0
+	; Omit MixColumns for the last round
+	aes_last_round
 	encryp1:
 		; AddRoundKey
 		ld H1, Y+
@@ -542,6 +609,236 @@ encryp0:mov ZL, ST11		; 1
 		ret
 		.size encrypt, .-encrypt
 
+
+; Same as encrypt_data, except that the round keys are derived on-the-fly
+; from the 128-bit key during the encryption, so that no expanded key is
+; needed: the key is copied to the stack and updated in place round by round.
+.global encrypt_data_otf
+encrypt_data_otf:
+	; Save registers r2-17,r28-29
+	push_registers 2,17
+	push_registers 28,29
+
+	; Copy the key (ARG3) to 16 bytes of stack pointed by Y
+	movw XL, ARG3
+	adiw XL, 16
+	.rept 16
+	ld H1, -X
+	push H1
+	.endr
+	in YL, 0x3d
+	in YH, 0x3e
+	adiw YL, 1
+	; Load the plaintext given by argument to register 0-15
+	movw XL, ARG2
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+	ld \param, X+
+	.endr
+
+	rcall encrypt_otf
+
+	; Release the key copy
+	adiw YL, 15
+	in H1, 0x3f
+	cli
+	out 0x3e, YH
+	out 0x3f, H1
+	out 0x3d, YL
+	; Save the final state from the registers to Y (ARG1)
+	movw YL, ARG1
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+		st Y+, \param
+	.endr
+	; Restore registers r2-17,r28-29
+	pop_registers 28,29
+	pop_registers 2,17
+	clr r1
+	ret
+	.size encrypt_data_otf, .-encrypt_data_otf
+
+
+;;; ***************************************************************************
+;;; 
+;;; ENCRYPT_OTF 
+;;; Same as encrypt, except that YH:YL points to the 128-bit key which is
+;;; overwritten by the successive round keys (see next_round_key).
+;;;
+;;; Parameters:
+;;;         YH:YL:	pointer to the key (16 bytes, overwritten)
+;;;         ST11-ST44:  128 bit plaintext block
+;;; Touched registers:
+;;;     ST11-ST41,H1-H5,I,RC,ZH,ZL
+;;; Clock cycles:	those of encrypt + 1055 (10 calls to next_round_key)
+
+#define RC r23
+
+encrypt_otf:
+	rcall encryp3
+	ldi RC, 1
+	ldi I, 8
+encryp2:
+	rcall next_round_key
+	aes_round
+	dec I
+	sbrs I,7
+	rjmp encryp2
+	rcall next_round_key
+	aes_last_round
+	encryp3:
+		; AddRoundKey
+		.irp param,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15
+		ldd H1, Y+\param
+		eor r\param, H1
+		.endr
+		ret
+		.size encrypt_otf, .-encrypt_otf
+
+;;; ***************************************************************************
+;;; 
+;;; NEXT_ROUND_KEY
+;;; Replaces the round key at YH:YL by the next one, RC being the current
+;;; round constant (updated on return).
+;;;
+;;; Touched registers:
+;;;     H1-H5,RC,ZH,ZL (ZH holds hi8(sbox) on exit)
+;;; Clock cycles:	108
+
+next_round_key:
+	ldi ZH, hi8(sbox)
+	; SubWord(RotWord(w3)) ^ rcon
+	ldd ZL, Y+13
+	ld H1, Z
+	eor H1, RC
+	ldd ZL, Y+14
+	ld H2, Z
+	ldd ZL, Y+15
+	ld H3, Z
+	ldd ZL, Y+12
+	ld H4, Z
+	; w[i] ^= w[i-1] for each word, in place
+	.irp param,0,4,8,12
+	ldd H5, Y+\param
+	eor H1, H5
+	std Y+\param, H1
+	ldd H5, Y+(\param+1)
+	eor H2, H5
+	std Y+(\param+1), H2
+	ldd H5, Y+(\param+2)
+	eor H3, H5
+	std Y+(\param+2), H3
+	ldd H5, Y+(\param+3)
+	eor H4, H5
+	std Y+(\param+3), H4
+	.endr
+	; rcon = xtime(rcon)
+	lsl RC
+	brcc 1f
+	ldi H5, 0x1b
+	eor RC, H5
+1:	ret
+	.size next_round_key, .-next_round_key
+
+
+; Same as encrypt_data, except that the expanded key (ARG3) resides in program
+; memory (e.g. provisioned with cymric-provision.h) and is read with lpm: since
+; Z is needed by the sbox lookups, each round key is copied to 16 bytes of
+; stack right before the corresponding round.
+.global encrypt_data_P
+encrypt_data_P:
+	; Save registers r2-17,r28-29
+	push_registers 2,17
+	push_registers 28,29
+	; Allocate 16 bytes of stack pointed by Y for the current round key
+	in YL, 0x3d
+	in YH, 0x3e
+	sbiw YL, 16
+	in H1, 0x3f
+	cli
+	out 0x3e, YH
+	out 0x3f, H1
+	out 0x3d, YL
+	adiw YL, 1
+	; Load the plaintext given by argument to register 0-15
+	movw XL, ARG2
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+	ld \param, X+
+	.endr
+	; Pointer to the expanded key in program memory
+	movw XL, ARG3
+
+	rcall encrypt_P
+
+	; Release the round key copy
+	adiw YL, 15
+	in H1, 0x3f
+	cli
+	out 0x3e, YH
+	out 0x3f, H1
+	out 0x3d, YL
+	; Save the final state from the registers to Y (ARG1)
+	movw YL, ARG1
+	.irp param,r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,r13,r14,r15
+		st Y+, \param
+	.endr
+	; Restore registers r2-17,r28-29
+	pop_registers 28,29
+	pop_registers 2,17
+	clr r1
+	ret
+	.size encrypt_data_P, .-encrypt_data_P
+
+
+;;; ***************************************************************************
+;;; 
+;;; ENCRYPT_P 
+;;; Same as encrypt, except that the expanded key is read from program memory
+;;; at XH:XL, one round key at a time (see load_round_key_P), to 16 bytes of
+;;; RAM at YH:YL.
+;;;
+;;; Parameters:
+;;;         XH:XL:	pointer to expanded key in program memory
+;;;         YH:YL:	pointer to 16 bytes of RAM for the current round key
+;;;         ST11-ST44:  128 bit plaintext block
+;;; Touched registers:
+;;;     ST11-ST41,H1-H5,I,XH,XL,ZH,ZL
+;;; Clock cycles:	those of encrypt + 11 calls to load_round_key_P
+
+encrypt_P:
+	rcall load_round_key_P
+	rcall encryp3
+	ldi I, 8
+encryp4:
+	rcall load_round_key_P
+	aes_round
+	dec I
+	sbrs I,7
+	rjmp encryp4
+	rcall load_round_key_P
+	aes_last_round
+	rjmp encryp3
+	.size encrypt_P, .-encrypt_P
+
+;;; ***************************************************************************
+;;; 
+;;; LOAD_ROUND_KEY_P
+;;; Copies the round key at XH:XL in program memory to YH:YL, XH:XL being
+;;; advanced to the next round key.
+;;;
+;;; Touched registers:
+;;;     H1,XH,XL,ZH,ZL (ZH holds hi8(sbox) on exit)
+;;; Clock cycles:	90
+
+load_round_key_P:
+	movw ZL, XL
+	.irp param,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15
+	lpm H1, Z+
+	std Y+\param, H1
+	.endr
+	movw XL, ZL
+	ldi ZH, hi8(sbox)
+	ret
+	.size load_round_key_P, .-load_round_key_P
+
 		
 .global decrypt_data
 decrypt_data:
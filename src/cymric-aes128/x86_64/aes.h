@@ -1,7 +1,7 @@
 #ifndef AES_H_
 #define AES_H_
 
-#include <wmmintrin.h>
+#include <immintrin.h>
 #include <stdint.h>
 #include "cipher_ctx.h"
 
@@ -12,6 +12,11 @@ typedef struct {
 cipher_ctx_t aes_get_cipher_ctx(void);
 void aes128_enc(uint8_t* out, const uint8_t* in, const void* rkeys);
 void aes128_kexp(void* rkeys, const uint8_t* key);
+void aes128_enc_x3(uint8_t* out0, uint8_t* out1, uint8_t* out2,
+                   const uint8_t* in0, const uint8_t* in1, const uint8_t* in2,
+                   const void* rkeys0, const void* rkeys1);
+void aes128_enc_x8(__m128i blk[8], const void* rkeys);
+void aes128_enc_x8_lanes(__m128i blk[8], const __m128i rk[11][8]);
 
 
 #endif
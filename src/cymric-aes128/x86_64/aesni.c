@@ -1,3 +1,4 @@
+#include <string.h>
 #include "aes.h"
 
 cipher_ctx_t aes_get_cipher_ctx(void) {
@@ -9,6 +10,39 @@ cipher_ctx_t aes_get_cipher_ctx(void) {
     return ctx;
 }
 
+/**
+ * Load (resp. store) a block with an aligned access when the pointer allows
+ * it, and an unaligned one otherwise (e.g. user key buffers or byte arrays on
+ * the stack), since aligned accesses fault on unaligned addresses.
+ */
+static inline __m128i load_block(const unsigned char* p)
+{
+  if (((uintptr_t)p & 15) == 0)
+    return _mm_load_si128((const __m128i*)p);
+  return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline void store_block(unsigned char* p, __m128i x)
+{
+  if (((uintptr_t)p & 15) == 0)
+    _mm_store_si128((__m128i*)p, x);
+  else
+    _mm_storeu_si128((__m128i*)p, x);
+}
+
+/**
+ * Round keys to be used by the single-block functions: the given ones if they
+ * are 16-byte aligned (e.g. aes_roundkeys_t or a CYMRIC_FLASH table), or an
+ * aligned copy otherwise (e.g. precomputed round keys in a byte buffer).
+ */
+static inline const __m128i* aligned_rkeys(const void* roundkeys, aes_roundkeys_t* copy)
+{
+  if (((uintptr_t)roundkeys & 15) == 0)
+    return ((const aes_roundkeys_t*)roundkeys)->rk;
+  memcpy(copy, roundkeys, sizeof(aes_roundkeys_t));
+  return copy->rk;
+}
+
 /**
  * Key schedule round function.
  */
@@ -30,60 +64,168 @@ static inline void keyschedule_roundfunc(__m128i *rkey, __m128i word)
  */
 void aes128_kexp(void* roundkeys, const uint8_t* key)
 {
-  aes_roundkeys_t* rkeys = (aes_roundkeys_t*)roundkeys;
+  unsigned char* rkeys = (unsigned char*)roundkeys;
   __m128i rkey;
-  rkey = _mm_load_si128((__m128i*)key);
-  rkeys->rk[0] = rkey; 
+  rkey = load_block(key);
+  store_block(rkeys, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x01));
-  rkeys->rk[1] = rkey;
+  store_block(rkeys + 16*1, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x02));
-  rkeys->rk[2] = rkey;
+  store_block(rkeys + 16*2, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x04));
-  rkeys->rk[3] = rkey;
+  store_block(rkeys + 16*3, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x08));
-  rkeys->rk[4] = rkey;
+  store_block(rkeys + 16*4, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x10));
-  rkeys->rk[5] = rkey;
+  store_block(rkeys + 16*5, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x20));
-  rkeys->rk[6] = rkey;
+  store_block(rkeys + 16*6, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x40));
-  rkeys->rk[7] = rkey;
+  store_block(rkeys + 16*7, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x80));
-  rkeys->rk[8] = rkey;
+  store_block(rkeys + 16*8, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x1b));
-  rkeys->rk[9] = rkey;
+  store_block(rkeys + 16*9, rkey);
   keyschedule_roundfunc(&rkey, _mm_aeskeygenassist_si128(rkey, 0x36));
-  rkeys->rk[10] = rkey;
+  store_block(rkeys + 16*10, rkey);
 }
 
 void aes128_enc(unsigned char* out, const unsigned char* in, const void* roundkeys)
 {
   unsigned int i;
   __m128i state;
-  const aes_roundkeys_t* aes_rkeys = (const aes_roundkeys_t*)roundkeys;
-  const __m128i* rkeys = (const __m128i*)aes_rkeys->rk;
+  aes_roundkeys_t copy;
+  const __m128i* rkeys = aligned_rkeys(roundkeys, &copy);
 
-  state = _mm_load_si128((__m128i*)in);
+  state = load_block(in);
   state = _mm_xor_si128(state, rkeys[0]);
   for(i = 1; i < 10; i++)
     state = _mm_aesenc_si128(state, rkeys[i]);
   state = _mm_aesenclast_si128(state, rkeys[i]);
 
-  _mm_store_si128((__m128i*)out, state);
+  store_block(out, state);
 }
 
 void aes128_dec(unsigned char* out, const unsigned char* in, const void* roundkeys)
 {
   unsigned int i;
   __m128i state;
-  const aes_roundkeys_t* aes_rkeys = (const aes_roundkeys_t*)roundkeys;
-  const __m128i* rkeys = (const __m128i*)aes_rkeys->rk;
+  aes_roundkeys_t copy;
+  const __m128i* rkeys = aligned_rkeys(roundkeys, &copy);
 
-  state = _mm_load_si128((__m128i*)in);
+  state = load_block(in);
   state = _mm_xor_si128(state, rkeys[10]);
   for(i = 9; i > 0; i--) 
     state = _mm_aesdec_si128(state, _mm_aesimc_si128(rkeys[i]));
   state = _mm_aesdeclast_si128(state, rkeys[i]);
 
-  _mm_store_si128((__m128i*)out, state);
+  store_block(out, state);
+}
+
+/**
+ * Encrypt one block under a first key and two blocks under a second key with
+ * interleaved AESENC chains, so that the three independent encryptions
+ * overlap in the AES pipeline.
+ */
+void aes128_enc_x3(unsigned char* out0, unsigned char* out1, unsigned char* out2,
+                   const unsigned char* in0, const unsigned char* in1, const unsigned char* in2,
+                   const void* roundkeys0, const void* roundkeys1)
+{
+  unsigned int i;
+  __m128i s0, s1, s2;
+  const __m128i* rk0 = ((const aes_roundkeys_t*)roundkeys0)->rk;
+  const __m128i* rk1 = ((const aes_roundkeys_t*)roundkeys1)->rk;
+
+  s0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in0), rk0[0]);
+  s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in1), rk1[0]);
+  s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in2), rk1[0]);
+  for(i = 1; i < 10; i++) {
+    s0 = _mm_aesenc_si128(s0, rk0[i]);
+    s1 = _mm_aesenc_si128(s1, rk1[i]);
+    s2 = _mm_aesenc_si128(s2, rk1[i]);
+  }
+  s0 = _mm_aesenclast_si128(s0, rk0[i]);
+  s1 = _mm_aesenclast_si128(s1, rk1[i]);
+  s2 = _mm_aesenclast_si128(s2, rk1[i]);
+
+  _mm_storeu_si128((__m128i*)out0, s0);
+  _mm_storeu_si128((__m128i*)out1, s1);
+  _mm_storeu_si128((__m128i*)out2, s2);
+}
+
+/**
+ * Encrypt eight independent blocks in place under the same key, using two
+ * 512-bit VAES lanes when available and eight interleaved AESENC chains
+ * otherwise.
+ */
+void aes128_enc_x8(__m128i blk[8], const void* roundkeys)
+{
+  unsigned int i;
+  const __m128i* rk = ((const aes_roundkeys_t*)roundkeys)->rk;
+#if defined(__VAES__) && defined(__AVX512F__)
+  __m512i s0 = _mm512_loadu_si512((const void*)(blk + 0));
+  __m512i s1 = _mm512_loadu_si512((const void*)(blk + 4));
+  __m512i k  = _mm512_broadcast_i32x4(rk[0]);
+
+  s0 = _mm512_xor_si512(s0, k);
+  s1 = _mm512_xor_si512(s1, k);
+  for(i = 1; i < 10; i++) {
+    k  = _mm512_broadcast_i32x4(rk[i]);
+    s0 = _mm512_aesenc_epi128(s0, k);
+    s1 = _mm512_aesenc_epi128(s1, k);
+  }
+  k  = _mm512_broadcast_i32x4(rk[i]);
+  s0 = _mm512_aesenclast_epi128(s0, k);
+  s1 = _mm512_aesenclast_epi128(s1, k);
+  _mm512_storeu_si512((void*)(blk + 0), s0);
+  _mm512_storeu_si512((void*)(blk + 4), s1);
+#else
+  __m128i s[8];
+  unsigned int j;
+
+  for(j = 0; j < 8; j++)
+    s[j] = _mm_xor_si128(blk[j], rk[0]);
+  for(i = 1; i < 10; i++)
+    for(j = 0; j < 8; j++)
+      s[j] = _mm_aesenc_si128(s[j], rk[i]);
+  for(j = 0; j < 8; j++)
+    blk[j] = _mm_aesenclast_si128(s[j], rk[i]);
+#endif
+}
+
+/**
+ * Encrypt eight independent blocks in place, block j under its own round keys
+ * rk[.][j]. Round keys are stored round-major so that each round of the eight
+ * lanes loads contiguous keys (two 512-bit loads with VAES) instead of
+ * gathering them from eight key schedules.
+ */
+void aes128_enc_x8_lanes(__m128i blk[8], const __m128i rk[11][8])
+{
+  unsigned int i;
+#if defined(__VAES__) && defined(__AVX512F__)
+  __m512i s0 = _mm512_loadu_si512((const void*)(blk + 0));
+  __m512i s1 = _mm512_loadu_si512((const void*)(blk + 4));
+
+  s0 = _mm512_xor_si512(s0, _mm512_loadu_si512((const void*)(rk[0] + 0)));
+  s1 = _mm512_xor_si512(s1, _mm512_loadu_si512((const void*)(rk[0] + 4)));
+  for(i = 1; i < 10; i++) {
+    s0 = _mm512_aesenc_epi128(s0, _mm512_loadu_si512((const void*)(rk[i] + 0)));
+    s1 = _mm512_aesenc_epi128(s1, _mm512_loadu_si512((const void*)(rk[i] + 4)));
+  }
+  s0 = _mm512_aesenclast_epi128(s0, _mm512_loadu_si512((const void*)(rk[i] + 0)));
+  s1 = _mm512_aesenclast_epi128(s1, _mm512_loadu_si512((const void*)(rk[i] + 4)));
+  _mm512_storeu_si512((void*)(blk + 0), s0);
+  _mm512_storeu_si512((void*)(blk + 4), s1);
+#else
+  __m128i s[8];
+  unsigned int j;
+
+  for(j = 0; j < 8; j++)
+    s[j] = _mm_xor_si128(blk[j], rk[0][j]);
+  for(i = 1; i < 10; i++)
+    for(j = 0; j < 8; j++)
+      s[j] = _mm_aesenc_si128(s[j], rk[i][j]);
+  for(j = 0; j < 8; j++)
+    blk[j] = _mm_aesenclast_si128(s[j], rk[i][j]);
+#endif
 }
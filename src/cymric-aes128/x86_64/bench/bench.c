@@ -0,0 +1,413 @@
+/**
+ * @file bench.c
+ *
+ * @brief Throughput, latency and cache-miss benchmark of Cymric-AES128 under
+ * many keys and several pinned threads, to capture the cost of cold round
+ * keys and of cross-core contention rather than the one of a single message
+ * under a single hot key.
+ *
+ * Each thread processes calls (single messages or batches) under keys drawn
+ * uniformly at random from a shared set, optionally flushing the key material
+ * from the caches before each call. Latencies are measured per call with the
+ * TSC, and last-level cache misses with perf_event when available, while the
+ * throughput is measured over the whole run (including the flushes).
+ * Decryption is run on random ciphertexts (tags are not valid under keys
+ * drawn at random), which costs the same as valid ones but for the zeroing of
+ * the plaintext.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "../cymric.h"
+#include "../aes.h"
+#include "../cymric-batch.h"
+#include "../cymric-fused.h"
+
+#define API_SINGLE  0
+#define API_BATCH   1
+#define API_FUSED   2       // single messages through the fused kernels
+#define API_ONESHOT 3       // single messages through the one-shot-key kernels
+#define RING        256     // messages cycled through by the single API
+
+typedef struct {
+    int api;
+    int dec;
+    int variant;
+    size_t nkeys;
+    int flush;              // flush the key material before each call
+    int precomputed;        // round keys expanded beforehand (kexpand NULL)
+    unsigned int threads;
+    size_t calls;           // calls per thread
+    size_t batch;           // messages per call (batch API)
+    size_t nlen, alen, mlen;
+} config_t;
+
+typedef struct {
+    const config_t* cfg;
+    unsigned int id;
+    uint64_t* lat;          // latency of each call (in TSC ticks)
+    uint64_t misses;        // LLC misses, UINT64_MAX if unavailable
+    double start, end;      // wall-clock time of the run
+} worker_t;
+
+static const char* const api_name[] = {"single", "batch", "fused", "1shot"};
+static int cpus[CPU_SETSIZE];               // cpus the process may run on
+static int ncpus;
+static uint8_t* raw_keys;                   // nkeys*2*KEYBYTES
+static cymric_batch_key_t* pre_keys;        // nkeys round keys of K and K'
+static pthread_barrier_t barrier;
+
+static double seconds(void);
+
+static inline uint64_t xorshift(uint64_t* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void fill_random(uint8_t* p, size_t len, uint64_t* s)
+{
+    while (len--)
+        *p++ = (uint8_t)xorshift(s);
+}
+
+static inline uint64_t now(void)
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+static void flush_lines(const void* p, size_t len)
+{
+    const uint8_t* q = (const uint8_t*)((uintptr_t)p & ~(uintptr_t)63);
+
+    for (; q < (const uint8_t*)p + len; q += 64)
+        _mm_clflush(q);
+    _mm_mfence();
+}
+
+/**
+ * @brief Open a counter of the LLC misses of the calling thread.
+ */
+static int llc_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0x00, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static const uint8_t* key_material(const config_t* cfg, size_t i, size_t* len)
+{
+    if (cfg->precomputed) {
+        *len = sizeof(cymric_batch_key_t);
+        return (const uint8_t*)pre_keys[i].rk;
+    }
+    *len = 2*KEYBYTES;
+    return raw_keys + 2*KEYBYTES*i;
+}
+
+static void run_single(worker_t* w, uint64_t* seed)
+{
+    const config_t* cfg = w->cfg;
+    static __thread uint8_t n[RING][BLOCKBYTES], a[RING][BLOCKBYTES], in[RING][BLOCKBYTES + TAGBYTES];
+    uint8_t out[BLOCKBYTES + TAGBYTES];
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+    size_t c, len, outlen;
+    int (*fn)(uint8_t*, size_t*, const uint8_t*, const uint8_t*, size_t,
+              const uint8_t*, size_t, const uint8_t*, size_t, const cipher_ctx_t*);
+    int (*oneshot)(uint8_t*, size_t*, const uint8_t*, const uint8_t*, size_t,
+              const uint8_t*, size_t, const uint8_t*, size_t);
+    size_t inlen = cfg->dec ? cfg->mlen + TAGBYTES : cfg->mlen;
+
+    ctx.roundkeys = &rkeys;
+    if (cfg->precomputed)
+        ctx.kexpand = NULL;
+    if (cfg->api == API_FUSED && cfg->variant == 1)
+        fn = cfg->dec ? cymric1_dec_fused : cymric1_enc_fused;
+    else if (cfg->api == API_FUSED)
+        fn = cfg->dec ? cymric2_dec_fused : cymric2_enc_fused;
+    else if (cfg->variant == 1)
+        fn = cfg->dec ? cymric1_dec : cymric1_enc;
+    else
+        fn = cfg->dec ? cymric2_dec : cymric2_enc;
+    if (cfg->variant == 1)
+        oneshot = cfg->dec ? cymric1_dec_oneshot : cymric1_enc_oneshot;
+    else
+        oneshot = cfg->dec ? cymric2_dec_oneshot : cymric2_enc_oneshot;
+    fill_random(&n[0][0], sizeof(n), seed);
+    fill_random(&a[0][0], sizeof(a), seed);
+    fill_random(&in[0][0], sizeof(in), seed);
+
+    w->start = seconds();
+    for (c = 0; c < cfg->calls; c++) {
+        const uint8_t* k = key_material(cfg, xorshift(seed) % cfg->nkeys, &len);
+        size_t r = c % RING;
+        uint64_t t0;
+
+        if (cfg->flush)
+            flush_lines(k, len);
+        t0 = now();
+        if (cfg->api == API_ONESHOT)
+            oneshot(out, &outlen, k, n[r], cfg->nlen, in[r], inlen, a[r], cfg->alen);
+        else
+            fn(out, &outlen, k, n[r], cfg->nlen, in[r], inlen, a[r], cfg->alen, &ctx);
+        w->lat[c] = now() - t0;
+    }
+}
+
+static void run_batch(worker_t* w, uint64_t* seed)
+{
+    const config_t* cfg = w->cfg;
+    cymric_batch_key_t local;
+    cymric_soa_t b;
+    size_t c, i, len;
+
+    if (cymric_soa_alloc(&b, cfg->batch) != 0) {
+        memset(w->lat, 0x00, cfg->calls*sizeof(uint64_t));
+        w->start = seconds();
+        return;
+    }
+    fill_random(b.n[0], cfg->batch*BLOCKBYTES, seed);
+    fill_random(b.a[0], cfg->batch*BLOCKBYTES, seed);
+    fill_random(b.m[0], cfg->batch*BLOCKBYTES, seed);
+    fill_random(b.c[0], cfg->batch*BLOCKBYTES, seed);
+    fill_random(b.t[0], cfg->batch*TAGBYTES, seed);
+    for (i = 0; i < cfg->batch; i++)
+        b.len[i] = (cymric_len_t){cfg->nlen, cfg->alen, cfg->mlen, 0};
+
+    w->start = seconds();
+    for (c = 0; c < cfg->calls; c++) {
+        size_t idx = xorshift(seed) % cfg->nkeys;
+        const uint8_t* k = key_material(cfg, idx, &len);
+        const cymric_batch_key_t* key = &pre_keys[0];
+        uint64_t t0;
+
+        if (cfg->flush)
+            flush_lines(k, len);
+        t0 = now();
+        if (cfg->precomputed)
+            key = &pre_keys[idx];
+        else {
+            cymric_batch_key_init(&local, k);
+            key = &local;
+        }
+        if (cfg->variant == 1 && cfg->dec)
+            cymric1_batch_dec(&b, key);
+        else if (cfg->variant == 1)
+            cymric1_batch_enc(&b, key);
+        else if (cfg->dec)
+            cymric2_batch_dec(&b, key);
+        else
+            cymric2_batch_enc(&b, key);
+        w->lat[c] = now() - t0;
+    }
+    cymric_soa_free(&b);
+}
+
+static void* worker(void* arg)
+{
+    worker_t* w = arg;
+    uint64_t seed = 0x9e3779b97f4a7c15ull * (w->id + 1), count;
+    cpu_set_t set;
+    int fd;
+
+    // pin thread i to the i-th cpu allowed (modulo their number)
+    if (ncpus > 0) {
+        CPU_ZERO(&set);
+        CPU_SET(cpus[w->id % ncpus], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    fd = llc_open();
+
+    pthread_barrier_wait(&barrier);
+    if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    if (w->cfg->api != API_BATCH)
+        run_single(w, &seed);
+    else
+        run_batch(w, &seed);
+    w->end = seconds();
+    if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    pthread_barrier_wait(&barrier);
+
+    w->misses = UINT64_MAX;
+    if (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+        w->misses = count;
+    if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+static int cmp_u64(const void* x, const void* y)
+{
+    uint64_t a = *(const uint64_t*)x, b = *(const uint64_t*)y;
+    return (a > b) - (a < b);
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/**
+ * @brief Number of TSC ticks per nanosecond.
+ */
+static double tsc_per_ns(void)
+{
+    double t0 = seconds();
+    uint64_t c0 = __rdtsc();
+    struct timespec ts = {0, 50000000};
+
+    nanosleep(&ts, NULL);
+    return (__rdtsc() - c0) / ((seconds() - t0)*1e9);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [-B batch | -F | -o] [-d] [-2] [-k keys] [-f] [-p] [-t threads]\n"
+        "          [-c calls] [-s nlen,alen,mlen]\n"
+        "  -B  batch API with the given number of messages per call (default: single messages)\n"
+        "  -F  single messages through the fused latency kernels\n"
+        "  -o  single messages through the one-shot-key kernels (no -p)\n"
+        "  -d  decryption (default: encryption)\n"
+        "  -2  Cymric2 (default: Cymric1)\n"
+        "  -k  number of distinct keys drawn at random for each call (default 1)\n"
+        "  -f  flush the key material from the caches before each call\n"
+        "  -p  precomputed round keys (default: key expansion in each call)\n"
+        "  -t  number of threads, pinned to cpus 0, 1, ... (default 1)\n"
+        "  -c  number of calls per thread (default 100000)\n"
+        "  -s  lengths of N, A and M (default 12,3,4)\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+    config_t cfg = {
+        .api = API_SINGLE, .variant = 1, .nkeys = 1, .threads = 1,
+        .calls = 100000, .batch = 1, .nlen = 12, .alen = 3, .mlen = 4,
+    };
+    worker_t* w;
+    pthread_t* tid;
+    uint64_t* lat;
+    uint64_t seed = 1, misses = 0;
+    size_t i, total, msgs;
+    double ticks, t0, wall;
+    cpu_set_t set;
+    int opt, perf = 1;
+
+    while ((opt = getopt(argc, argv, "B:Fod2k:fpt:c:s:")) != -1) {
+        switch (opt) {
+        case 'B': cfg.api = API_BATCH; cfg.batch = strtoul(optarg, NULL, 0); break;
+        case 'F': cfg.api = API_FUSED; cfg.batch = 1; break;
+        case 'o': cfg.api = API_ONESHOT; cfg.batch = 1; break;
+        case 'd': cfg.dec = 1; break;
+        case '2': cfg.variant = 2; break;
+        case 'k': cfg.nkeys = strtoul(optarg, NULL, 0); break;
+        case 'f': cfg.flush = 1; break;
+        case 'p': cfg.precomputed = 1; break;
+        case 't': cfg.threads = strtoul(optarg, NULL, 0); break;
+        case 'c': cfg.calls = strtoul(optarg, NULL, 0); break;
+        case 's':
+            if (sscanf(optarg, "%zu,%zu,%zu", &cfg.nlen, &cfg.alen, &cfg.mlen) != 3) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.nkeys == 0 || cfg.threads == 0 || cfg.calls == 0 || cfg.batch == 0 ||
+        cfg.nlen + cfg.alen >= BLOCKBYTES || cfg.mlen > BLOCKBYTES ||
+        (cfg.variant == 1 && cfg.nlen + cfg.mlen > BLOCKBYTES) ||
+        (cfg.api == API_ONESHOT && cfg.precomputed)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // key set, shared by all the threads
+    raw_keys = malloc(cfg.nkeys*2*KEYBYTES);
+    pre_keys = aligned_alloc(64, (cfg.precomputed ? cfg.nkeys : 1)*sizeof(cymric_batch_key_t));
+    w   = calloc(cfg.threads, sizeof(worker_t));
+    tid = calloc(cfg.threads, sizeof(pthread_t));
+    lat = malloc(cfg.threads*cfg.calls*sizeof(uint64_t));
+    if (raw_keys == NULL || pre_keys == NULL || w == NULL || tid == NULL || lat == NULL) {
+        fprintf(stderr, "cannot allocate %zu keys\n", cfg.nkeys);
+        return 1;
+    }
+    fill_random(raw_keys, cfg.nkeys*2*KEYBYTES, &seed);
+    for (i = 0; i < (cfg.precomputed ? cfg.nkeys : 1); i++)
+        cymric_batch_key_init(&pre_keys[i], raw_keys + 2*KEYBYTES*i);
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (i = 0; i < CPU_SETSIZE; i++)
+            if (CPU_ISSET(i, &set))
+                cpus[ncpus++] = i;
+    }
+    ticks = tsc_per_ns();
+    pthread_barrier_init(&barrier, NULL, cfg.threads + 1);
+    for (i = 0; i < cfg.threads; i++) {
+        w[i] = (worker_t){.cfg = &cfg, .id = i, .lat = lat + i*cfg.calls};
+        pthread_create(&tid[i], NULL, worker, &w[i]);
+    }
+    // the main thread may only run late on a loaded machine: the wall-clock
+    // time spans from the first worker starting to the last one ending
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+    t0 = w[0].start;
+    wall = w[0].end;
+    for (i = 0; i < cfg.threads; i++) {
+        pthread_join(tid[i], NULL);
+        t0   = (w[i].start < t0) ? w[i].start : t0;
+        wall = (w[i].end > wall) ? w[i].end : wall;
+        if (w[i].misses == UINT64_MAX)
+            perf = 0;
+        misses += w[i].misses;
+    }
+    wall -= t0;
+
+    total = cfg.threads*cfg.calls;
+    msgs  = total*cfg.batch;
+    qsort(lat, total, sizeof(uint64_t), cmp_u64);
+    printf("%-6s %s%d-%s keys=%-9zu %-5s %-6s threads=%-3u %8.2f Mmsg/s  "
+           "p50=%.0f p99=%.0f p999=%.0f ns/call  ",
+        api_name[cfg.api], "cymric", cfg.variant,
+        cfg.dec ? "dec" : "enc", cfg.nkeys, cfg.flush ? "flush" : "hot",
+        cfg.precomputed ? "pre" : "expand", cfg.threads, msgs/wall*1e-6,
+        lat[total/2]/ticks, lat[total*99/100]/ticks, lat[total*999/1000]/ticks);
+    if (perf)
+        printf("LLC-miss/msg=%.3f\n", (double)misses/msgs);
+    else
+        printf("LLC-miss/msg=n/a\n");
+
+    free(lat);
+    free(tid);
+    free(w);
+    free(pre_keys);
+    free(raw_keys);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Sweep of the benchmark scenarios: number of distinct keys, cold round keys
+# and number of pinned threads, for the single-message and batch APIs.
+# Usage: ./scenarios.sh [max threads] [calls per thread]
+set -e
+THREADS=${1:-$(nproc)}
+CALLS=${2:-100000}
+
+for api in "" "-B 64"; do
+    for op in "" "-d"; do
+        for var in "" "-2"; do
+            for keys in 1 1000 1000000 10000000; do
+                for mode in "" "-f" "-p" "-p -f"; do
+                    ./bench $api $op $var -k $keys $mode -t 1 -c $CALLS
+                done
+            done
+        done
+    done
+done
+
+# core scaling with cold keys
+t=1
+while [ $t -le $THREADS ]; do
+    ./bench -k 1000000 -p -t $t -c $CALLS
+    ./bench -B 64 -k 1000000 -p -t $t -c $((CALLS / 64 + 1))
+    t=$((t * 2))
+done
@@ -0,0 +1,410 @@
+/**
+ * @file cymric-archive.c
+ *
+ * @brief Bulk sealing of fixed-width records through memory mappings.
+ *
+ * All the records of an archive share the same shape: only the nonce (the
+ * record index) changes from one record to the next, so padn(N||A||b) is
+ * obtained by inserting the index into a block built once. Records are read
+ * from and written to the mappings with 16-byte accesses, and processed
+ * CYMRIC_BATCH_LANES at a time with aes128_enc_x8. Each thread processes a
+ * contiguous range of records.
+ */
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cymric-archive.h"
+
+#define LANES CYMRIC_BATCH_LANES
+
+/**
+ * Blocks common to all the records of an archive.
+ */
+typedef struct {
+    __m128i x0;         // padn(0^8||ID||b0), nonce bytes left to zero
+    __m128i x1;         // padn(0^8||ID||b1), nonce bytes left to zero
+    __m128i pad;        // 0x80 right after N||M (resp. M), if any
+    __m128i mask;       // first width bytes
+    size_t width;
+    uint64_t first;
+    int cymric1;
+} shape_t;
+
+/**
+ * Range of records processed by a thread.
+ */
+typedef struct {
+    int op;
+    const shape_t* s;
+    uint8_t* out;
+    const uint8_t* in;
+    size_t count;       // total number of records
+    size_t begin;
+    size_t end;
+    const cymric_batch_key_t* key;
+    const cymric_batch_key_t* newkey;
+    size_t failed;
+} job_t;
+
+int cymric_archive_check(const cymric_archive_params_t* p)
+{
+    if (p->variant != 1 && p->variant != 2)
+        return -1;
+    if (p->width == 0 || p->width > BLOCKBYTES)
+        return -1;
+    if (p->variant == 1 && CYMRIC_ARCHIVE_NONCEBYTES + p->width > BLOCKBYTES)
+        return -1;
+    if (p->idlen > CYMRIC_ARCHIVE_MAX_IDBYTES || p->threads > CYMRIC_ARCHIVE_MAX_THREADS)
+        return -1;
+    return 0;
+}
+
+static void shape_init(shape_t* s, const cymric_archive_params_t* p)
+{
+    uint8_t x[BLOCKBYTES] = {0x00}, pad[BLOCKBYTES] = {0x00}, mask[BLOCKBYTES] = {0x00};
+    size_t off = (p->variant == 1) ? CYMRIC_ARCHIVE_NONCEBYTES : 0;
+    size_t pos = CYMRIC_ARCHIVE_NONCEBYTES + p->idlen;
+
+    memcpy(x + CYMRIC_ARCHIVE_NONCEBYTES, p->id, p->idlen);
+    x[pos] = ((off + p->width == BLOCKBYTES) << 7) | 0x20;
+    s->x0 = _mm_loadu_si128((const __m128i*)x);
+    x[pos] |= 0x40;
+    s->x1 = _mm_loadu_si128((const __m128i*)x);
+    if (off + p->width != BLOCKBYTES)
+        pad[off + p->width] = 0x80;
+    s->pad = _mm_loadu_si128((const __m128i*)pad);
+    memset(mask, 0xff, p->width);
+    s->mask    = _mm_loadu_si128((const __m128i*)mask);
+    s->width   = p->width;
+    s->first   = p->first;
+    s->cymric1 = (p->variant == 1);
+}
+
+/**
+ * @brief Nonce of record i, i.e. first+i in big-endian.
+ */
+static inline __m128i nonce(const shape_t* s, size_t i)
+{
+    return _mm_cvtsi64_si128((long long)__builtin_bswap64(s->first + i));
+}
+
+/**
+ * @brief T <- Y0 ^ pad(N||M) (resp. Y0 ^ pad(M)).
+ */
+static inline __m128i tag_input(const shape_t* s, __m128i y0, __m128i n, __m128i m)
+{
+    if (s->cymric1)
+        m = _mm_or_si128(n, _mm_slli_si128(m, CYMRIC_ARCHIVE_NONCEBYTES));
+    return _mm_xor_si128(y0, _mm_or_si128(m, s->pad));
+}
+
+/**
+ * @brief Seal the messages m[0..cnt) with nonces n[0..cnt) into c and t.
+ */
+static void seal_lanes(const shape_t* s, const cymric_batch_key_t* key, unsigned int cnt,
+            const __m128i n[LANES], const __m128i m[LANES], __m128i c[LANES], __m128i t[LANES])
+{
+    __m128i y0[LANES], y1[LANES];
+    unsigned int j;
+
+    for (j = 0; j < LANES; j++) {
+        y0[j] = _mm_or_si128(s->x0, n[j]);
+        y1[j] = _mm_or_si128(s->x1, n[j]);
+    }
+    aes128_enc_x8(y0, &key->rk[0]);
+    aes128_enc_x8(y1, &key->rk[0]);
+    for (j = 0; j < cnt; j++) {
+        c[j] = _mm_and_si128(_mm_xor_si128(m[j], _mm_xor_si128(y0[j], y1[j])), s->mask);
+        t[j] = tag_input(s, y0[j], n[j], m[j]);
+    }
+    for (; j < LANES; j++)
+        t[j] = _mm_setzero_si128();
+    aes128_enc_x8(t, &key->rk[1]);
+}
+
+/**
+ * @brief Open the ciphertexts c[0..cnt) with nonces n[0..cnt) and tags t into
+ * m, zeroed if the tag is invalid.
+ *
+ * @return The bitmap of the valid tags
+ */
+static unsigned int open_lanes(const shape_t* s, const cymric_batch_key_t* key, unsigned int cnt,
+            const __m128i n[LANES], const __m128i c[LANES], const __m128i t[LANES], __m128i m[LANES])
+{
+    __m128i y0[LANES], y1[LANES];
+    unsigned int j, good = 0;
+
+    for (j = 0; j < LANES; j++) {
+        y0[j] = _mm_or_si128(s->x0, n[j]);
+        y1[j] = _mm_or_si128(s->x1, n[j]);
+    }
+    aes128_enc_x8(y0, &key->rk[0]);
+    aes128_enc_x8(y1, &key->rk[0]);
+    for (j = 0; j < cnt; j++) {
+        m[j]  = _mm_and_si128(_mm_xor_si128(c[j], _mm_xor_si128(y0[j], y1[j])), s->mask);
+        y0[j] = tag_input(s, y0[j], n[j], m[j]);
+    }
+    aes128_enc_x8(y0, &key->rk[1]);
+
+    // constant-time tag check, plaintext not released if erroneous
+    for (j = 0; j < cnt; j++) {
+        __m128i d = _mm_xor_si128(y0[j], t[j]);
+        unsigned int ok = (unsigned int)_mm_testz_si128(d, d);
+        m[j] = _mm_and_si128(m[j], _mm_set1_epi8(-(char)ok));
+        good |= ok << j;
+    }
+    return good;
+}
+
+/**
+ * @brief Load plain record i, with a 16-byte load unless it would read past
+ * the end of the input.
+ */
+static inline __m128i load_plain(const job_t* job, size_t i)
+{
+    const uint8_t* p = job->in + i*job->s->width;
+    uint8_t tmp[BLOCKBYTES];
+
+    if ((job->count - i)*job->s->width >= BLOCKBYTES)
+        return _mm_loadu_si128((const __m128i*)p);
+    memcpy(tmp, p, job->s->width);
+    return _mm_loadu_si128((const __m128i*)tmp);
+}
+
+/**
+ * @brief Store plain record i, with a 16-byte store unless it would write
+ * past the range of the thread. Records being stored in increasing order,
+ * the bytes written beyond record i are overwritten by the next records.
+ */
+static inline void store_plain(const job_t* job, size_t i, __m128i m)
+{
+    uint8_t* p = job->out + i*job->s->width;
+    uint8_t tmp[BLOCKBYTES];
+
+    if ((job->end - i)*job->s->width >= BLOCKBYTES)
+        _mm_storeu_si128((__m128i*)p, m);
+    else {
+        _mm_storeu_si128((__m128i*)tmp, m);
+        memcpy(p, tmp, job->s->width);
+    }
+}
+
+/**
+ * @brief Store sealed record i, the tag overwriting the bytes stored beyond
+ * the ciphertext.
+ */
+static inline void store_sealed(const job_t* job, size_t i, __m128i c, __m128i t)
+{
+    uint8_t* p = job->out + i*(job->s->width + TAGBYTES);
+
+    _mm_storeu_si128((__m128i*)p, c);
+    _mm_storeu_si128((__m128i*)(p + job->s->width), t);
+}
+
+static void* job_run(void* arg)
+{
+    job_t* job = arg;
+    const shape_t* s = job->s;
+    size_t rs = s->width + TAGBYTES;
+    __m128i n[LANES], m[LANES], c[LANES], t[LANES];
+    size_t i;
+
+    for (i = job->begin; i < job->end; i += LANES) {
+        unsigned int cnt = (job->end - i < LANES) ? job->end - i : LANES;
+        unsigned int j, good;
+
+        for (j = 0; j < LANES; j++)
+            n[j] = (j < cnt) ? nonce(s, i + j) : _mm_setzero_si128();
+
+        if (job->op == CYMRIC_ARCHIVE_SEAL) {
+            for (j = 0; j < cnt; j++)
+                m[j] = _mm_and_si128(load_plain(job, i + j), s->mask);
+            seal_lanes(s, job->key, cnt, n, m, c, t);
+            for (j = 0; j < cnt; j++)
+                store_sealed(job, i + j, c[j], t[j]);
+            continue;
+        }
+
+        for (j = 0; j < cnt; j++) {
+            c[j] = _mm_and_si128(_mm_loadu_si128((const __m128i*)(job->in + (i + j)*rs)), s->mask);
+            t[j] = _mm_loadu_si128((const __m128i*)(job->in + (i + j)*rs + s->width));
+        }
+        good = open_lanes(s, job->key, cnt, n, c, t, m);
+        job->failed += cnt - __builtin_popcount(good);
+
+        if (job->op == CYMRIC_ARCHIVE_OPEN) {
+            for (j = 0; j < cnt; j++)
+                store_plain(job, i + j, m[j]);
+        }
+        else {
+            seal_lanes(s, job->newkey, cnt, n, m, c, t);
+            for (j = 0; j < cnt; j++) {
+                __m128i keep = _mm_set1_epi8(-(char)((good >> j) & 1));
+                store_sealed(job, i + j, _mm_and_si128(c[j], keep), _mm_and_si128(t[j], keep));
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Split the records in contiguous ranges of at least
+ * CYMRIC_ARCHIVE_CHUNK records, one per thread, the calling thread taking the
+ * first one.
+ *
+ * @return The number of records with an invalid tag
+ */
+static size_t run(int op, uint8_t* out, const uint8_t* in, size_t count,
+            const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+            const cymric_batch_key_t* newkey)
+{
+    job_t job[CYMRIC_ARCHIVE_MAX_THREADS];
+    pthread_t tid[CYMRIC_ARCHIVE_MAX_THREADS];
+    int started[CYMRIC_ARCHIVE_MAX_THREADS] = {0};
+    unsigned int i, nthreads = (p->threads > 1) ? p->threads : 1;
+    size_t range, failed = 0;
+    shape_t s;
+
+    shape_init(&s, p);
+    if (nthreads > count/CYMRIC_ARCHIVE_CHUNK)
+        nthreads = (count/CYMRIC_ARCHIVE_CHUNK > 0) ? count/CYMRIC_ARCHIVE_CHUNK : 1;
+    range = ((count + nthreads - 1)/nthreads + LANES - 1) & ~(size_t)(LANES - 1);
+
+    for (i = 0; i < nthreads; i++) {
+        job[i] = (job_t){
+            .op = op, .s = &s, .out = out, .in = in, .count = count,
+            .begin = (i*range < count) ? i*range : count,
+            .end = ((i + 1)*range < count) ? (i + 1)*range : count,
+            .key = key, .newkey = newkey, .failed = 0,
+        };
+    }
+    // fall back to the calling thread for the ranges which cannot be started
+    for (i = 1; i < nthreads; i++)
+        started[i] = (pthread_create(&tid[i], NULL, job_run, &job[i]) == 0);
+    job_run(&job[0]);
+    for (i = 1; i < nthreads; i++) {
+        if (started[i])
+            pthread_join(tid[i], NULL);
+        else
+            job_run(&job[i]);
+    }
+    for (i = 0; i < nthreads; i++)
+        failed += job[i].failed;
+    return failed;
+}
+
+int cymric_archive_seal(uint8_t* out, const uint8_t* in, size_t count,
+            const cymric_archive_params_t* p, const cymric_batch_key_t* key)
+{
+    if (cymric_archive_check(p) != 0)
+        return -1;
+    run(CYMRIC_ARCHIVE_SEAL, out, in, count, p, key, NULL);
+    return 0;
+}
+
+int cymric_archive_open(uint8_t* out, const uint8_t* in, size_t count,
+            const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+            size_t* failed)
+{
+    size_t f;
+
+    if (cymric_archive_check(p) != 0)
+        return -1;
+    f = run(CYMRIC_ARCHIVE_OPEN, out, in, count, p, key, NULL);
+    if (failed != NULL)
+        *failed = f;
+    return f != 0;
+}
+
+int cymric_archive_rekey(uint8_t* out, const uint8_t* in, size_t count,
+            const cymric_archive_params_t* p, const cymric_batch_key_t* oldkey,
+            const cymric_batch_key_t* newkey, size_t* failed)
+{
+    size_t f;
+
+    if (cymric_archive_check(p) != 0)
+        return -1;
+    f = run(CYMRIC_ARCHIVE_REKEY, out, in, count, p, oldkey, newkey);
+    if (failed != NULL)
+        *failed = f;
+    return f != 0;
+}
+
+int cymric_archive_file(int op, const char* outpath, const char* inpath,
+            const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+            const cymric_batch_key_t* newkey, cymric_archive_stats_t* stats)
+{
+    size_t inrec, outrec, count, insize = 0, outsize = 0, failed = 0;
+    void* in = MAP_FAILED;
+    void* out = MAP_FAILED;
+    struct timespec t0, t1;
+    struct stat st, outst;
+    int infd, outfd = -1, ret = -1;
+
+    if (cymric_archive_check(p) != 0)
+        return -1;
+    if (op == CYMRIC_ARCHIVE_REKEY && newkey == NULL)
+        return -1;
+    inrec  = (op == CYMRIC_ARCHIVE_SEAL) ? p->width : p->width + TAGBYTES;
+    outrec = (op == CYMRIC_ARCHIVE_OPEN) ? p->width : p->width + TAGBYTES;
+
+    infd = open(inpath, O_RDONLY);
+    if (infd < 0)
+        return -1;
+    if (fstat(infd, &st) != 0 || st.st_size % inrec != 0)
+        goto end;
+    insize  = st.st_size;
+    count   = insize / inrec;
+    outsize = count * outrec;
+
+    // the output is truncated only once known to be another file than the
+    // input, which it would otherwise wipe before it is read
+    outfd = open(outpath, O_RDWR | O_CREAT, 0644);
+    if (outfd < 0 || fstat(outfd, &outst) != 0)
+        goto end;
+    if (outst.st_dev == st.st_dev && outst.st_ino == st.st_ino)
+        goto end;
+    if (ftruncate(outfd, 0) != 0 || ftruncate(outfd, outsize) != 0)
+        goto end;
+    if (count > 0) {
+        in  = mmap(NULL, insize, PROT_READ, MAP_SHARED, infd, 0);
+        out = mmap(NULL, outsize, PROT_READ | PROT_WRITE, MAP_SHARED, outfd, 0);
+        if (in == MAP_FAILED || out == MAP_FAILED)
+            goto end;
+        madvise(in, insize, MADV_SEQUENTIAL);
+        madvise(out, outsize, MADV_SEQUENTIAL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (count > 0)
+        failed = run(op, out, in, count, p, key, newkey);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    // the output is on disk before success is reported
+    if (count > 0 && msync(out, outsize, MS_SYNC) != 0)
+        goto end;
+    if (fsync(outfd) != 0)
+        goto end;
+    ret = (failed != 0);
+
+    if (stats != NULL) {
+        stats->records = count;
+        stats->failed  = failed;
+        stats->bytes   = insize + outsize;
+        stats->seconds = (t1.tv_sec - t0.tv_sec) + 1e-9*(t1.tv_nsec - t0.tv_nsec);
+    }
+
+end:
+    if (out != MAP_FAILED)
+        munmap(out, outsize);
+    if (in != MAP_FAILED)
+        munmap(in, insize);
+    if (outfd >= 0)
+        close(outfd);
+    close(infd);
+    return ret;
+}
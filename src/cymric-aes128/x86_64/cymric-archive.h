@@ -0,0 +1,115 @@
+#ifndef CYMRIC_ARCHIVE_H_
+#define CYMRIC_ARCHIVE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "cymric-batch.h"
+
+#define CYMRIC_ARCHIVE_NONCEBYTES   8       // record index, big-endian
+#define CYMRIC_ARCHIVE_MAX_IDBYTES  (BLOCKBYTES - 1 - CYMRIC_ARCHIVE_NONCEBYTES)
+#define CYMRIC_ARCHIVE_MAX_THREADS  64
+#define CYMRIC_ARCHIVE_CHUNK        (1 << 16)   // minimum number of records per thread
+
+// operations of cymric_archive_file
+#define CYMRIC_ARCHIVE_SEAL     0
+#define CYMRIC_ARCHIVE_OPEN     1
+#define CYMRIC_ARCHIVE_REKEY    2
+
+/**
+ * Parameters of an archive of fixed-width records. Record i is sealed with
+ * the nonce first+i (8 bytes, big-endian) and the archive identifier as
+ * associated data, into its ciphertext followed by its tag, so that every
+ * record can be authenticated on its own:
+ * ~~~
+ * plain:  | M_0 (width) | M_1 (width) | ...
+ * sealed: | C_0 (width) | T_0 (16) | C_1 (width) | T_1 (16) | ...
+ * ~~~
+ * Cymric1 requires width <= 8 (since N||M must fit a block), Cymric2 accepts
+ * any width up to 16.
+ */
+typedef struct {
+    int variant;                // 1 or 2
+    size_t width;               // record width (in bytes)
+    uint8_t id[CYMRIC_ARCHIVE_MAX_IDBYTES];  // archive identifier (AD of every record)
+    size_t idlen;
+    uint64_t first;             // index of the first record
+    unsigned int threads;       // number of threads (0 or 1: calling thread only)
+} cymric_archive_params_t;
+
+/**
+ * Statistics of cymric_archive_file.
+ */
+typedef struct {
+    size_t records;             // number of records processed
+    size_t failed;              // number of records whose tag was invalid
+    size_t bytes;               // number of bytes read and written
+    double seconds;             // wall-clock time of the processing
+} cymric_archive_stats_t;
+
+/**
+ * @brief Check the parameters of an archive.
+ *
+ * @return 0 if valid, -1 otherwise
+ */
+int cymric_archive_check(const cymric_archive_params_t* p);
+
+/**
+ * @brief Seal count records of in (count*width bytes) into out
+ * (count*(width+16) bytes).
+ *
+ * @return 0 if successfully executed, -1 if the parameters are invalid
+ */
+int cymric_archive_seal(uint8_t* out, const uint8_t* in, size_t count,
+        const cymric_archive_params_t* p, const cymric_batch_key_t* key);
+
+/**
+ * @brief Open count sealed records of in (count*(width+16) bytes) into out
+ * (count*width bytes). Records with an invalid tag are zeroed.
+ *
+ * @param failed The number of records with an invalid tag (may be NULL)
+ *
+ * @return 0 if all the tags are valid, 1 if some of them are not, -1 if the
+ *      parameters are invalid
+ */
+int cymric_archive_open(uint8_t* out, const uint8_t* in, size_t count,
+        const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+        size_t* failed);
+
+/**
+ * @brief Reseal count sealed records of in from an old key to a new one into
+ * out in a single pass, the plaintexts never leaving the registers. Records
+ * with an invalid tag under the old key are zeroed (ciphertext and tag).
+ *
+ * @param failed The number of records with an invalid tag (may be NULL)
+ *
+ * @return 0 if all the tags are valid, 1 if some of them are not, -1 if the
+ *      parameters are invalid
+ */
+int cymric_archive_rekey(uint8_t* out, const uint8_t* in, size_t count,
+        const cymric_archive_params_t* p, const cymric_batch_key_t* oldkey,
+        const cymric_batch_key_t* newkey, size_t* failed);
+
+/**
+ * @brief Apply an operation to a whole file through memory mappings: the
+ * input file is mapped read-only, the output file is created with its final
+ * size and mapped writable, and records are processed from one mapping to the
+ * other without any intermediate copy.
+ *
+ * @param op CYMRIC_ARCHIVE_SEAL, CYMRIC_ARCHIVE_OPEN or CYMRIC_ARCHIVE_REKEY
+ * @param newkey The new key for CYMRIC_ARCHIVE_REKEY (ignored otherwise)
+ * @param stats The statistics of the processing (may be NULL)
+ *
+ * The output must be another file than the input (checked by device and
+ * inode, so that hard links and other paths to the input are rejected as
+ * well), and it is synchronized to disk before returning.
+ *
+ * @return 0 if all the records are processed, 1 if some of them have an
+ *      invalid tag, -1 on error (invalid parameters, input size not a
+ *      multiple of the record size, output being the input, I/O error)
+ */
+int cymric_archive_file(int op, const char* outpath, const char* inpath,
+        const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+        const cymric_batch_key_t* newkey, cymric_archive_stats_t* stats);
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * @file cymric-arena.c
+ *
+ * @brief Bump allocator of cache-line aligned message slots and key objects
+ * over a single mapping, optionally backed by huge pages.
+ */
+#include <sys/mman.h>
+#include "cymric-arena.h"
+
+#define ROUND_UP(x, a)  (((x) + (a) - 1) & ~(size_t)((a) - 1))
+
+int cymric_arena_init(cymric_arena_t* ar, size_t size, int flags)
+{
+    void* mem = MAP_FAILED;
+    size_t mapped = 0;
+
+    if (size == 0)
+        return -1;
+    ar->huge = 0;
+
+#if defined(MAP_HUGETLB)
+    if (flags & CYMRIC_ARENA_HUGEPAGES) {
+        mapped = ROUND_UP(size, CYMRIC_ARENA_HUGEPAGE);
+        mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        ar->huge = (mem != MAP_FAILED);
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        // mmap returns page-aligned memory, hence cache-line aligned
+        mapped = ROUND_UP(size, 4096);
+        mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            return -1;
+#if defined(MADV_HUGEPAGE)
+        if (flags & CYMRIC_ARENA_HUGEPAGES)
+            madvise(mem, mapped, MADV_HUGEPAGE);
+#endif
+    }
+
+    ar->base   = mem;
+    ar->size   = size;
+    ar->used   = 0;
+    ar->mapped = mapped;
+    return 0;
+}
+
+void cymric_arena_free(cymric_arena_t* ar)
+{
+    if (ar->base != NULL)
+        munmap(ar->base, ar->mapped);
+    ar->base = NULL;
+    ar->size = ar->used = ar->mapped = 0;
+}
+
+void* cymric_arena_alloc(cymric_arena_t* ar, size_t size)
+{
+    size_t len = ROUND_UP(size, CYMRIC_ARENA_ALIGN);
+    void* p;
+
+    if (len < size || len > ar->size - ar->used)
+        return NULL;
+    p = ar->base + ar->used;
+    ar->used += len;
+    return p;
+}
+
+void cymric_arena_reset(cymric_arena_t* ar)
+{
+    ar->used = 0;
+}
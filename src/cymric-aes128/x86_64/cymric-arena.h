@@ -0,0 +1,63 @@
+#ifndef CYMRIC_ARENA_H_
+#define CYMRIC_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CYMRIC_ARENA_ALIGN      64          // alignment of every allocation (cache line)
+#define CYMRIC_ARENA_HUGEPAGE   (1 << 21)   // size of a huge page
+
+// flags of cymric_arena_init
+#define CYMRIC_ARENA_HUGEPAGES  1           // back the arena with huge pages if possible
+
+/**
+ * Memory region reserved once, from which message slots and key objects are
+ * carved on the hot path without any call to malloc. Every allocation is
+ * aligned on a cache line, so that 16-byte slots never straddle two lines.
+ * Allocations are only released all at once by cymric_arena_reset (e.g.
+ * between two batches) or cymric_arena_free.
+ */
+typedef struct {
+    uint8_t* base;
+    size_t size;            // usable size (in bytes)
+    size_t used;            // bytes allocated so far
+    size_t mapped;          // size of the mapping (rounded up to the page size)
+    int huge;               // 1 if backed by explicit huge pages
+} cymric_arena_t;
+
+/**
+ * @brief Reserve the memory of an arena.
+ *
+ * With CYMRIC_ARENA_HUGEPAGES, explicit huge pages (MAP_HUGETLB) are tried
+ * first. If none are available, regular pages are used and the kernel is
+ * advised to back them with transparent huge pages instead.
+ *
+ * @param ar The arena
+ * @param size The number of bytes to reserve
+ * @param flags 0 or CYMRIC_ARENA_HUGEPAGES
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_arena_init(cymric_arena_t* ar, size_t size, int flags);
+
+/**
+ * @brief Release the memory of an arena.
+ */
+void cymric_arena_free(cymric_arena_t* ar);
+
+/**
+ * @brief Allocate size bytes aligned on CYMRIC_ARENA_ALIGN bytes.
+ *
+ * The memory is not cleared (it is zero only on its first use after
+ * cymric_arena_init).
+ *
+ * @return A pointer to the memory, or NULL if the arena is exhausted
+ */
+void* cymric_arena_alloc(cymric_arena_t* ar, size_t size);
+
+/**
+ * @brief Release all the allocations of an arena at once.
+ */
+void cymric_arena_reset(cymric_arena_t* ar);
+
+#endif
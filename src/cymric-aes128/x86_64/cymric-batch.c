@@ -0,0 +1,362 @@
+/**
+ * @file cymric-batch.c
+ *
+ * @brief Batch processing of Cymric1-AES128 and Cymric2-AES128 over a
+ * structure-of-arrays layout, CYMRIC_BATCH_LANES messages at a time.
+ *
+ * Blocks are built with SSE byte shuffles and masks rather than byte-wise
+ * copies: since all the slots are 16-byte long, N, A and M are loaded as
+ * whole blocks, truncated to their length and shifted to their position.
+ * Cymric1 and Cymric2 only differ by the presence of N in the tag input
+ * pad(N||M) vs pad(M), so both are handled by the same routines where `cymric1`
+ * tells whether N is prepended to M.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "cymric-batch.h"
+#include "cymric-sse.h"
+#include "cymric-trace.h"
+
+#define CYMRIC_DIR_ENC 0
+#define CYMRIC_DIR_DEC 1
+
+/**
+ * @brief Size of the memory needed by the columns of a batch, each of them
+ * aligned on CYMRIC_SOA_ALIGN bytes.
+ */
+static size_t soa_size(size_t count, size_t* cols, size_t* lens)
+{
+    size_t bits;
+
+    *cols = (count*BLOCKBYTES + CYMRIC_SOA_ALIGN - 1) & ~(size_t)(CYMRIC_SOA_ALIGN - 1);
+    *lens = (count*sizeof(cymric_len_t) + CYMRIC_SOA_ALIGN - 1) & ~(size_t)(CYMRIC_SOA_ALIGN - 1);
+    bits  = ((count + 63)/64*sizeof(uint64_t) + CYMRIC_SOA_ALIGN - 1) & ~(size_t)(CYMRIC_SOA_ALIGN - 1);
+    return 5*(*cols) + *lens + bits;
+}
+
+/**
+ * @brief Lay the columns of a batch out in mem.
+ */
+static void soa_layout(cymric_soa_t* b, uint8_t* mem, size_t count, size_t cols, size_t lens)
+{
+    b->n     = (uint8_t (*)[BLOCKBYTES])(mem + 0*cols);
+    b->a     = (uint8_t (*)[BLOCKBYTES])(mem + 1*cols);
+    b->m     = (uint8_t (*)[BLOCKBYTES])(mem + 2*cols);
+    b->c     = (uint8_t (*)[BLOCKBYTES])(mem + 3*cols);
+    b->t     = (uint8_t (*)[TAGBYTES])(mem + 4*cols);
+    b->len   = (cymric_len_t*)(mem + 5*cols);
+    b->ok    = (uint64_t*)(mem + 5*cols + lens);
+    b->count = count;
+}
+
+int cymric_soa_alloc(cymric_soa_t* b, size_t count)
+{
+    size_t cols, lens, size = soa_size(count, &cols, &lens);
+    uint8_t* mem = aligned_alloc(CYMRIC_SOA_ALIGN, size);
+
+    if (mem == NULL)
+        return -1;
+    memset(mem, 0x00, size);
+    soa_layout(b, mem, count, cols, lens);
+    b->mem = mem;
+    return 0;
+}
+
+int cymric_soa_alloc_arena(cymric_soa_t* b, cymric_arena_t* ar, size_t count)
+{
+    size_t cols, lens, size = soa_size(count, &cols, &lens);
+    uint8_t* mem = cymric_arena_alloc(ar, size);
+
+    if (mem == NULL)
+        return -1;
+    soa_layout(b, mem, count, cols, lens);
+    b->mem = NULL;
+    return 0;
+}
+
+void cymric_soa_free(cymric_soa_t* b)
+{
+    free(b->mem);
+    b->mem = NULL;
+}
+
+int cymric_soa_slice(cymric_soa_t* view, const cymric_soa_t* b,
+            size_t first, size_t count)
+{
+    if (first % 64 != 0 || first > b->count || count > b->count - first)
+        return -1;
+    view->n     = b->n   + first;
+    view->a     = b->a   + first;
+    view->m     = b->m   + first;
+    view->c     = b->c   + first;
+    view->t     = b->t   + first;
+    view->len   = b->len + first;
+    view->ok    = b->ok  + first/64;
+    view->count = count;
+    view->mem   = NULL;
+    return 0;
+}
+
+void cymric_batch_key_init(cymric_batch_key_t* key, const uint8_t k[])
+{
+    static uint64_t epoch;
+
+    aes128_kexp(&key->rk[0], k);
+    aes128_kexp(&key->rk[1], k + KEYBYTES);
+    key->epoch = __atomic_add_fetch(&epoch, 1, __ATOMIC_RELAXED);
+}
+
+cymric_batch_key_t* cymric_batch_key_alloc(cymric_arena_t* ar, const uint8_t k[])
+{
+    cymric_batch_key_t* key = cymric_arena_alloc(ar, sizeof(cymric_batch_key_t));
+
+    if (key != NULL)
+        cymric_batch_key_init(key, k);
+    return key;
+}
+
+/**
+ * @brief Process up to CYMRIC_BATCH_LANES messages starting at index i0
+ * (which must be a multiple of CYMRIC_BATCH_LANES), either all of them under
+ * key or, if lanes is not NULL, message i0+j under the keys of lane j.
+ *
+ * @return The bitmap of the messages which succeeded
+ */
+static unsigned int batch_lanes(cymric_soa_t* b, const cymric_batch_key_t* key,
+            const cymric_lane_keys_t* lanes, size_t i0, unsigned int cnt, int cymric1, int dir)
+{
+    __m128i x0[CYMRIC_BATCH_LANES], x1[CYMRIC_BATCH_LANES];
+    __m128i out[CYMRIC_BATCH_LANES];
+    unsigned int valid = 0, ok = 0;
+    unsigned int j;
+
+    // X0 <- padn(N||A||b0) and X1 <- padn(N||A||b1)
+    for (j = 0; j < CYMRIC_BATCH_LANES; j++) {
+        cymric_len_t l = (j < cnt) ? b->len[i0 + j] : (cymric_len_t){0};
+        unsigned int off = cymric1 ? l.nlen : 0;
+        __m128i n, a;
+
+        if (j >= cnt || l.nlen + l.alen > BLOCKBYTES - 1 || l.mlen + off > BLOCKBYTES) {
+            // dummy or invalid lane, encrypted along but discarded
+            x0[j] = x1[j] = _mm_setzero_si128();
+            continue;
+        }
+        valid |= 1u << j;
+        n = _mm_and_si128(_mm_loadu_si128((const __m128i*)b->n[i0 + j]), lenmask(l.nlen));
+        a = _mm_and_si128(_mm_loadu_si128((const __m128i*)b->a[i0 + j]), lenmask(l.alen));
+        x0[j] = _mm_or_si128(n, shift(a, l.nlen));
+        x0[j] = _mm_or_si128(x0[j], onehot(l.nlen + l.alen,
+                    ((l.mlen + off == BLOCKBYTES) << 7) | 0x20));
+        x1[j] = _mm_or_si128(x0[j], onehot(l.nlen + l.alen, 0x40));
+    }
+
+    // Y0 <- E_K(X0) and Y1 <- E_K(X1)
+    if (lanes != NULL) {
+        aes128_enc_x8_lanes(x0, lanes->rk[0]);
+        aes128_enc_x8_lanes(x1, lanes->rk[0]);
+    }
+    else {
+        aes128_enc_x8(x0, &key->rk[0]);
+        aes128_enc_x8(x1, &key->rk[0]);
+    }
+
+    for (j = 0; j < CYMRIC_BATCH_LANES; j++) {
+        cymric_len_t l;
+        __m128i in, m, n;
+
+        if (!((valid >> j) & 1))
+            continue;
+        l  = b->len[i0 + j];
+        in = (dir == CYMRIC_DIR_ENC) ? _mm_loadu_si128((const __m128i*)b->m[i0 + j])
+                                     : _mm_loadu_si128((const __m128i*)b->c[i0 + j]);
+        in = _mm_and_si128(in, lenmask(l.mlen));
+
+        // C <- M ^ Y0 ^ Y1 (resp. M <- C ^ Y0 ^ Y1)
+        out[j] = _mm_and_si128(_mm_xor_si128(in, _mm_xor_si128(x0[j], x1[j])),
+                    lenmask(l.mlen));
+        m = (dir == CYMRIC_DIR_ENC) ? in : out[j];
+
+        // T <- Y0 ^ pad(N||M) (resp. Y0 ^ pad(M))
+        if (cymric1) {
+            n = _mm_and_si128(_mm_loadu_si128((const __m128i*)b->n[i0 + j]), lenmask(l.nlen));
+            m = _mm_or_si128(n, shift(m, l.nlen));
+            x0[j] = _mm_xor_si128(x0[j], _mm_or_si128(m, onehot(l.nlen + l.mlen, 0x80)));
+        }
+        else
+            x0[j] = _mm_xor_si128(x0[j], _mm_or_si128(m, onehot(l.mlen, 0x80)));
+    }
+
+    // T <- E_K'(T)
+    if (lanes != NULL)
+        aes128_enc_x8_lanes(x0, lanes->rk[1]);
+    else
+        aes128_enc_x8(x0, &key->rk[1]);
+
+    for (j = 0; j < cnt; j++) {
+        size_t i = i0 + j;
+        __m128i keep;
+
+        if (dir == CYMRIC_DIR_ENC) {
+            keep = _mm_set1_epi8(-(char)((valid >> j) & 1));
+            _mm_storeu_si128((__m128i*)b->c[i], _mm_and_si128(out[j], keep));
+            _mm_storeu_si128((__m128i*)b->t[i], _mm_and_si128(x0[j], keep));
+            ok |= valid & (1u << j);
+        }
+        else {
+            // constant-time tag check, plaintext not released if erroneous
+            __m128i d = _mm_xor_si128(x0[j], _mm_loadu_si128((const __m128i*)b->t[i]));
+            unsigned int good = ((valid >> j) & 1) & (unsigned int)_mm_testz_si128(d, d);
+            keep = _mm_set1_epi8(-(char)good);
+            _mm_storeu_si128((__m128i*)b->m[i], _mm_and_si128(out[j], keep));
+            ok |= good << j;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Check the nonces of the messages whose tag verified against an
+ * anti-replay filter, starting at index i0. Replayed messages are handled as
+ * invalid tags: their plaintext is zeroed and their bit cleared.
+ *
+ * @return The bitmap of the messages which succeeded
+ */
+static unsigned int batch_replay(cymric_soa_t* b, cymric_replay_t* filter,
+            size_t i0, unsigned int ok, size_t* replays)
+{
+    uint64_t ctr[CYMRIC_BATCH_LANES];
+    unsigned int j, k, check = 0, fresh, rejected;
+
+    // nonces shorter than the counter are rejected
+    for (j = 0; j < CYMRIC_BATCH_LANES; j++) {
+        if (!((ok >> j) & 1) || b->len[i0 + j].nlen < filter->ctr_len)
+            continue;
+        ctr[j] = 0;
+        if (b->len[i0 + j].nlen >= 8) {
+            // big-endian counter ending at nlen, read as a single word
+            memcpy(&ctr[j], b->n[i0 + j] + b->len[i0 + j].nlen - 8, 8);
+            ctr[j] = __builtin_bswap64(ctr[j]);
+            if (filter->ctr_len < 8)
+                ctr[j] &= ((uint64_t)1 << (8*filter->ctr_len)) - 1;
+        }
+        else {
+            for (k = b->len[i0 + j].nlen - filter->ctr_len; k < b->len[i0 + j].nlen; k++)
+                ctr[j] = (ctr[j] << 8) | b->n[i0 + j][k];
+        }
+        check |= 1u << j;
+    }
+    fresh    = cymric_replay_check_many(filter, ctr, check);
+    rejected = ok & ~fresh;
+
+    for (j = 0; j < CYMRIC_BATCH_LANES; j++) {
+        if ((rejected >> j) & 1)
+            memset(b->m[i0 + j], 0x00, BLOCKBYTES);
+    }
+    *replays += __builtin_popcount(rejected);
+    return ok & fresh;
+}
+
+static size_t batch_process(cymric_soa_t* b, const cymric_batch_key_t* key,
+            int cymric1, int dir, cymric_replay_t* filter, size_t* replays)
+{
+    size_t i, failed = 0;
+
+    for (i = 0; i < b->count; i += CYMRIC_BATCH_LANES) {
+        unsigned int cnt = (b->count - i < CYMRIC_BATCH_LANES) ? b->count - i : CYMRIC_BATCH_LANES;
+        uint64_t lanes = ((uint64_t)1 << cnt) - 1;
+        uint64_t ok = batch_lanes(b, key, NULL, i, cnt, cymric1, dir);
+
+        // only authentic messages are checked, so that forgeries cannot fill the window
+        if (filter != NULL)
+            ok = batch_replay(b, filter, i, (unsigned int)ok, replays);
+        b->ok[i/64] = (b->ok[i/64] & ~(lanes << (i % 64))) | (ok << (i % 64));
+        failed += cnt - __builtin_popcount((unsigned int)ok);
+    }
+    return failed;
+}
+
+void cymric_lane_keys_set(cymric_lane_keys_t* lanes, unsigned int j,
+            const cymric_batch_key_t* key)
+{
+    unsigned int i;
+
+    for (i = 0; i < 11; i++) {
+        lanes->rk[0][i][j] = key->rk[0].rk[i];
+        lanes->rk[1][i][j] = key->rk[1].rk[i];
+    }
+}
+
+unsigned int cymric_batch_lanes(cymric_soa_t* b, const cymric_lane_keys_t* lanes,
+            int variant, int dec)
+{
+    unsigned int cnt = (b->count < CYMRIC_BATCH_LANES) ? b->count : CYMRIC_BATCH_LANES;
+
+    return batch_lanes(b, NULL, lanes, 0, cnt, variant == 1,
+            dec ? CYMRIC_DIR_DEC : CYMRIC_DIR_ENC);
+}
+
+size_t cymric1_batch_enc(cymric_soa_t* b, const cymric_batch_key_t* key)
+{
+    size_t failed;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_enc_entry, 1, b->count, key);
+    failed = batch_process(b, key, 1, CYMRIC_DIR_ENC, NULL, NULL);
+    CYMRIC_TRACE_BATCH_RETURN(batch_enc_return, 1, b->count, failed);
+    return failed;
+}
+
+size_t cymric1_batch_dec(cymric_soa_t* b, const cymric_batch_key_t* key)
+{
+    size_t failed;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_dec_entry, 1, b->count, key);
+    failed = batch_process(b, key, 1, CYMRIC_DIR_DEC, NULL, NULL);
+    CYMRIC_TRACE_BATCH_RETURN(batch_dec_return, 1, b->count, failed);
+    return failed;
+}
+
+size_t cymric2_batch_enc(cymric_soa_t* b, const cymric_batch_key_t* key)
+{
+    size_t failed;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_enc_entry, 2, b->count, key);
+    failed = batch_process(b, key, 0, CYMRIC_DIR_ENC, NULL, NULL);
+    CYMRIC_TRACE_BATCH_RETURN(batch_enc_return, 2, b->count, failed);
+    return failed;
+}
+
+size_t cymric2_batch_dec(cymric_soa_t* b, const cymric_batch_key_t* key)
+{
+    size_t failed;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_dec_entry, 2, b->count, key);
+    failed = batch_process(b, key, 0, CYMRIC_DIR_DEC, NULL, NULL);
+    CYMRIC_TRACE_BATCH_RETURN(batch_dec_return, 2, b->count, failed);
+    return failed;
+}
+
+size_t cymric1_batch_dec_replay(cymric_soa_t* b, const cymric_batch_key_t* key,
+            cymric_replay_t* filter, size_t* replays)
+{
+    size_t failed, r = 0;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_dec_entry, 1, b->count, key);
+    failed = batch_process(b, key, 1, CYMRIC_DIR_DEC, filter, &r);
+    CYMRIC_TRACE_BATCH_RETURN(batch_dec_return, 1, b->count, failed);
+    if (replays != NULL)
+        *replays = r;
+    return failed;
+}
+
+size_t cymric2_batch_dec_replay(cymric_soa_t* b, const cymric_batch_key_t* key,
+            cymric_replay_t* filter, size_t* replays)
+{
+    size_t failed, r = 0;
+
+    CYMRIC_TRACE_BATCH_ENTRY(batch_dec_entry, 2, b->count, key);
+    failed = batch_process(b, key, 0, CYMRIC_DIR_DEC, filter, &r);
+    CYMRIC_TRACE_BATCH_RETURN(batch_dec_return, 2, b->count, failed);
+    if (replays != NULL)
+        *replays = r;
+    return failed;
+}
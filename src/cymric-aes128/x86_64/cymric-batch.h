@@ -0,0 +1,201 @@
+#ifndef CYMRIC_BATCH_H_
+#define CYMRIC_BATCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "aes.h"
+#include "cymric-arena.h"
+#include "cymric-replay.h"
+
+#define CYMRIC_BATCH_LANES  8   // messages processed at once by the kernels
+#define CYMRIC_SOA_ALIGN    64  // alignment of the columns when allocated
+
+/**
+ * Lengths of a message (in bytes). For decryption, mlen is the length of the
+ * ciphertext without the tag, which is stored in the tag column.
+ */
+typedef struct {
+    uint8_t nlen;
+    uint8_t alen;
+    uint8_t mlen;
+    uint8_t reserved;
+} cymric_len_t;
+
+/**
+ * Structure-of-arrays batch of messages where each column stores fixed
+ * 16-byte slots, so that kernels load and store whole blocks without any
+ * gathering. Bytes of a slot beyond the corresponding length are ignored on
+ * input and zeroed on output.
+ *
+ * The structure only holds pointers: it can either own its columns (see
+ * cymric_soa_alloc), have them carved from an arena (see
+ * cymric_soa_alloc_arena) or be a zero-copy view over columns provided by the
+ * caller (e.g. the buffers of a packet parser), in which case each column
+ * should be 16-byte aligned for best performance.
+ */
+typedef struct {
+    uint8_t (*n)[BLOCKBYTES];   // nonces
+    uint8_t (*a)[BLOCKBYTES];   // additional data
+    uint8_t (*m)[BLOCKBYTES];   // messages
+    uint8_t (*c)[BLOCKBYTES];   // ciphertexts (without tags)
+    uint8_t (*t)[TAGBYTES];     // tags
+    cymric_len_t* len;          // lengths
+    uint64_t* ok;               // result bitmap: bit i set if message i succeeded
+    size_t count;
+    void* mem;                  // owned memory, NULL for views
+} cymric_soa_t;
+
+/**
+ * Round keys of K and K' expanded once for a whole batch. The epoch is drawn
+ * from a process-wide counter by each cymric_batch_key_init, so that caches
+ * of round keys (e.g. the lanes of the job manager) tell apart keys
+ * re-initialized in place or allocated at the address of a former one.
+ */
+typedef struct {
+    aes_roundkeys_t rk[2];
+    uint64_t epoch;
+} cymric_batch_key_t;
+
+/**
+ * Round keys of K and K' of each of the CYMRIC_BATCH_LANES lanes, stored
+ * round-major (rk[key][round][lane]) for aes128_enc_x8_lanes, so that the
+ * messages of a group of lanes may belong to different keys.
+ */
+typedef struct {
+    __m128i rk[2][11][CYMRIC_BATCH_LANES];
+} cymric_lane_keys_t;
+
+/**
+ * @brief Allocate the columns of a batch (aligned on CYMRIC_SOA_ALIGN bytes).
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_soa_alloc(cymric_soa_t* b, size_t count);
+
+/**
+ * @brief Carve the columns of a batch from an arena (aligned on
+ * CYMRIC_SOA_ALIGN bytes), without any call to malloc. The columns are not
+ * cleared and are released along with the arena.
+ *
+ * @return 0 if successfully executed, error code otherwise (arena exhausted)
+ */
+int cymric_soa_alloc_arena(cymric_soa_t* b, cymric_arena_t* ar, size_t count);
+
+/**
+ * @brief Free the columns of a batch allocated with cymric_soa_alloc.
+ */
+void cymric_soa_free(cymric_soa_t* b);
+
+/**
+ * @brief Create a zero-copy view over a range of messages of a batch.
+ *
+ * @param view The output view
+ * @param b The batch
+ * @param first The index of the first message (must be a multiple of 64 so
+ *      that the result bitmap stays word-aligned)
+ * @param count The number of messages
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_soa_slice(cymric_soa_t* view, const cymric_soa_t* b,
+        size_t first, size_t count);
+
+/**
+ * @brief Test whether message i of a batch succeeded.
+ */
+static inline int cymric_soa_ok(const cymric_soa_t* b, size_t i)
+{
+    return (b->ok[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * @brief Expand the round keys of K||K' for the batch functions.
+ */
+void cymric_batch_key_init(cymric_batch_key_t* key, const uint8_t k[]);
+
+/**
+ * @brief Carve a key object from an arena and expand the round keys of K||K'
+ * into it.
+ *
+ * @return The key object, or NULL if the arena is exhausted
+ */
+cymric_batch_key_t* cymric_batch_key_alloc(cymric_arena_t* ar, const uint8_t k[]);
+
+/**
+ * @brief Copy the round keys of K||K' into lane j of a set of lane keys.
+ */
+void cymric_lane_keys_set(cymric_lane_keys_t* lanes, unsigned int j,
+        const cymric_batch_key_t* key);
+
+/**
+ * @brief Process the first CYMRIC_BATCH_LANES messages (at most) of a batch,
+ * message j under the keys of lane j. This is the kernel of the job manager
+ * (see cymric-mb.h); unlike the functions below, b->ok is left untouched.
+ *
+ * @param variant The Cymric variant (1 or 2)
+ * @param dec 0 for encryption (m -> c, t), 1 for decryption (c, t -> m)
+ *
+ * @return The bitmap of the messages which succeeded
+ */
+unsigned int cymric_batch_lanes(cymric_soa_t* b, const cymric_lane_keys_t* lanes,
+        int variant, int dec);
+
+/**
+ * @brief Authenticated encryption of a batch using Cymric1 (m -> c, t).
+ *
+ * @return The number of messages which failed (i.e. invalid lengths)
+ */
+size_t cymric1_batch_enc(cymric_soa_t* b, const cymric_batch_key_t* key);
+
+/**
+ * @brief Authenticated decryption of a batch using Cymric1 (c, t -> m).
+ * Plaintexts of messages with invalid lengths or tags are zeroed.
+ *
+ * @return The number of messages which failed (i.e. invalid lengths or tags)
+ */
+size_t cymric1_batch_dec(cymric_soa_t* b, const cymric_batch_key_t* key);
+
+/**
+ * @brief Authenticated encryption of a batch using Cymric2 (m -> c, t).
+ *
+ * @return The number of messages which failed (i.e. invalid lengths)
+ */
+size_t cymric2_batch_enc(cymric_soa_t* b, const cymric_batch_key_t* key);
+
+/**
+ * @brief Authenticated decryption of a batch using Cymric2 (c, t -> m).
+ * Plaintexts of messages with invalid lengths or tags are zeroed.
+ *
+ * @return The number of messages which failed (i.e. invalid lengths or tags)
+ */
+size_t cymric2_batch_dec(cymric_soa_t* b, const cymric_batch_key_t* key);
+
+/**
+ * @brief Authenticated decryption of a batch using Cymric1 (c, t -> m), fused
+ * with an anti-replay check: the nonce counter of each message whose tag
+ * verified is checked against the filter and recorded, in the same pass.
+ * Replayed messages are reported as failed in the result bitmap and their
+ * plaintexts are zeroed, as for invalid tags.
+ *
+ * @param filter The anti-replay filter of the key, possibly shared with other
+ *      threads
+ * @param replays The number of replayed messages (may be NULL)
+ *
+ * @return The number of messages which failed (i.e. invalid lengths or tags,
+ *      or replays)
+ */
+size_t cymric1_batch_dec_replay(cymric_soa_t* b, const cymric_batch_key_t* key,
+        cymric_replay_t* filter, size_t* replays);
+
+/**
+ * @brief Authenticated decryption of a batch using Cymric2 (c, t -> m), fused
+ * with an anti-replay check (see cymric1_batch_dec_replay).
+ *
+ * @return The number of messages which failed (i.e. invalid lengths or tags,
+ *      or replays)
+ */
+size_t cymric2_batch_dec_replay(cymric_soa_t* b, const cymric_batch_key_t* key,
+        cymric_replay_t* filter, size_t* replays);
+
+#endif
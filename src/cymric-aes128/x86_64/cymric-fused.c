@@ -0,0 +1,288 @@
+/**
+ * @file cymric-fused.c
+ *
+ * @brief Single-message latency kernels of Cymric1 and Cymric2 for AES-NI.
+ *
+ * The generic implementation runs Y0 <- E_K(X0), Y1 <- E_K(X1), the expansion
+ * of K' and the tag encryption one after the other, each step waiting for the
+ * previous one through memory. Here the blocks stay in registers and the
+ * steps overlap: both AESENC chains of Y0 and Y1 share the round keys of K
+ * and run side by side, with the expansion of K' issued in the same rounds
+ * (see kexp_step), so that its round keys are ready by the time the tag chain
+ * starts right after the last round of Y0. The AESENCLAST of each expansion
+ * step runs on the same AES unit as the rounds of Y0 and Y1: it is not hidden
+ * behind another port but in the issue slots left free by these chains, each
+ * round of which waits for the result of the previous one.
+ *
+ * The one-shot variants, meant for keys used for a single message, go one
+ * step further and generate the round keys of K in registers as well, each
+ * one right before the rounds of Y0 and Y1 that use it: nothing is written
+ * to (nor read back from) a round key buffer.
+ */
+#include <string.h>
+#include "aes.h"
+#include "cymric-common.h"
+#include "cymric-sse.h"
+#include "cymric-fused.h"
+
+/**
+ * @brief Key schedule round: AESENCLAST on the last word of the previous round
+ * key rotated and broadcast to the four columns (so that ShiftRows is void)
+ * computes SubWord(RotWord(w3)) ^ rcon, as AESKEYGENASSIST does, at the
+ * latency of AESENC rather than the much longer one of AESKEYGENASSIST.
+ */
+static inline __m128i kexp_step(__m128i rkey, uint8_t rcon)
+{
+    const __m128i rotword = _mm_set_epi8(12, 15, 14, 13, 12, 15, 14, 13,
+                                         12, 15, 14, 13, 12, 15, 14, 13);
+    __m128i word, tmp;
+
+    word = _mm_aesenclast_si128(_mm_shuffle_epi8(rkey, rotword), _mm_set1_epi32(rcon));
+    tmp  = _mm_slli_si128(rkey, 0x4);
+    rkey = _mm_xor_si128(rkey, tmp);
+    tmp  = _mm_slli_si128(tmp, 0x4);
+    rkey = _mm_xor_si128(rkey, tmp);
+    tmp  = _mm_slli_si128(tmp, 0x4);
+    rkey = _mm_xor_si128(rkey, tmp);
+    return _mm_xor_si128(rkey, word);
+}
+
+static inline __m128i load_pad(const uint8_t* x, size_t xlen)
+{
+    uint8_t tmp[BLOCKBYTES];
+
+    load_pad_block(tmp, x, xlen);
+    return _mm_loadu_si128((const __m128i*)tmp);
+}
+
+// round i of Y0 and Y1 under K, along with the expansion of the i-th round key of K'
+#define ROUND_KEXP(i, rcon)                                                     \
+    do {                                                                        \
+        kp[i] = kexp_step(kp[i - 1], rcon);                                     \
+        y0 = _mm_aesenc_si128(y0, _mm_loadu_si128(rk + i));                     \
+        y1 = _mm_aesenc_si128(y1, _mm_loadu_si128(rk + i));                     \
+    } while (0)
+
+// same with the i-th round key of K generated just in time as well
+#define ROUND_ONESHOT(i, rcon)                                                  \
+    do {                                                                        \
+        kr = kexp_step(kr, rcon);                                               \
+        kp[i] = kexp_step(kp[i - 1], rcon);                                     \
+        y0 = _mm_aesenc_si128(y0, kr);                                          \
+        y1 = _mm_aesenc_si128(y1, kr);                                          \
+    } while (0)
+
+/**
+ * @brief Core of the kernels: Y0 and Y1, the encryption (resp. decryption) of
+ * the message block and the tag.
+ *
+ * @param out The message block xored with Y0 ^ Y1 (C, resp. M), zero padded
+ * @param k The key material as in cymric1_enc, or K||K' if ctx is NULL
+ * @param in The message block (M, resp. C), zero padded
+ * @param dec 0 for encryption, 1 for decryption
+ * @param ctx The AES-NI context, or NULL for a one-shot key
+ * @return The tag block
+ */
+static inline __m128i fused(__m128i* out, const uint8_t k[],
+            __m128i n, size_t nlen, __m128i a, size_t alen, __m128i in, size_t mlen,
+            int cymric1, int dec, const cipher_ctx_t* ctx)
+{
+    __m128i kp[11];
+    const __m128i* rk;
+    __m128i y0, y1, kr, m, t;
+    size_t off = cymric1 ? nlen : 0;
+    unsigned int i;
+
+    // X0 <- padn(N||A||b0) and X1 <- padn(N||A||b1)
+    y0 = _mm_or_si128(n, shift(a, nlen));
+    y0 = _mm_or_si128(y0, onehot(nlen + alen, ((mlen + off == BLOCKBYTES) << 7) | 0x20));
+    y1 = _mm_or_si128(y0, onehot(nlen + alen, 0x40));
+
+    // Y0 <- E_K(X0) and Y1 <- E_K(X1)
+    if (ctx == NULL) {
+        kr    = _mm_loadu_si128((const __m128i*)k);
+        kp[0] = _mm_loadu_si128((const __m128i*)(k + KEYBYTES));
+        y0 = _mm_xor_si128(y0, kr);
+        y1 = _mm_xor_si128(y1, kr);
+        ROUND_ONESHOT(1, 0x01);
+        ROUND_ONESHOT(2, 0x02);
+        ROUND_ONESHOT(3, 0x04);
+        ROUND_ONESHOT(4, 0x08);
+        ROUND_ONESHOT(5, 0x10);
+        ROUND_ONESHOT(6, 0x20);
+        ROUND_ONESHOT(7, 0x40);
+        ROUND_ONESHOT(8, 0x80);
+        ROUND_ONESHOT(9, 0x1b);
+        kr     = kexp_step(kr, 0x36);
+        kp[10] = kexp_step(kp[9], 0x36);
+    }
+    else if (ctx->kexpand != NULL) {
+        ctx->kexpand(ctx->roundkeys, k);
+        rk = ((const aes_roundkeys_t*)ctx->roundkeys)->rk;
+        kp[0] = _mm_loadu_si128((const __m128i*)(k + KEYBYTES));
+        y0 = _mm_xor_si128(y0, _mm_loadu_si128(rk));
+        y1 = _mm_xor_si128(y1, _mm_loadu_si128(rk));
+        ROUND_KEXP(1, 0x01);
+        ROUND_KEXP(2, 0x02);
+        ROUND_KEXP(3, 0x04);
+        ROUND_KEXP(4, 0x08);
+        ROUND_KEXP(5, 0x10);
+        ROUND_KEXP(6, 0x20);
+        ROUND_KEXP(7, 0x40);
+        ROUND_KEXP(8, 0x80);
+        ROUND_KEXP(9, 0x1b);
+        kp[10] = kexp_step(kp[9], 0x36);
+        kr = _mm_loadu_si128(rk + 10);
+    }
+    else {
+        rk = (const __m128i*)k;
+        for (i = 0; i < 11; i++)
+            kp[i] = _mm_loadu_si128((const __m128i*)(k + ctx->rkeys_size) + i);
+        y0 = _mm_xor_si128(y0, _mm_loadu_si128(rk));
+        y1 = _mm_xor_si128(y1, _mm_loadu_si128(rk));
+        for (i = 1; i < 10; i++) {
+            y0 = _mm_aesenc_si128(y0, _mm_loadu_si128(rk + i));
+            y1 = _mm_aesenc_si128(y1, _mm_loadu_si128(rk + i));
+        }
+        kr = _mm_loadu_si128(rk + 10);
+    }
+    y0 = _mm_aesenclast_si128(y0, kr);
+    y1 = _mm_aesenclast_si128(y1, kr);
+
+    // C <- M ^ Y0 ^ Y1 (resp. M <- C ^ Y0 ^ Y1)
+    *out = _mm_and_si128(_mm_xor_si128(in, _mm_xor_si128(y0, y1)), lenmask(mlen));
+    m = dec ? *out : in;
+
+    // T <- E_K'(Y0 ^ pad(N||M)) (resp. E_K'(Y0 ^ pad(M)))
+    if (cymric1)
+        m = _mm_or_si128(n, shift(m, nlen));
+    t = _mm_xor_si128(y0, _mm_or_si128(m, onehot(off + mlen, 0x80)));
+    t = _mm_xor_si128(t, kp[0]);
+    for (i = 1; i < 10; i++)
+        t = _mm_aesenc_si128(t, kp[i]);
+    return _mm_aesenclast_si128(t, kp[10]);
+}
+
+static inline int fused_enc(uint8_t c[], size_t *clen, const uint8_t k[],
+            const uint8_t n[], size_t nlen, const uint8_t m[], size_t mlen,
+            const uint8_t a[], size_t alen, int cymric1, const cipher_ctx_t* ctx)
+{
+    __m128i out, t;
+
+    if (mlen + (cymric1 ? nlen : 0) > BLOCKBYTES || mlen > BLOCKBYTES ||
+        nlen + alen > BLOCKBYTES - 1)
+        return -1;
+
+    t = fused(&out, k, load_pad(n, nlen), nlen, load_pad(a, alen), alen,
+            load_pad(m, mlen), mlen, cymric1, 0, ctx);
+    // the bytes of C beyond mlen are overwritten by the tag
+    _mm_storeu_si128((__m128i*)c, out);
+    _mm_storeu_si128((__m128i*)(c + mlen), t);
+    *clen = mlen + TAGBYTES;
+    return 0;
+}
+
+static inline int fused_dec(uint8_t m[], size_t *mlen, const uint8_t k[],
+            const uint8_t n[], size_t nlen, const uint8_t c[], size_t clen,
+            const uint8_t a[], size_t alen, int cymric1, const cipher_ctx_t* ctx)
+{
+    uint8_t tmp[BLOCKBYTES];
+    __m128i out, t;
+
+    clen -= TAGBYTES;
+
+    if (clen + (cymric1 ? nlen : 0) > BLOCKBYTES || clen > BLOCKBYTES ||
+        nlen + alen > BLOCKBYTES - 1)
+        return -1;
+
+    t = fused(&out, k, load_pad(n, nlen), nlen, load_pad(a, alen), alen,
+            load_pad(c, clen), clen, cymric1, 1, ctx);
+
+    // do not release plaintext if erroneous tag
+    _mm_storeu_si128((__m128i*)tmp, t);
+    if (sec_memcmp(tmp, c + clen, TAGBYTES) != 0) {
+        memset(m, 0x00, clen);
+        *mlen = 0;
+        return 1;
+    }
+    _mm_storeu_si128((__m128i*)tmp, out);
+    memcpy(m, tmp, clen);
+    *mlen = clen;
+    return 0;
+}
+
+int cymric1_enc_fused(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx)
+{
+    return fused_enc(c, clen, k, n, nlen, m, mlen, a, alen, 1, ctx);
+}
+
+int cymric1_dec_fused(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx)
+{
+    return fused_dec(m, mlen, k, n, nlen, c, clen, a, alen, 1, ctx);
+}
+
+int cymric2_enc_fused(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx)
+{
+    return fused_enc(c, clen, k, n, nlen, m, mlen, a, alen, 0, ctx);
+}
+
+int cymric2_dec_fused(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx)
+{
+    return fused_dec(m, mlen, k, n, nlen, c, clen, a, alen, 0, ctx);
+}
+
+int cymric1_enc_oneshot(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen)
+{
+    return fused_enc(c, clen, k, n, nlen, m, mlen, a, alen, 1, NULL);
+}
+
+int cymric1_dec_oneshot(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen)
+{
+    return fused_dec(m, mlen, k, n, nlen, c, clen, a, alen, 1, NULL);
+}
+
+int cymric2_enc_oneshot(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen)
+{
+    return fused_enc(c, clen, k, n, nlen, m, mlen, a, alen, 0, NULL);
+}
+
+int cymric2_dec_oneshot(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen)
+{
+    return fused_dec(m, mlen, k, n, nlen, c, clen, a, alen, 0, NULL);
+}
@@ -0,0 +1,81 @@
+#ifndef CYMRIC_FUSED_H_
+#define CYMRIC_FUSED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+
+/**
+ * Single-message latency kernels for AES-NI, drop-in replacements for
+ * cymric1_enc, cymric1_dec, cymric2_enc and cymric2_dec (same parameters,
+ * same results and return codes) for contexts returned by
+ * aes_get_cipher_ctx, with or without online key expansion.
+ *
+ * The blocks are built in registers and the whole computation is a single
+ * hand-scheduled sequence: the AESENC chains of Y0 and Y1 are interleaved
+ * with each other and, when the keys are expanded online, with the expansion
+ * of K' (kept in registers, so that it is no longer serialized before the tag
+ * call), and the tag chain starts as soon as Y0 is available (Y0 and Y1 for
+ * decryption). The latency is thus close to one AES chain for Y0 and Y1 plus
+ * one for the tag, on top of the expansion of K when it is performed online.
+ */
+int cymric1_enc_fused(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+int cymric1_dec_fused(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+int cymric2_enc_fused(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+int cymric2_dec_fused(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+/**
+ * One-shot-key kernels, for keys used for a single message (e.g. per-message
+ * derived keys): same as cymric1_enc, cymric1_dec, cymric2_enc and
+ * cymric2_dec with online key expansion, k being the 32-byte key K||K', but
+ * the round keys of K and K' are generated in registers just in time and
+ * never stored, so that no context nor round key buffer is needed.
+ */
+int cymric1_enc_oneshot(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen);
+
+int cymric1_dec_oneshot(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen);
+
+int cymric2_enc_oneshot(uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen);
+
+int cymric2_dec_oneshot(uint8_t m[], size_t *mlen,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen);
+
+#endif
@@ -0,0 +1,490 @@
+/**
+ * @file cymric-gateway.c
+ *
+ * @brief Receive -> decrypt -> forward path for sealed UDP frames, over
+ * recvmmsg/sendmmsg or io_uring.
+ *
+ * Both backends process the frames of a batch the same way: their slots are
+ * gathered into the staging columns of the batch kernels with 16-byte
+ * loads, the batch is decrypted (and checked against the anti-replay filter),
+ * and the plaintexts are stored back into the C slots of the receive buffers,
+ * which are then forwarded.
+ *
+ * The io_uring backend is driven by raw system calls (no liburing). Datagrams
+ * are received by a single multishot receive into a ring of buffers provided
+ * to the kernel, and forwarded by sends issued straight from these buffers
+ * (which are not registered with IORING_REGISTER_BUFFERS: only the ring
+ * providing them is, so sends do not use fixed buffers);
+ * completions are reaped from the shared completion ring without any system
+ * call, and a single io_uring_enter per batch both submits the sends and
+ * collects the next completions.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <immintrin.h>
+#include "cymric-gateway.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#define HAVE_URING
+#endif
+#endif
+
+#define FRAME_N     16
+#define FRAME_A     32
+#define FRAME_C     48
+#define FRAME_T     64
+
+/**
+ * @brief Decrypt the frames of the current batch in place.
+ *
+ * @param size The size of each received datagram
+ *
+ * @return The number of authentic frames
+ */
+static size_t decrypt(cymric_gw_t* gw, size_t count, const size_t size[])
+{
+    cymric_soa_t* b = &gw->lanes;
+    size_t i, failed;
+
+    for (i = 0; i < count; i++) {
+        const uint8_t* f = gw->frame[i];
+
+        memcpy(&b->len[i], f, sizeof(cymric_len_t));
+        // malformed datagrams get invalid lengths, so that they fail
+        if (size[i] != CYMRIC_GW_FRAMEBYTES)
+            b->len[i].nlen = 0xff;
+        _mm_store_si128((__m128i*)b->n[i], _mm_loadu_si128((const __m128i*)(f + FRAME_N)));
+        _mm_store_si128((__m128i*)b->a[i], _mm_loadu_si128((const __m128i*)(f + FRAME_A)));
+        _mm_store_si128((__m128i*)b->c[i], _mm_loadu_si128((const __m128i*)(f + FRAME_C)));
+        _mm_store_si128((__m128i*)b->t[i], _mm_loadu_si128((const __m128i*)(f + FRAME_T)));
+    }
+
+    b->count = count;
+    if (gw->cfg.filter != NULL)
+        failed = (gw->cfg.variant == 1) ? cymric1_batch_dec_replay(b, gw->cfg.key, gw->cfg.filter, NULL)
+                                        : cymric2_batch_dec_replay(b, gw->cfg.key, gw->cfg.filter, NULL);
+    else
+        failed = (gw->cfg.variant == 1) ? cymric1_batch_dec(b, gw->cfg.key)
+                                        : cymric2_batch_dec(b, gw->cfg.key);
+
+    for (i = 0; i < count; i++) {
+        if (cymric_soa_ok(b, i))
+            _mm_storeu_si128((__m128i*)(gw->frame[i] + FRAME_C), _mm_load_si128((const __m128i*)b->m[i]));
+    }
+    gw->stats.received  += count;
+    gw->stats.forwarded += count - failed;
+    gw->stats.dropped   += failed;
+    gw->stats.batches++;
+    return count - failed;
+}
+
+/*
+ * recvmmsg/sendmmsg backend: the buffers of a batch are reused by the next
+ * one, since sendmmsg copies the forwarded frames.
+ */
+typedef struct {
+    struct mmsghdr rx[CYMRIC_GW_MAX_BATCH];
+    struct mmsghdr tx[CYMRIC_GW_MAX_BATCH];
+    struct iovec rxiov[CYMRIC_GW_MAX_BATCH];
+    struct iovec txiov[CYMRIC_GW_MAX_BATCH];
+} mmsg_t;
+
+static int mmsg_init(cymric_gw_t* gw)
+{
+    mmsg_t* mm;
+    unsigned int i;
+
+    gw->pool_size = (size_t)gw->cfg.batch*CYMRIC_GW_BUFBYTES + sizeof(mmsg_t);
+    gw->pool = mmap(NULL, gw->pool_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gw->pool == MAP_FAILED) {
+        gw->pool = NULL;
+        return -1;
+    }
+    mm = (mmsg_t*)(gw->pool + (size_t)gw->cfg.batch*CYMRIC_GW_BUFBYTES);
+    for (i = 0; i < gw->cfg.batch; i++) {
+        gw->frame[i] = gw->pool + (size_t)i*CYMRIC_GW_BUFBYTES;
+        mm->rxiov[i] = (struct iovec){gw->frame[i], CYMRIC_GW_BUFBYTES};
+        mm->rx[i].msg_hdr = (struct msghdr){.msg_iov = &mm->rxiov[i], .msg_iovlen = 1};
+    }
+    return 0;
+}
+
+static int mmsg_poll(cymric_gw_t* gw, int timeout_ms)
+{
+    mmsg_t* mm = (mmsg_t*)(gw->pool + (size_t)gw->cfg.batch*CYMRIC_GW_BUFBYTES);
+    size_t size[CYMRIC_GW_MAX_BATCH];
+    struct pollfd pfd = {.fd = gw->cfg.rx, .events = POLLIN};
+    int i, n, k = 0, sent;
+
+    n = recvmmsg(gw->cfg.rx, mm->rx, gw->cfg.batch, MSG_DONTWAIT, NULL);
+    gw->stats.syscalls++;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        gw->stats.syscalls += 2;
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            return 0;
+        n = recvmmsg(gw->cfg.rx, mm->rx, gw->cfg.batch, MSG_DONTWAIT, NULL);
+    }
+    if (n <= 0)
+        return (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ? -1 : 0;
+
+    for (i = 0; i < n; i++)
+        size[i] = mm->rx[i].msg_len;
+    decrypt(gw, n, size);
+
+    for (i = 0; i < n; i++) {
+        if (!cymric_soa_ok(&gw->lanes, i))
+            continue;
+        mm->txiov[k] = (struct iovec){gw->frame[i], CYMRIC_GW_FWDBYTES};
+        mm->tx[k].msg_hdr = (struct msghdr){.msg_iov = &mm->txiov[k], .msg_iovlen = 1};
+        k++;
+    }
+    for (i = 0; i < k; i += sent) {
+        sent = sendmmsg(gw->cfg.tx, mm->tx + i, k - i, 0);
+        gw->stats.syscalls++;
+        if (sent <= 0)
+            break;
+    }
+    return n;
+}
+
+#ifdef HAVE_URING
+
+#define TAG_RECV    (1ull << 32)    // user_data of the multishot receive
+#define TAG_SEND    (2ull << 32)    // user_data of a send, or'ed with the buffer index
+
+static int sys_setup(unsigned int entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+            unsigned int flags, void* arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned int op, void* arg, unsigned int nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+/**
+ * @brief Hand buffer bid back to the kernel (published by br_publish).
+ */
+static inline void br_add(cymric_gw_t* gw, unsigned int bid)
+{
+    struct io_uring_buf_ring* br = gw->ring.br;
+    struct io_uring_buf* b = &br->bufs[gw->ring.br_tail & (gw->cfg.buffers - 1)];
+
+    b->addr = (uint64_t)(uintptr_t)(gw->pool + (size_t)bid*CYMRIC_GW_BUFBYTES);
+    b->len  = CYMRIC_GW_BUFBYTES;
+    b->bid  = (uint16_t)bid;
+    gw->ring.br_tail++;
+}
+
+static inline void br_publish(cymric_gw_t* gw)
+{
+    struct io_uring_buf_ring* br = gw->ring.br;
+
+    __atomic_store_n(&br->tail, (uint16_t)gw->ring.br_tail, __ATOMIC_RELEASE);
+}
+
+static int uring_submit(cymric_gw_t* gw, unsigned int min_complete, int timeout_ms)
+{
+    cymric_gw_uring_t* r = &gw->ring;
+    struct __kernel_timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000ll};
+    struct io_uring_getevents_arg arg = {
+        .sigmask = 0, .sigmask_sz = _NSIG / 8, .ts = (uint64_t)(uintptr_t)&ts,
+    };
+    int ret;
+
+    ret = sys_enter(r->fd, r->to_submit, min_complete,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    gw->stats.syscalls++;
+    if (ret >= 0) {
+        r->to_submit -= ((unsigned int)ret < r->to_submit) ? (unsigned int)ret : r->to_submit;
+        return 0;
+    }
+    return (errno == ETIME || errno == EINTR) ? 0 : -1;
+}
+
+/**
+ * @brief Get a free SQE, submitting the queued ones if the ring is full.
+ */
+static struct io_uring_sqe* uring_sqe(cymric_gw_t* gw)
+{
+    cymric_gw_uring_t* r = &gw->ring;
+    unsigned int tail = *r->sq_tail, head;
+    struct io_uring_sqe* sqe;
+
+    head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head > *r->sq_mask) {
+        if (uring_submit(gw, 0, 0) != 0)
+            return NULL;
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head > *r->sq_mask)
+            return NULL;
+    }
+    sqe = (struct io_uring_sqe*)r->sqes + (tail & *r->sq_mask);
+    memset(sqe, 0x00, sizeof(*sqe));
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+    return sqe;
+}
+
+static void uring_arm(cymric_gw_t* gw)
+{
+    struct io_uring_sqe* sqe = uring_sqe(gw);
+
+    if (sqe == NULL)
+        return;
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = 0;     // registered file: rx
+    sqe->flags     = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->buf_group = 0;
+    sqe->user_data = TAG_RECV;
+    gw->ring.armed = 1;
+}
+
+static void uring_close(cymric_gw_t* gw)
+{
+    cymric_gw_uring_t* r = &gw->ring;
+
+    if (r->fd >= 0)
+        close(r->fd);
+    if (r->br != NULL)
+        munmap(r->br, r->br_size);
+    if (r->sqes != NULL)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_map != NULL && r->cq_map != r->sq_map)
+        munmap(r->cq_map, r->cq_size);
+    if (r->sq_map != NULL)
+        munmap(r->sq_map, r->sq_size);
+    memset(r, 0x00, sizeof(*r));
+    r->fd = -1;
+}
+
+static int uring_init(cymric_gw_t* gw)
+{
+    cymric_gw_uring_t* r = &gw->ring;
+    struct io_uring_params p;
+    struct io_uring_buf_reg reg;
+    unsigned int i, entries = 1;
+    int fds[2] = {gw->cfg.rx, gw->cfg.tx};
+
+    // room for the sends of a batch, plus the receive
+    while (entries < 2*gw->cfg.batch)
+        entries <<= 1;
+    memset(&p, 0x00, sizeof(p));
+    // completions are only posted when the gateway asks for them
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = 2*gw->cfg.buffers;
+    if ((r->fd = sys_setup(entries, &p)) < 0) {
+        memset(&p, 0x00, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = 2*gw->cfg.buffers;
+        if ((r->fd = sys_setup(entries, &p)) < 0)
+            return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG))
+        goto fail;
+
+    r->sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+    r->cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    r->sq_size = (r->cq_size > r->sq_size) ? r->cq_size : r->sq_size;
+    r->sq_map  = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) {
+        r->sq_map = NULL;
+        goto fail;
+    }
+    r->cq_map    = r->sq_map;
+    r->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    r->sqes      = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+    r->sq_head = (unsigned int*)((uint8_t*)r->sq_map + p.sq_off.head);
+    r->sq_tail = (unsigned int*)((uint8_t*)r->sq_map + p.sq_off.tail);
+    r->sq_mask = (unsigned int*)((uint8_t*)r->sq_map + p.sq_off.ring_mask);
+    r->cq_head = (unsigned int*)((uint8_t*)r->cq_map + p.cq_off.head);
+    r->cq_tail = (unsigned int*)((uint8_t*)r->cq_map + p.cq_off.tail);
+    r->cq_mask = (unsigned int*)((uint8_t*)r->cq_map + p.cq_off.ring_mask);
+    r->cqes    = (uint8_t*)r->cq_map + p.cq_off.cqes;
+    for (i = 0; i < p.sq_entries; i++)
+        ((unsigned int*)((uint8_t*)r->sq_map + p.sq_off.array))[i] = i;
+
+    if (sys_register(r->fd, IORING_REGISTER_FILES, fds, 2) != 0)
+        goto fail;
+
+    // receive buffers and the ring providing them to the kernel
+    gw->pool_size = (size_t)gw->cfg.buffers*CYMRIC_GW_BUFBYTES;
+    gw->pool = mmap(NULL, gw->pool_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (gw->pool == MAP_FAILED) {
+        gw->pool = NULL;
+        goto fail;
+    }
+    r->br_size = (size_t)gw->cfg.buffers*sizeof(struct io_uring_buf);
+    r->br = mmap(NULL, r->br_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (r->br == MAP_FAILED) {
+        r->br = NULL;
+        goto fail;
+    }
+    memset(&reg, 0x00, sizeof(reg));
+    reg.ring_addr    = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = gw->cfg.buffers;
+    reg.bgid         = 0;
+    if (sys_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        goto fail;
+    for (i = 0; i < gw->cfg.buffers; i++)
+        br_add(gw, i);
+    br_publish(gw);
+    uring_arm(gw);
+    return 0;
+
+fail:
+    uring_close(gw);
+    return -1;
+}
+
+/**
+ * @brief Reap up to batch received frames from the completion ring, handing
+ * back the buffers of completed sends on the way.
+ *
+ * @return The number of frames
+ */
+static size_t uring_reap(cymric_gw_t* gw, size_t size[])
+{
+    cymric_gw_uring_t* r = &gw->ring;
+    unsigned int head = *r->cq_head;
+    unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe* cqe = (const struct io_uring_cqe*)r->cqes + (head & *r->cq_mask);
+
+        if (cqe->user_data == TAG_RECV) {
+            if (count == gw->cfg.batch)
+                break;
+            if (!(cqe->flags & IORING_CQE_F_MORE))
+                r->armed = 0;
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+                gw->bid[count]   = bid;
+                gw->frame[count] = gw->pool + (size_t)bid*CYMRIC_GW_BUFBYTES;
+                size[count++]    = (cqe->res > 0) ? (size_t)cqe->res : 0;
+            }
+        }
+        else
+            br_add(gw, (unsigned int)(cqe->user_data & 0xffffffff));
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+static int uring_poll(cymric_gw_t* gw, int timeout_ms)
+{
+    cymric_gw_uring_t* r = &gw->ring;
+    size_t size[CYMRIC_GW_MAX_BATCH];
+    size_t i, count;
+
+    if ((count = uring_reap(gw, size)) == 0) {
+        br_publish(gw);
+        if (!r->armed)
+            uring_arm(gw);
+        if (uring_submit(gw, 1, timeout_ms) != 0)
+            return -1;
+        if ((count = uring_reap(gw, size)) == 0) {
+            br_publish(gw);
+            return 0;
+        }
+    }
+
+    decrypt(gw, count, size);
+    for (i = 0; i < count; i++) {
+        struct io_uring_sqe* sqe;
+
+        if (!cymric_soa_ok(&gw->lanes, i) || (sqe = uring_sqe(gw)) == NULL) {
+            br_add(gw, gw->bid[i]);
+            continue;
+        }
+        // forwarded from the receive buffer, which is handed back on completion
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = 1;     // registered file: tx
+        sqe->flags     = IOSQE_FIXED_FILE;
+        sqe->addr      = (uint64_t)(uintptr_t)gw->frame[i];
+        sqe->len       = CYMRIC_GW_FWDBYTES;
+        sqe->user_data = TAG_SEND | gw->bid[i];
+    }
+    br_publish(gw);
+    if (!r->armed)
+        uring_arm(gw);
+    // submit the sends and collect the completions of the next batch
+    if (uring_submit(gw, 0, 0) != 0)
+        return -1;
+    return (int)count;
+}
+
+#endif
+
+int cymric_gw_init(cymric_gw_t* gw, const cymric_gw_config_t* cfg)
+{
+    memset(gw, 0x00, sizeof(cymric_gw_t));
+    gw->ring.fd = -1;
+    gw->cfg = *cfg;
+    if (cfg->key == NULL || (cfg->variant != 1 && cfg->variant != 2) ||
+        cfg->batch == 0 || cfg->batch > CYMRIC_GW_MAX_BATCH)
+        return -1;
+    if (cymric_soa_alloc(&gw->lanes, CYMRIC_GW_MAX_BATCH) != 0)
+        return -1;
+
+    if (cfg->backend == CYMRIC_GW_RECVMMSG && mmsg_init(gw) == 0)
+        return 0;
+#ifdef HAVE_URING
+    // buffer indices are 16-bit, and every buffer may hold a completion
+    if (cfg->backend == CYMRIC_GW_URING && cfg->buffers >= cfg->batch &&
+        cfg->buffers <= 32768 && (cfg->buffers & (cfg->buffers - 1)) == 0 &&
+        uring_init(gw) == 0)
+        return 0;
+#endif
+    cymric_gw_close(gw);
+    return -1;
+}
+
+int cymric_gw_poll(cymric_gw_t* gw, int timeout_ms)
+{
+#ifdef HAVE_URING
+    if (gw->cfg.backend == CYMRIC_GW_URING)
+        return uring_poll(gw, timeout_ms);
+#endif
+    return mmsg_poll(gw, timeout_ms);
+}
+
+void cymric_gw_close(cymric_gw_t* gw)
+{
+#ifdef HAVE_URING
+    if (gw->cfg.backend == CYMRIC_GW_URING)
+        uring_close(gw);
+#endif
+    if (gw->pool != NULL)
+        munmap(gw->pool, gw->pool_size);
+    gw->pool = NULL;
+    cymric_soa_free(&gw->lanes);
+}
@@ -0,0 +1,111 @@
+#ifndef CYMRIC_GATEWAY_H_
+#define CYMRIC_GATEWAY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "cymric-batch.h"
+#include "cymric-replay.h"
+
+/**
+ * Frames exchanged by the gateway are UDP datagrams laid out in 16-byte
+ * slots, so that the batch kernels move whole blocks between the receive
+ * buffers and their lanes:
+ * ~~~
+ *   0  nlen, alen, mlen, 0 (cymric_len_t)
+ *   4  reserved (e.g. a device identifier, forwarded as is)
+ *  16  N (zero padded slot)
+ *  32  A (zero padded slot)
+ *  48  C (zero padded slot), replaced by M when forwarded
+ *  64  T
+ * ~~~
+ * The gateway receives sealed frames (CYMRIC_GW_FRAMEBYTES), decrypts them in
+ * place in their receive buffer and forwards the first CYMRIC_GW_FWDBYTES
+ * bytes (i.e. without the tag) of the authentic ones.
+ */
+#define CYMRIC_GW_FRAMEBYTES    80
+#define CYMRIC_GW_FWDBYTES      64
+#define CYMRIC_GW_BUFBYTES      128     // stride of the receive buffers
+#define CYMRIC_GW_MAX_BATCH     256     // maximum number of frames per batch
+
+// receive/forward backends
+#define CYMRIC_GW_RECVMMSG      0       // recvmmsg + sendmmsg, two syscalls per batch
+#define CYMRIC_GW_URING         1       // io_uring, one syscall per batch
+
+typedef struct {
+    int backend;                // CYMRIC_GW_RECVMMSG or CYMRIC_GW_URING
+    int variant;                // 1 or 2
+    const cymric_batch_key_t* key;
+    cymric_replay_t* filter;    // anti-replay filter (may be NULL)
+    int rx;                     // bound UDP socket receiving the sealed frames
+    int tx;                     // UDP socket connected to the destination
+    unsigned int batch;         // maximum number of frames per batch
+    unsigned int buffers;       // number of receive buffers (power of two, io_uring only)
+} cymric_gw_config_t;
+
+typedef struct {
+    uint64_t received;          // frames received
+    uint64_t forwarded;         // frames authentic and forwarded
+    uint64_t dropped;           // malformed, forged or replayed frames
+    uint64_t batches;           // number of batches processed
+    uint64_t syscalls;          // number of system calls issued
+} cymric_gw_stats_t;
+
+/**
+ * State of the io_uring backend: the rings mapped from the kernel, along with
+ * the ring of receive buffers provided to the kernel (registered with
+ * IORING_REGISTER_PBUF_RING) into which a multishot receive writes the
+ * datagrams. A buffer is handed back to the kernel once its frame is dropped
+ * or its forwarding send has completed.
+ */
+typedef struct {
+    int fd;
+    void* sq_map;
+    size_t sq_size;
+    void* cq_map;
+    size_t cq_size;
+    void* sqes;
+    size_t sqes_size;
+    unsigned int *sq_head, *sq_tail, *sq_mask;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    void* cqes;
+    void* br;                   // provided buffer ring
+    size_t br_size;
+    unsigned int br_tail;       // local tail, published once per batch
+    unsigned int to_submit;     // SQEs queued since the last io_uring_enter
+    int armed;                  // multishot receive active
+} cymric_gw_uring_t;
+
+typedef struct {
+    cymric_gw_config_t cfg;
+    cymric_gw_stats_t stats;
+    uint8_t* pool;              // receive buffers (CYMRIC_GW_BUFBYTES each)
+    size_t pool_size;
+    cymric_soa_t lanes;         // staging columns of the batch kernels
+    uint8_t* frame[CYMRIC_GW_MAX_BATCH];    // frames of the current batch
+    unsigned int bid[CYMRIC_GW_MAX_BATCH];  // their buffer index
+    cymric_gw_uring_t ring;
+} cymric_gw_t;
+
+/**
+ * @brief Initialize a gateway over two sockets provided by the caller.
+ *
+ * @return 0 if successfully executed, -1 otherwise (invalid configuration,
+ *      allocation failure, or backend not supported by the kernel)
+ */
+int cymric_gw_init(cymric_gw_t* gw, const cymric_gw_config_t* cfg);
+
+/**
+ * @brief Receive a batch of frames (waiting at most timeout_ms milliseconds
+ * for the first one), decrypt them and forward the authentic ones.
+ *
+ * @return The number of frames received, 0 on timeout, -1 on error
+ */
+int cymric_gw_poll(cymric_gw_t* gw, int timeout_ms);
+
+/**
+ * @brief Release the resources of a gateway (the sockets are not closed).
+ */
+void cymric_gw_close(cymric_gw_t* gw);
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file cymric-mb.c
+ *
+ * @brief Multi-buffer job manager over the lane kernels of cymric-batch.c.
+ *
+ * Each (variant, direction) pair has its own set of lanes, filled in order.
+ * When the last lane of a set is filled, the set is processed at once by
+ * cymric_batch_lanes and its jobs are appended to the queue of completed
+ * jobs, which submit, get_completed and flush pop one job at a time. Since
+ * every submission pops a job when one is available, the queue never holds
+ * more than CYMRIC_MB_SETS*CYMRIC_BATCH_LANES + 1 jobs.
+ */
+#include <string.h>
+#include <immintrin.h>
+#include "cymric-mb.h"
+#include "cymric-trace.h"
+
+/**
+ * @brief Copy len bytes (at most 16) between a caller buffer and a slot. With
+ * AVX-512 this is a single masked load or store, which never touches the
+ * bytes beyond len (faults included); otherwise a plain memcpy.
+ */
+static inline void load_slot(uint8_t slot[], const uint8_t* p, size_t len)
+{
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+    _mm_storeu_si128((__m128i*)slot, _mm_maskz_loadu_epi8(_bzhi_u32(0xffff, len), p));
+#else
+    memcpy(slot, p, len);
+#endif
+}
+
+static inline void store_slot(uint8_t* p, const uint8_t slot[], size_t len)
+{
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+    _mm_mask_storeu_epi8(p, _bzhi_u32(0xffff, len), _mm_loadu_si128((const __m128i*)slot));
+#else
+    memcpy(p, slot, len);
+#endif
+}
+
+static inline unsigned int set_index(int variant, int dir)
+{
+    return 2*(variant - 1) + dir;
+}
+
+static void complete(cymric_mb_mgr_t* mgr, cymric_job_t* job)
+{
+    mgr->done[mgr->tail++ % CYMRIC_MB_QUEUE] = job;
+}
+
+/**
+ * @brief Check the parameters and lengths of a job.
+ *
+ * @return The message length, or -1 if the job is invalid
+ */
+static long job_mlen(const cymric_job_t* job)
+{
+    size_t mlen;
+
+    if (job->key == NULL || (job->variant != 1 && job->variant != 2) ||
+        (job->dir != CYMRIC_JOB_ENC && job->dir != CYMRIC_JOB_DEC) ||
+        job->out == NULL || job->nlen + job->alen > BLOCKBYTES - 1)
+        return -1;
+    if (job->dir == CYMRIC_JOB_DEC && job->inlen < TAGBYTES)
+        return -1;
+    mlen = (job->dir == CYMRIC_JOB_ENC) ? job->inlen : job->inlen - TAGBYTES;
+    if (mlen > BLOCKBYTES || (job->variant == 1 && job->nlen + mlen > BLOCKBYTES))
+        return -1;
+    return (long)mlen;
+}
+
+/**
+ * @brief Process the filled lanes of a set and queue their jobs in lane order.
+ */
+static void process(cymric_mb_mgr_t* mgr, cymric_mb_lanes_t* l, int variant, int dir)
+{
+    unsigned int j, ok;
+
+    l->b.count = l->used;
+    ok = cymric_batch_lanes(&l->b, &l->keys, variant, dir == CYMRIC_JOB_DEC);
+
+    for (j = 0; j < l->used; j++) {
+        cymric_job_t* job = l->job[j];
+        size_t mlen = l->len[j].mlen;
+
+        if (dir == CYMRIC_JOB_ENC) {
+            store_slot(job->out, l->c[j], mlen);
+            store_slot(job->out + mlen, l->t[j], TAGBYTES);
+            job->outlen = mlen + TAGBYTES;
+        }
+        else {
+            store_slot(job->out, l->m[j], mlen);
+            job->outlen = mlen;
+        }
+        job->status = ((ok >> j) & 1) ? CYMRIC_JOB_OK : CYMRIC_JOB_AUTH;
+        l->job[j] = NULL;
+        complete(mgr, job);
+    }
+    l->used = 0;
+}
+
+void cymric_mb_init(cymric_mb_mgr_t* mgr)
+{
+    unsigned int i;
+
+    memset(mgr, 0x00, sizeof(cymric_mb_mgr_t));
+    for (i = 0; i < CYMRIC_MB_SETS; i++) {
+        cymric_mb_lanes_t* l = &mgr->lanes[i];
+
+        l->b = (cymric_soa_t){
+            .n = l->n, .a = l->a, .m = l->m, .c = l->c, .t = l->t,
+            .len = l->len, .ok = &l->ok, .count = 0, .mem = NULL,
+        };
+    }
+}
+
+cymric_job_t* cymric_mb_get_completed(cymric_mb_mgr_t* mgr)
+{
+    if (mgr->head == mgr->tail)
+        return NULL;
+    return mgr->done[mgr->head++ % CYMRIC_MB_QUEUE];
+}
+
+cymric_job_t* cymric_mb_submit(cymric_mb_mgr_t* mgr, cymric_job_t* job)
+{
+    long mlen = job_mlen(job);
+    cymric_mb_lanes_t* l;
+    unsigned int j;
+
+    if (mlen < 0) {
+        job->status = CYMRIC_JOB_INVALID;
+        job->outlen = 0;
+        complete(mgr, job);
+        return cymric_mb_get_completed(mgr);
+    }
+
+    l = &mgr->lanes[set_index(job->variant, job->dir)];
+    j = l->used++;
+    if (j == 0)
+        l->seq = mgr->seq;
+    mgr->seq++;
+    job->status = CYMRIC_JOB_PENDING;
+    l->job[j] = job;
+    if (l->lane_key[j] != job->key || l->lane_epoch[j] != job->key->epoch) {
+        CYMRIC_TRACE_KEY_MISS(j, job->key, job->key->epoch);
+        cymric_lane_keys_set(&l->keys, j, job->key);
+        l->lane_key[j]   = job->key;
+        l->lane_epoch[j] = job->key->epoch;
+    }
+
+    // copy into the slots, bytes beyond the lengths being ignored by the kernel
+    l->len[j] = (cymric_len_t){job->nlen, job->alen, (uint8_t)mlen, 0};
+    load_slot(l->n[j], job->n, job->nlen);
+    load_slot(l->a[j], job->a, job->alen);
+    if (job->dir == CYMRIC_JOB_ENC)
+        load_slot(l->m[j], job->in, mlen);
+    else {
+        load_slot(l->c[j], job->in, mlen);
+        load_slot(l->t[j], job->in + mlen, TAGBYTES);
+    }
+
+    if (l->used == CYMRIC_BATCH_LANES)
+        process(mgr, l, job->variant, job->dir);
+    return cymric_mb_get_completed(mgr);
+}
+
+cymric_job_t* cymric_mb_flush(cymric_mb_mgr_t* mgr)
+{
+    cymric_mb_lanes_t* oldest = NULL;
+    unsigned int i, k = 0;
+
+    if (mgr->head != mgr->tail)
+        return cymric_mb_get_completed(mgr);
+    for (i = 0; i < CYMRIC_MB_SETS; i++) {
+        cymric_mb_lanes_t* l = &mgr->lanes[i];
+
+        if (l->used > 0 && (oldest == NULL || l->seq < oldest->seq)) {
+            oldest = l;
+            k = i;
+        }
+    }
+    if (oldest == NULL)
+        return NULL;
+    process(mgr, oldest, k/2 + 1, k % 2);
+    return cymric_mb_get_completed(mgr);
+}
+
+size_t cymric_mb_in_flight(const cymric_mb_mgr_t* mgr)
+{
+    size_t count = mgr->tail - mgr->head;
+    unsigned int i;
+
+    for (i = 0; i < CYMRIC_MB_SETS; i++)
+        count += mgr->lanes[i].used;
+    return count;
+}
@@ -0,0 +1,120 @@
+#ifndef CYMRIC_MB_H_
+#define CYMRIC_MB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "cymric-batch.h"
+
+#define CYMRIC_MB_SETS      4       // lane sets: (Cymric1, Cymric2) x (enc, dec)
+#define CYMRIC_MB_QUEUE     64      // completed jobs queue (> CYMRIC_MB_SETS*CYMRIC_BATCH_LANES)
+
+// directions of a job
+#define CYMRIC_JOB_ENC      0
+#define CYMRIC_JOB_DEC      1
+
+// status of a job, the completed ones matching the return codes of cymric*_enc/dec
+#define CYMRIC_JOB_OK       0       // completed
+#define CYMRIC_JOB_AUTH     1       // completed, invalid tag (output zeroed)
+#define CYMRIC_JOB_INVALID  -1      // completed, invalid parameters or lengths
+#define CYMRIC_JOB_PENDING  2       // submitted, not completed yet
+
+/**
+ * A message to encrypt or decrypt, owned by the caller until the manager
+ * hands it back. Buffers must remain valid and unchanged while the job is
+ * pending. The manager caches the round keys of each lane by the address and
+ * the epoch of the key object, so that key objects may be re-initialized with
+ * cymric_batch_key_init (or their memory reused for other keys) at any time,
+ * but not modified by other means while the manager is in use.
+ */
+typedef struct {
+    const cymric_batch_key_t* key;  // round keys of K||K'
+    int variant;                // 1 or 2
+    int dir;                    // CYMRIC_JOB_ENC or CYMRIC_JOB_DEC
+    const uint8_t* n;           // nonce
+    size_t nlen;
+    const uint8_t* a;           // additional data
+    size_t alen;
+    const uint8_t* in;          // M (encryption) or C||T (decryption)
+    size_t inlen;
+    uint8_t* out;               // C||T (inlen+TAGBYTES) or M (inlen-TAGBYTES)
+    size_t outlen;              // set on completion
+    int status;                 // set by the manager
+    void* user_data;            // left untouched
+} cymric_job_t;
+
+/**
+ * Lanes of one variant and direction: jobs are copied into the fixed 16-byte
+ * slots of a batch of CYMRIC_BATCH_LANES messages, along with the round keys
+ * of their key when it differs from the previous job of the lane.
+ */
+typedef struct {
+    cymric_lane_keys_t keys;
+    const cymric_batch_key_t* lane_key[CYMRIC_BATCH_LANES];
+    uint64_t lane_epoch[CYMRIC_BATCH_LANES];
+    cymric_job_t* job[CYMRIC_BATCH_LANES];
+    uint8_t n[CYMRIC_BATCH_LANES][BLOCKBYTES];
+    uint8_t a[CYMRIC_BATCH_LANES][BLOCKBYTES];
+    uint8_t m[CYMRIC_BATCH_LANES][BLOCKBYTES];
+    uint8_t c[CYMRIC_BATCH_LANES][BLOCKBYTES];
+    uint8_t t[CYMRIC_BATCH_LANES][TAGBYTES];
+    cymric_len_t len[CYMRIC_BATCH_LANES];
+    uint64_t ok;
+    cymric_soa_t b;             // view over the slots above
+    unsigned int used;          // number of lanes filled
+    uint64_t seq;               // submission number of the job of lane 0
+} cymric_mb_lanes_t;
+
+/**
+ * Multi-buffer job manager (in the style of the out-of-order managers of
+ * intel-ipsec-mb): jobs submitted one at a time are gathered in lanes and
+ * processed CYMRIC_BATCH_LANES at a time by the lane kernels, so that
+ * producers get the throughput of the batch functions without building
+ * batches. Jobs may complete out of order (e.g. invalid jobs complete at
+ * once, and the lanes of each variant and direction fill independently).
+ *
+ * A manager is not thread-safe: each producer thread should own one.
+ */
+typedef struct {
+    cymric_mb_lanes_t lanes[CYMRIC_MB_SETS];
+    cymric_job_t* done[CYMRIC_MB_QUEUE];
+    size_t head;                // next completed job to return
+    size_t tail;                // next free entry of done
+    uint64_t seq;               // number of jobs submitted
+} cymric_mb_mgr_t;
+
+/**
+ * @brief Initialize a job manager.
+ */
+void cymric_mb_init(cymric_mb_mgr_t* mgr);
+
+/**
+ * @brief Submit a job. The job is processed once its lanes are all filled
+ * (or on cymric_mb_flush).
+ *
+ * @return A completed job (the oldest one not returned yet), or NULL if none
+ */
+cymric_job_t* cymric_mb_submit(cymric_mb_mgr_t* mgr, cymric_job_t* job);
+
+/**
+ * @brief Return a completed job without submitting any.
+ *
+ * @return A completed job, or NULL if none
+ */
+cymric_job_t* cymric_mb_get_completed(cymric_mb_mgr_t* mgr);
+
+/**
+ * @brief Return a completed job, processing partially filled lanes (the ones
+ * holding the oldest job first) if none is completed. Calling it until it
+ * returns NULL drains the manager.
+ *
+ * @return A completed job, or NULL if the manager holds no job
+ */
+cymric_job_t* cymric_mb_flush(cymric_mb_mgr_t* mgr);
+
+/**
+ * @brief Number of jobs submitted but not returned yet.
+ */
+size_t cymric_mb_in_flight(const cymric_mb_mgr_t* mgr);
+
+#endif
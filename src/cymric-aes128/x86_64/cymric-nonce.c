@@ -0,0 +1 @@
+../../cymric/cymric-nonce.c
\ No newline at end of file
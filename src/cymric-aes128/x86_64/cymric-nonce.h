@@ -0,0 +1 @@
+../../cymric/cymric-nonce.h
\ No newline at end of file
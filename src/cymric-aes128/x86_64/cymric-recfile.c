@@ -0,0 +1,385 @@
+/**
+ * @file cymric-recfile.c
+ *
+ * @brief Random-access file of individually sealed records.
+ *
+ * Records are sealed and scanned a block at a time with the batch functions,
+ * while point lookups locate a record from the block index and the lengths of
+ * its block, and decrypt it alone with the precomputed round keys of K and
+ * K' (see cymric_batch_key_t), i.e. with three AES calls and no key
+ * expansion.
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cymric-recfile.h"
+
+static void store_le(uint8_t* p, uint64_t x, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        p[i] = x >> (8*i);
+}
+
+static uint64_t load_le(const uint8_t* p, size_t len)
+{
+    uint64_t x = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        x |= (uint64_t)p[i] << (8*i);
+    return x;
+}
+
+static void store_be64(uint8_t* p, uint64_t x)
+{
+    unsigned int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = x >> (56 - 8*i);
+}
+
+static uint64_t load_be64(const uint8_t* p)
+{
+    uint64_t x = 0;
+    unsigned int i;
+
+    for (i = 0; i < 8; i++)
+        x = (x << 8) | p[i];
+    return x;
+}
+
+static size_t max_len(int variant)
+{
+    return (variant == 1) ? BLOCKBYTES - CYMRIC_RF_NONCEBYTES : BLOCKBYTES;
+}
+
+/**
+ * @brief Cipher context using the round keys of a batch key as is, since K
+ * and K' are contiguous there.
+ */
+static cipher_ctx_t rkeys_ctx(void)
+{
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+
+    ctx.kexpand   = NULL;
+    ctx.roundkeys = NULL;
+    return ctx;
+}
+
+/**
+ * @brief Seal (resp. open) the number of records with nonce 2^64-1.
+ */
+static int count_enc(uint8_t sealed[CYMRIC_RF_NONCEBYTES + TAGBYTES], uint64_t count,
+            int variant, const uint8_t id[], size_t idlen, const cymric_batch_key_t* key)
+{
+    const uint8_t n[CYMRIC_RF_NONCEBYTES] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    cipher_ctx_t ctx = rkeys_ctx();
+    uint8_t m[CYMRIC_RF_NONCEBYTES];
+    size_t len;
+
+    store_be64(m, count);
+    return (variant == 1 ? cymric1_enc : cymric2_enc)(sealed, &len, (const uint8_t*)key->rk,
+        n, sizeof(n), m, sizeof(m), id, idlen, &ctx);
+}
+
+static int count_dec(uint64_t* count, const uint8_t sealed[CYMRIC_RF_NONCEBYTES + TAGBYTES],
+            int variant, const uint8_t id[], size_t idlen, const cymric_batch_key_t* key)
+{
+    const uint8_t n[CYMRIC_RF_NONCEBYTES] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    cipher_ctx_t ctx = rkeys_ctx();
+    uint8_t m[CYMRIC_RF_NONCEBYTES];
+    size_t len;
+    int ret;
+
+    ret = (variant == 1 ? cymric1_dec : cymric2_dec)(m, &len, (const uint8_t*)key->rk,
+        n, sizeof(n), sealed, CYMRIC_RF_NONCEBYTES + TAGBYTES, id, idlen, &ctx);
+    *count = load_be64(m);
+    return ret;
+}
+
+int cymric_rf_create(cymric_rf_writer_t* w, const char* path, int variant,
+            const uint8_t id[], size_t idlen, unsigned int block_records,
+            const uint8_t k[])
+{
+    uint8_t header[CYMRIC_RF_HEADERBYTES] = {0x00};
+    unsigned int i;
+
+    if ((variant != 1 && variant != 2) || idlen > CYMRIC_RF_MAX_IDBYTES)
+        return -1;
+    if (block_records == 0 || block_records > CYMRIC_RF_MAX_BLOCK)
+        return -1;
+    if (cymric_soa_alloc(&w->blk, block_records) != 0)
+        return -1;
+    w->f = fopen(path, "wb");
+    if (w->f == NULL || fwrite(header, 1, sizeof(header), w->f) != sizeof(header)) {
+        if (w->f != NULL)
+            fclose(w->f);
+        cymric_soa_free(&w->blk);
+        return -1;
+    }
+
+    w->variant       = variant;
+    w->idlen         = idlen;
+    w->block_records = block_records;
+    w->pending       = 0;
+    w->count         = 0;
+    w->index         = NULL;
+    w->nblocks       = 0;
+    w->capacity      = 0;
+    w->offset        = CYMRIC_RF_HEADERBYTES;
+    memcpy(w->id, id, idlen);
+    cymric_batch_key_init(&w->key, k);
+    for (i = 0; i < block_records; i++)
+        memcpy(w->blk.a[i], id, idlen);
+    return 0;
+}
+
+/**
+ * @brief Seal the pending records and write them as a block.
+ */
+static int flush_block(cymric_rf_writer_t* w)
+{
+    uint8_t lens[CYMRIC_RF_MAX_BLOCK];
+    cymric_soa_t view;
+    size_t i, size = w->pending;
+
+    if (w->nblocks == w->capacity) {
+        size_t capacity = w->capacity ? 2*w->capacity : 64;
+        uint64_t* index = realloc(w->index, capacity*sizeof(uint64_t));
+
+        if (index == NULL)
+            return -1;
+        w->index    = index;
+        w->capacity = capacity;
+    }
+
+    cymric_soa_slice(&view, &w->blk, 0, w->pending);
+    if (w->variant == 1)
+        cymric1_batch_enc(&view, &w->key);
+    else
+        cymric2_batch_enc(&view, &w->key);
+
+    for (i = 0; i < w->pending; i++)
+        lens[i] = w->blk.len[i].mlen;
+    if (fwrite(lens, 1, w->pending, w->f) != w->pending)
+        return -1;
+    for (i = 0; i < w->pending; i++) {
+        if (fwrite(w->blk.c[i], 1, lens[i], w->f) != lens[i] ||
+            fwrite(w->blk.t[i], 1, TAGBYTES, w->f) != TAGBYTES)
+            return -1;
+        size += lens[i] + TAGBYTES;
+    }
+
+    w->index[w->nblocks++] = w->offset;
+    w->offset += size;
+    w->pending = 0;
+    return 0;
+}
+
+int cymric_rf_append(cymric_rf_writer_t* w, const uint8_t m[], size_t mlen)
+{
+    size_t i = w->pending;
+
+    if (mlen > max_len(w->variant) || w->count == UINT64_MAX - 1)
+        return -1;
+    memcpy(w->blk.m[i], m, mlen);
+    store_be64(w->blk.n[i], w->count);
+    w->blk.len[i] = (cymric_len_t){CYMRIC_RF_NONCEBYTES, w->idlen, mlen, 0};
+    w->pending++;
+    w->count++;
+    if (w->pending == w->block_records)
+        return flush_block(w);
+    return 0;
+}
+
+int cymric_rf_close(cymric_rf_writer_t* w)
+{
+    uint8_t header[CYMRIC_RF_HEADERBYTES] = {0x00};
+    uint8_t off[8];
+    size_t i;
+    int ret = -1;
+
+    if (w->pending > 0 && flush_block(w) != 0)
+        goto end;
+
+    // block index, followed by its own offset
+    for (i = 0; i <= w->nblocks; i++) {
+        store_le(off, (i < w->nblocks) ? w->index[i] : w->offset, 8);
+        if (fwrite(off, 1, 8, w->f) != 8)
+            goto end;
+    }
+
+    memcpy(header, CYMRIC_RF_MAGIC, 8);
+    header[8]  = CYMRIC_RF_VERSION;
+    header[9]  = w->variant;
+    header[10] = w->idlen;
+    store_le(header + 12, w->block_records, 4);
+    memcpy(header + 16, w->id, w->idlen);
+    store_le(header + 24, w->offset, 8);
+    store_le(header + 32, w->nblocks, 8);
+    count_enc(header + 40, w->count, w->variant, w->id, w->idlen, &w->key);
+    if (fseek(w->f, 0, SEEK_SET) == 0 && fwrite(header, 1, sizeof(header), w->f) == sizeof(header))
+        ret = 0;
+
+end:
+    if (fclose(w->f) != 0)
+        ret = -1;
+    cymric_soa_free(&w->blk);
+    free(w->index);
+    memset(&w->key, 0x00, sizeof(w->key));
+    return ret;
+}
+
+int cymric_rf_open(cymric_rf_reader_t* r, const char* path, const uint8_t k[])
+{
+    const uint8_t* h;
+    uint64_t index_offset;
+    struct stat st;
+    void* map;
+    int fd, ret;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size < CYMRIC_RF_HEADERBYTES + 8) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    r->map  = map;
+    r->size = st.st_size;
+
+    h = r->map;
+    r->variant       = h[9];
+    r->idlen         = h[10];
+    r->block_records = load_le(h + 12, 4);
+    index_offset     = load_le(h + 24, 8);
+    r->nblocks       = load_le(h + 32, 8);
+    if (memcmp(h, CYMRIC_RF_MAGIC, 8) != 0 || h[8] != CYMRIC_RF_VERSION ||
+        (r->variant != 1 && r->variant != 2) || r->idlen > CYMRIC_RF_MAX_IDBYTES ||
+        r->block_records == 0 || r->block_records > CYMRIC_RF_MAX_BLOCK ||
+        index_offset < CYMRIC_RF_HEADERBYTES || index_offset > r->size ||
+        r->size - index_offset < 8 || (r->size - index_offset) % 8 != 0 ||
+        (r->size - index_offset)/8 - 1 != r->nblocks ||
+        load_le(r->map + r->size - 8, 8) != index_offset)
+        goto malformed;
+    memcpy(r->id, h + 16, r->idlen);
+    r->index = r->map + index_offset;
+
+    cymric_batch_key_init(&r->key, k);
+    r->ctx = rkeys_ctx();
+    ret = count_dec(&r->count, h + 40, r->variant, r->id, r->idlen, &r->key);
+    if (ret != 0) {
+        cymric_rf_unmap(r);
+        return 1;
+    }
+    if ((r->count + r->block_records - 1)/r->block_records != r->nblocks)
+        goto malformed;
+    madvise(map, r->size, MADV_RANDOM);
+    return 0;
+
+malformed:
+    cymric_rf_unmap(r);
+    return -1;
+}
+
+void cymric_rf_unmap(cymric_rf_reader_t* r)
+{
+    munmap((void*)r->map, r->size);
+    r->map = NULL;
+    memset(&r->key, 0x00, sizeof(r->key));
+}
+
+/**
+ * @brief Locate block b: its lengths, the first sealed record and its end.
+ *
+ * @return The number of records of the block, 0 if malformed
+ */
+static size_t block_locate(const cymric_rf_reader_t* r, uint64_t b,
+            const uint8_t** lens, uint64_t* first, uint64_t* end)
+{
+    uint64_t off = load_le(r->index + 8*b, 8);
+    size_t nrec  = (b + 1 < r->nblocks) ? r->block_records
+                 : r->count - b*r->block_records;
+
+    *end = load_le(r->index + 8*(b + 1), 8);
+    if (off < CYMRIC_RF_HEADERBYTES || off > *end ||
+        *end > (uint64_t)(r->index - r->map) || *end - off < nrec)
+        return 0;
+    *lens  = r->map + off;
+    *first = off + nrec;
+    return nrec;
+}
+
+int cymric_rf_get(const cymric_rf_reader_t* r, uint64_t i, uint8_t m[], size_t* mlen)
+{
+    uint64_t b = i / r->block_records, pos, end;
+    size_t j = i % r->block_records, k;
+    uint8_t n[CYMRIC_RF_NONCEBYTES];
+    const uint8_t* lens;
+
+    if (i >= r->count || block_locate(r, b, &lens, &pos, &end) == 0)
+        return -1;
+    for (k = 0; k < j; k++)
+        pos += lens[k] + TAGBYTES;
+    if (lens[j] > max_len(r->variant) || pos + lens[j] + TAGBYTES > end)
+        return -1;
+
+    store_be64(n, i);
+    return (r->variant == 1 ? cymric1_dec : cymric2_dec)(m, mlen, (const uint8_t*)r->key.rk,
+        n, sizeof(n), r->map + pos, lens[j] + TAGBYTES, r->id, r->idlen, &r->ctx);
+}
+
+int cymric_rf_scan(const cymric_rf_reader_t* r, uint64_t first, size_t count,
+            cymric_soa_t* b, size_t* failed)
+{
+    uint64_t i = first, last = first + count;
+    cymric_soa_t view;
+    size_t j = 0, f;
+
+    if (first > r->count || count > r->count - first || count > b->count)
+        return -1;
+    cymric_soa_slice(&view, b, 0, count);
+
+    // gather the sealed records of each block into the batch
+    while (i < last) {
+        uint64_t blk = i / r->block_records, pos, end;
+        const uint8_t* lens;
+        size_t nrec = block_locate(r, blk, &lens, &pos, &end), k;
+
+        if (nrec == 0)
+            return -1;
+        for (k = 0; k < nrec && i < last; k++) {
+            size_t len = lens[k];
+
+            if (len > max_len(r->variant) || pos + len + TAGBYTES > end)
+                return -1;
+            if (blk*r->block_records + k == i) {
+                store_be64(view.n[j], i);
+                memcpy(view.a[j], r->id, r->idlen);
+                memcpy(view.c[j], r->map + pos, len);
+                memcpy(view.t[j], r->map + pos + len, TAGBYTES);
+                view.len[j] = (cymric_len_t){CYMRIC_RF_NONCEBYTES, r->idlen, len, 0};
+                i++;
+                j++;
+            }
+            pos += len + TAGBYTES;
+        }
+    }
+
+    f = (r->variant == 1) ? cymric1_batch_dec(&view, &r->key)
+                          : cymric2_batch_dec(&view, &r->key);
+    for (j = 0; j < count; j++)
+        view.len[j].mlen = cymric_soa_ok(&view, j) ? view.len[j].mlen : 0;
+    if (failed != NULL)
+        *failed = f;
+    return f != 0;
+}
@@ -0,0 +1,154 @@
+#ifndef CYMRIC_RECFILE_H_
+#define CYMRIC_RECFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "cymric-batch.h"
+
+/**
+ * Random-access file of records of 0 to 16 bytes, each of them sealed on its
+ * own with the record index (8 bytes, big-endian) as nonce and the file
+ * identifier as associated data, so that reading a record only decrypts this
+ * record (i.e. three block cipher calls) and a record moved to another index
+ * or file is rejected. Records are grouped in blocks of block_records records:
+ * ~~~
+ * header (64 bytes, little-endian integers):
+ *   0  magic "CYMRICRF"
+ *   8  version (1), variant (1 or 2), identifier length, 0
+ *  12  block_records (32 bits)
+ *  16  identifier (up to 7 bytes, zero padded to 8)
+ *  24  offset of the block index (64 bits)
+ *  32  number of blocks (64 bits)
+ *  40  number of records (8 bytes, big-endian) sealed with nonce 2^64-1, so
+ *      that truncated files are detected
+ * blocks:
+ *   lengths of the block_records records (1 byte each, fewer for the last block)
+ *   C_0 || T_0 || C_1 || T_1 || ...
+ * block index:
+ *   offsets of the blocks in the file (64 bits each), followed by the offset
+ *   of the index itself
+ * ~~~
+ * Cymric1 accepts records of up to 8 bytes (since N||M must fit in a block),
+ * Cymric2 records of up to 16 bytes.
+ */
+#define CYMRIC_RF_MAGIC         "CYMRICRF"
+#define CYMRIC_RF_VERSION       1
+#define CYMRIC_RF_HEADERBYTES   64
+#define CYMRIC_RF_NONCEBYTES    8
+#define CYMRIC_RF_MAX_IDBYTES   (BLOCKBYTES - 1 - CYMRIC_RF_NONCEBYTES)
+#define CYMRIC_RF_MAX_BLOCK     256     // maximum number of records per block
+
+/**
+ * File being written. Records are sealed a block at a time by the batch
+ * functions.
+ */
+typedef struct {
+    FILE* f;
+    int variant;
+    uint8_t id[CYMRIC_RF_MAX_IDBYTES];
+    size_t idlen;
+    unsigned int block_records;
+    cymric_batch_key_t key;
+    cymric_soa_t blk;           // records of the current block
+    size_t pending;             // number of records in the current block
+    uint64_t count;             // number of records written (including pending)
+    uint64_t* index;            // offsets of the blocks written so far
+    size_t nblocks;
+    size_t capacity;
+    uint64_t offset;            // current offset in the file
+} cymric_rf_writer_t;
+
+/**
+ * File being read, mapped in memory.
+ */
+typedef struct {
+    const uint8_t* map;
+    size_t size;
+    int variant;
+    uint8_t id[CYMRIC_RF_MAX_IDBYTES];
+    size_t idlen;
+    unsigned int block_records;
+    uint64_t count;             // number of records (authenticated)
+    uint64_t nblocks;
+    const uint8_t* index;       // offsets of the blocks
+    cymric_batch_key_t key;
+    cipher_ctx_t ctx;
+} cymric_rf_reader_t;
+
+/**
+ * @brief Create a record file.
+ *
+ * @param w The writer
+ * @param path The path of the file
+ * @param variant The Cymric variant (1 or 2)
+ * @param id The file identifier (AD of every record)
+ * @param idlen The identifier length (at most CYMRIC_RF_MAX_IDBYTES)
+ * @param block_records The number of records per block (at most
+ *      CYMRIC_RF_MAX_BLOCK), i.e. the granularity of the block index
+ * @param k The key K||K'
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_rf_create(cymric_rf_writer_t* w, const char* path, int variant,
+        const uint8_t id[], size_t idlen, unsigned int block_records,
+        const uint8_t k[]);
+
+/**
+ * @brief Append a record.
+ *
+ * @return 0 if successfully executed, error code otherwise (record too long
+ *      for the variant, I/O error)
+ */
+int cymric_rf_append(cymric_rf_writer_t* w, const uint8_t m[], size_t mlen);
+
+/**
+ * @brief Write the last block, the block index and the header, and close the
+ * file.
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_rf_close(cymric_rf_writer_t* w);
+
+/**
+ * @brief Map a record file and check its header, block index and number of
+ * records.
+ *
+ * @return 0 if successfully executed, 1 if the number of records is not
+ *      authentic (wrong key, identifier or truncated file), -1 if the file
+ *      cannot be read or is malformed
+ */
+int cymric_rf_open(cymric_rf_reader_t* r, const char* path, const uint8_t k[]);
+
+/**
+ * @brief Unmap a record file.
+ */
+void cymric_rf_unmap(cymric_rf_reader_t* r);
+
+/**
+ * @brief Read record i: locate it from the block index and decrypt it alone.
+ *
+ * @param m The record (at least BLOCKBYTES bytes), zeroed if not authentic
+ * @param mlen The record length
+ *
+ * @return 0 if successfully executed, 1 if the record is not authentic, -1 if
+ *      i is out of range or the block is malformed
+ */
+int cymric_rf_get(const cymric_rf_reader_t* r, uint64_t i, uint8_t m[], size_t* mlen);
+
+/**
+ * @brief Read records [first, first+count) into a batch with the batch
+ * functions: on return, b->m[j] and b->len[j].mlen hold record first+j and
+ * its length, and cymric_soa_ok(b, j) tells whether it is authentic.
+ *
+ * @param b A batch of at least count messages, e.g. allocated from an arena
+ * @param failed The number of records which are not authentic (may be NULL)
+ *
+ * @return 0 if all the records are authentic, 1 if some of them are not, -1
+ *      if the range is out of bounds, b is too small or a block is malformed
+ */
+int cymric_rf_scan(const cymric_rf_reader_t* r, uint64_t first, size_t count,
+        cymric_soa_t* b, size_t* failed);
+
+#endif
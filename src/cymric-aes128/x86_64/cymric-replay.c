@@ -0,0 +1,118 @@
+/**
+ * @file cymric-replay.c
+ *
+ * @brief Lock-free sliding-window anti-replay filter.
+ *
+ * Counter value c belongs to group g = c/32, tracked by slot g % SLOTS. A
+ * slot holding an older group is recycled for g (i.e. its bitmap restarts
+ * from zero), while a slot holding a newer group means that c has left the
+ * window. Since the ring covers one group more than the window, recycling a
+ * slot only drops values which are already out of the window of the value
+ * being accepted.
+ */
+#include "cymric-replay.h"
+
+#define GROUP(s)    ((uint32_t)((s) >> 32))
+#define BITS(s)     ((uint32_t)(s))
+
+int cymric_replay_init(cymric_replay_t* r, size_t ctr_len)
+{
+    unsigned int i;
+
+    if (ctr_len == 0 || ctr_len > 8)
+        return -1;
+    atomic_init(&r->top, 0);
+    for (i = 0; i < CYMRIC_REPLAY_SLOTS; i++)
+        atomic_init(&r->slot[i], 0);
+    r->ctr_len = ctr_len;
+    return 0;
+}
+
+unsigned int cymric_replay_check_many(cymric_replay_t* r, const uint64_t ctr[],
+            unsigned int mask)
+{
+    uint64_t top = atomic_load_explicit(&r->top, memory_order_acquire);
+    uint64_t next = 0;
+    unsigned int j, k, m, fresh = 0, pending = 0;
+
+    // too old, also rules out the wrap-around of the 32-bit group indices
+    for (k = mask; k != 0; k &= k - 1) {
+        j = __builtin_ctz(k);
+        if (!(top > CYMRIC_REPLAY_WINDOW && ctr[j] < top - CYMRIC_REPLAY_WINDOW))
+            pending |= 1u << j;
+    }
+
+    // one compare-and-swap per group of 32 values
+    while (pending != 0) {
+        unsigned int lanes = 0;
+        uint32_t group, bits = 0;
+        _Atomic uint64_t* slot;
+        uint64_t old, new;
+
+        j     = __builtin_ctz(pending);
+        group = (uint32_t)(ctr[j] / 32);
+        slot  = &r->slot[(ctr[j] / 32) % CYMRIC_REPLAY_SLOTS];
+        for (m = pending; m != 0; m &= m - 1) {
+            uint32_t bit;
+
+            k = __builtin_ctz(m);
+            if ((uint32_t)(ctr[k] / 32) != group)
+                continue;
+            bit = (uint32_t)1 << (ctr[k] % 32);
+            pending &= ~(1u << k);
+            // the first occurrence of a value in the same call wins
+            if (!(bits & bit)) {
+                bits  |= bit;
+                lanes |= 1u << k;
+            }
+        }
+
+        old = atomic_load_explicit(slot, memory_order_acquire);
+        do {
+            if (GROUP(old) == group)
+                new = old | bits;
+            else if ((int32_t)(group - GROUP(old)) > 0)
+                new = ((uint64_t)group << 32) | bits;
+            else {
+                new = old;
+                break;
+            }
+        } while (!atomic_compare_exchange_weak_explicit(slot, &old, new,
+                    memory_order_acq_rel, memory_order_acquire));
+        if (new == old)
+            continue;
+
+        // fresh values are the ones whose bit was not set before
+        for (m = lanes; m != 0; m &= m - 1) {
+            k = __builtin_ctz(m);
+            if (!(GROUP(old) == group && (BITS(old) >> (ctr[k] % 32)) & 1)) {
+                fresh |= 1u << k;
+                if (ctr[k] >= next)
+                    next = (ctr[k] == UINT64_MAX) ? ctr[k] : ctr[k] + 1;
+            }
+        }
+    }
+
+    // top <- max(top, ctr + 1) over the fresh values
+    while (next > top && !atomic_compare_exchange_weak_explicit(&r->top, &top, next,
+                memory_order_acq_rel, memory_order_acquire))
+        ;
+    return fresh;
+}
+
+int cymric_replay_check(cymric_replay_t* r, uint64_t ctr)
+{
+    return cymric_replay_check_many(r, &ctr, 1) ? CYMRIC_REPLAY_FRESH : CYMRIC_REPLAY_REJECT;
+}
+
+int cymric_replay_check_nonce(cymric_replay_t* r, const uint8_t n[], size_t nlen)
+{
+    uint64_t ctr = 0;
+    size_t i;
+
+    if (nlen < r->ctr_len)
+        return CYMRIC_REPLAY_REJECT;
+    for (i = nlen - r->ctr_len; i < nlen; i++)
+        ctr = (ctr << 8) | n[i];
+    return cymric_replay_check(r, ctr);
+}
@@ -0,0 +1,75 @@
+#ifndef CYMRIC_REPLAY_H_
+#define CYMRIC_REPLAY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cymric.h"
+
+#define CYMRIC_REPLAY_WINDOW    1024    // number of counter values tracked (multiple of 32)
+#define CYMRIC_REPLAY_SLOTS     (CYMRIC_REPLAY_WINDOW/32 + 1)
+
+// return codes of cymric_replay_check
+#define CYMRIC_REPLAY_FRESH     0       // counter value seen for the first time, now recorded
+#define CYMRIC_REPLAY_REJECT    1       // counter value already seen or too old
+
+/**
+ * Sliding-window anti-replay filter over the counter of the nonces received
+ * under a key, i.e. the last ctr_len bytes of the nonce as a big-endian
+ * integer (see cymric-nonce.h). The filter accepts each counter value at most
+ * once, provided that it is not more than CYMRIC_REPLAY_WINDOW values behind
+ * the highest one accepted so far, so that messages may be reordered within
+ * the window.
+ *
+ * The window is a ring of 64-bit slots, each of them holding the bitmap of 32
+ * consecutive counter values along with the index of this group of values,
+ * so that a slot is checked, recycled and updated by a single
+ * compare-and-swap. Several threads can therefore share the filter of a key
+ * without any lock.
+ */
+typedef struct {
+    _Atomic uint64_t top;       // highest counter value accepted + 1
+    _Atomic uint64_t slot[CYMRIC_REPLAY_SLOTS];   // group index (32 bits) || bitmap (32 bits)
+    uint8_t ctr_len;
+} cymric_replay_t;
+
+/**
+ * @brief Initialize an anti-replay filter for a fresh key.
+ *
+ * @param r The filter
+ * @param ctr_len The counter length (in bytes, at most 8)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_replay_init(cymric_replay_t* r, size_t ctr_len);
+
+/**
+ * @brief Check a counter value and record it if fresh.
+ *
+ * @return CYMRIC_REPLAY_FRESH or CYMRIC_REPLAY_REJECT
+ */
+int cymric_replay_check(cymric_replay_t* r, uint64_t ctr);
+
+/**
+ * @brief Check up to 32 counter values at once and record the fresh ones,
+ * with a single compare-and-swap per group of 32 consecutive values (e.g.
+ * in-order messages of a batch). When a value appears several times, only its
+ * first occurrence may be fresh.
+ *
+ * @param ctr The counter values
+ * @param mask The bitmap of the values of ctr to check
+ *
+ * @return The bitmap of the fresh values
+ */
+unsigned int cymric_replay_check_many(cymric_replay_t* r, const uint64_t ctr[],
+        unsigned int mask);
+
+/**
+ * @brief Check the counter of a nonce and record it if fresh. Nonces shorter
+ * than the counter are rejected.
+ *
+ * @return CYMRIC_REPLAY_FRESH or CYMRIC_REPLAY_REJECT
+ */
+int cymric_replay_check_nonce(cymric_replay_t* r, const uint8_t n[], size_t nlen);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CYMRIC_SSE_H_
+#define CYMRIC_SSE_H_
+
+#include <stdint.h>
+#include <immintrin.h>
+
+/**
+ * Helpers building Cymric blocks in SSE registers from whole 16-byte loads,
+ * shared by the batch and single-message kernels.
+ */
+
+// sliding windows: 16 bytes loaded at offset 16-x give the masks below
+static const uint8_t mask_tab[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+static const uint8_t shift_tab[32] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+static const uint8_t onehot_tab[32] = {
+    [16] = 0xff,
+};
+
+/**
+ * @brief Mask keeping the first len bytes of a block (len <= 16).
+ */
+static inline __m128i lenmask(unsigned int len)
+{
+    return _mm_loadu_si128((const __m128i*)(mask_tab + 16 - len));
+}
+
+/**
+ * @brief Move the bytes of a block s positions forward (s <= 16).
+ */
+static inline __m128i shift(__m128i x, unsigned int s)
+{
+    return _mm_shuffle_epi8(x, _mm_loadu_si128((const __m128i*)(shift_tab + 16 - s)));
+}
+
+/**
+ * @brief Block with value v at byte position p, or zero if p == 16.
+ */
+static inline __m128i onehot(unsigned int p, uint8_t v)
+{
+    return _mm_and_si128(_mm_loadu_si128((const __m128i*)(onehot_tab + 16 - p)),
+        _mm_set1_epi8((char)v));
+}
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file cymric-stream.c
+ *
+ * @brief Streaming engine for Cymric1-AES128 and Cymric2-AES128 where the tag
+ * encryption of a message overlaps with the masks' encryptions of the next
+ * one.
+ *
+ * Cymric1 and Cymric2 only differ by the presence of N in the tag input
+ * pad(N||M) vs pad(M), so both are handled by the same routines where `off`
+ * is the number of nonce bytes prepended to M (i.e. nlen or 0).
+ */
+#include <string.h>
+#include "cymric-stream.h"
+#include "cymric-common.h"
+
+int cymric_stream_init(cymric_stream_t* s,
+            const uint8_t k[],
+            cymric_stream_slot_t* ring, size_t capacity)
+{
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+        return -1;
+
+    aes128_kexp(&s->rk[0], k);
+    aes128_kexp(&s->rk[1], k + KEYBYTES);
+    s->ring = ring;
+    s->mask = capacity - 1;
+    s->head = s->done = s->tail = 0;
+    return 0;
+}
+
+/**
+ * @brief Release the result once the tag has been encrypted under K'.
+ */
+static void stream_finish(cymric_stream_slot_t* p)
+{
+    if (p->dir == CYMRIC_STREAM_ENC) {
+        memcpy(p->out + p->mlen, p->y0, TAGBYTES);
+        p->outlen = p->mlen + TAGBYTES;
+        p->ret    = 0;
+    }
+    else if (sec_memcmp(p->y0, p->in + p->outlen, TAGBYTES) != 0) {
+        // do not release plaintext if erroneous tag
+        memset(p->out, 0x00, p->outlen);
+        p->outlen = 0;
+        p->ret    = 1;
+    }
+    else
+        p->ret = 0;
+}
+
+/**
+ * @brief Compute the output from Y0 and Y1, and the tag input in place of Y0.
+ */
+static void stream_mask(cymric_stream_slot_t* p, size_t mlen, size_t off)
+{
+    const uint8_t* m = (p->dir == CYMRIC_STREAM_ENC) ? p->in : p->out;
+
+    // C <- M ^ Y0 ^ Y1 (resp. M <- C ^ Y0 ^ Y1)
+    xor_bytes(p->out, p->y0, p->y1, mlen);
+    xor_bytes(p->out, p->out, p->in, mlen);
+    p->outlen = mlen;
+
+    // T <- Y0 ^ pad(N[0:off]||M)
+    xor_bytes(p->y0,       p->y0, p->n, off);
+    xor_bytes(p->y0 + off, p->y0 + off, m, mlen);
+    if (off + mlen != BLOCKBYTES)
+        p->y0[off + mlen] ^= 0x80;
+}
+
+void cymric_stream_flush(cymric_stream_t* s)
+{
+    cymric_stream_slot_t* p;
+
+    if (s->done == s->tail)
+        return;
+    p = &s->ring[s->done & s->mask];
+    aes128_enc(p->y0, p->y0, &s->rk[1]);
+    stream_finish(p);
+    s->done = s->tail;
+}
+
+int cymric_stream_push(cymric_stream_t* s, int variant, int dir,
+            const uint8_t n[], size_t nlen,
+            const uint8_t in[], size_t inlen,
+            const uint8_t a[], size_t alen,
+            void* user)
+{
+    _Alignas(16) uint8_t x[2*BLOCKBYTES] = {0x00};
+    cymric_stream_slot_t* slot;
+    size_t mlen, off;
+
+    if (s->tail - s->head > s->mask)
+        return -1;
+    slot = &s->ring[s->tail & s->mask];
+    slot->user    = user;
+    slot->variant = variant;
+    slot->dir     = dir;
+    off  = (variant == 1) ? nlen : 0;
+    mlen = (dir == CYMRIC_STREAM_ENC) ? inlen : inlen - TAGBYTES;
+
+    // invalid inputs are completed right away, in order
+    if ((variant != 1 && variant != 2) ||
+        (dir == CYMRIC_STREAM_DEC && inlen < TAGBYTES) ||
+        mlen + off > BLOCKBYTES || nlen + alen > BLOCKBYTES - 1) {
+        cymric_stream_flush(s);
+        slot->outlen = 0;
+        slot->ret    = -1;
+        s->done = ++s->tail;
+        return 0;
+    }
+
+    memcpy(slot->n,  n,  nlen);
+    memcpy(slot->a,  a,  alen);
+    memcpy(slot->in, in, inlen);
+    slot->nlen  = nlen;
+    slot->alen  = alen;
+    slot->mlen  = mlen;
+
+    // padn(N||A||b0) and padn(N||A||b1)
+    memcpy(x,        n, nlen);
+    memcpy(x + nlen, a, alen);
+    x[nlen + alen] = ((mlen + off == BLOCKBYTES) << 7) | 0x20;
+    memcpy(x + BLOCKBYTES, x, nlen + alen + 1);
+    x[BLOCKBYTES + nlen + alen] |= 0x40;
+
+    if (s->done != s->tail) {
+        // E_K'(T) of the pending message along with E_K(X0) and E_K(X1)
+        cymric_stream_slot_t* p = &s->ring[s->done & s->mask];
+        aes128_enc_x3(p->y0, slot->y0, slot->y1,
+            p->y0, x, x + BLOCKBYTES, &s->rk[1], &s->rk[0]);
+        stream_finish(p);
+    }
+    else {
+        aes128_enc(slot->y0, x,              &s->rk[0]);
+        aes128_enc(slot->y1, x + BLOCKBYTES, &s->rk[0]);
+    }
+    stream_mask(slot, mlen, off);
+
+    // the new message is pending until its tag is encrypted
+    s->done = s->tail++;
+    return 0;
+}
+
+const cymric_stream_slot_t* cymric_stream_pop(cymric_stream_t* s)
+{
+    if (s->head == s->done)
+        return NULL;
+    return &s->ring[s->head++ & s->mask];
+}
@@ -0,0 +1,100 @@
+#ifndef CYMRIC_STREAM_H_
+#define CYMRIC_STREAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+#include "aes.h"
+
+#define CYMRIC_STREAM_ENC 0
+#define CYMRIC_STREAM_DEC 1
+
+/**
+ * Message slot of the ring buffer. Inputs are copied in when pushed, and the
+ * result is available in out/outlen/ret when popped.
+ */
+typedef struct {
+    uint8_t n[BLOCKBYTES];
+    uint8_t a[BLOCKBYTES];
+    uint8_t in[BLOCKBYTES + TAGBYTES];      // message or ciphertext
+    uint8_t out[BLOCKBYTES + TAGBYTES];     // ciphertext or message
+    _Alignas(16) uint8_t y0[BLOCKBYTES];    // Y0 and then tag input
+    _Alignas(16) uint8_t y1[BLOCKBYTES];
+    size_t mlen;                            // message length
+    size_t outlen;
+    void* user;                             // opaque to the engine
+    int ret;                                // same as cymric*_enc/cymric*_dec
+    uint8_t nlen;
+    uint8_t alen;
+    uint8_t variant;                        // 1 or 2
+    uint8_t dir;                            // CYMRIC_STREAM_ENC or _DEC
+} cymric_stream_slot_t;
+
+/**
+ * Single-threaded streaming engine under a fixed key.
+ *
+ * Messages are processed as soon as they are pushed, in a software-pipelined
+ * manner: the tag encryption under K' of message i is interleaved with the
+ * encryptions of Y0 and Y1 under K of message i+1. Results are popped in
+ * order, at most one message after being pushed (or after a flush).
+ */
+typedef struct {
+    aes_roundkeys_t rk[2];                  // round keys of K and K'
+    cymric_stream_slot_t* ring;
+    size_t mask;                            // capacity - 1
+    size_t head;                            // next slot to pop
+    size_t done;                            // first slot not completed yet
+    size_t tail;                            // next slot to push
+} cymric_stream_t;
+
+/**
+ * @brief Initialize a streaming engine.
+ *
+ * @param s The engine
+ * @param k The key material K||K'
+ * @param ring The slots of the ring buffer
+ * @param capacity The number of slots (must be a power of two, at least 2)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_stream_init(cymric_stream_t* s,
+        const uint8_t k[],
+        cymric_stream_slot_t* ring, size_t capacity);
+
+/**
+ * @brief Push a message to be encrypted or decrypted.
+ *
+ * @param s The engine
+ * @param variant The Cymric variant (1 or 2)
+ * @param dir CYMRIC_STREAM_ENC or CYMRIC_STREAM_DEC
+ * @param n The nonce
+ * @param nlen The nonce length (in bytes)
+ * @param in The message (resp. ciphertext) to encrypt (resp. decrypt)
+ * @param inlen The input length (in bytes)
+ * @param a The additional data
+ * @param alen The additional data length (in bytes)
+ * @param user Opaque pointer returned along with the result
+ *
+ * @return 0 if successfully pushed, -1 if the ring is full
+ */
+int cymric_stream_push(cymric_stream_t* s, int variant, int dir,
+        const uint8_t n[], size_t nlen,
+        const uint8_t in[], size_t inlen,
+        const uint8_t a[], size_t alen,
+        void* user);
+
+/**
+ * @brief Pop the oldest completed message.
+ *
+ * @return The slot holding the result (valid until the slot is reused, i.e.
+ *      after capacity more pushes), or NULL if no message is completed
+ */
+const cymric_stream_slot_t* cymric_stream_pop(cymric_stream_t* s);
+
+/**
+ * @brief Complete the pending message (if any) without waiting for the next
+ * one, e.g. when the input stream goes idle.
+ */
+void cymric_stream_flush(cymric_stream_t* s);
+
+#endif
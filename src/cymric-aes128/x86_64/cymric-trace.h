@@ -0,0 +1 @@
+../../cymric/cymric-trace.h
\ No newline at end of file
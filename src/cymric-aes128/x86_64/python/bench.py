@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Per-call versus batch throughput of the Cymric extension.
+
+Usage: PYTHONPATH=. ./bench.py [count] [max threads]
+
+The per-call paths encrypt one message per call, either through ctypes on the
+scalar C function (as a plain wrapper would) or through cymric.encrypt; the
+batch paths hand whole columns of 16-byte slots to Key.encrypt/Key.decrypt
+and fixed-width records to Key.seal, with the GIL released.
+"""
+import ctypes
+import os
+import sys
+import threading
+import time
+
+import cymric
+
+COUNT = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+THREADS = int(sys.argv[2]) if len(sys.argv) > 2 else (os.cpu_count() or 1)
+NLEN, ALEN, MLEN = 12, 3, 4
+
+
+def report(name, count, seconds):
+    print(f"{name:<34} {count / seconds / 1e6:9.3f} Mmsg/s")
+
+
+class CipherCtx(ctypes.Structure):
+    """cipher_ctx_t of cipher_ctx.h."""
+    _fields_ = [("roundkeys", ctypes.c_void_p), ("encrypt", ctypes.c_void_p),
+                ("encrypt_x2", ctypes.c_void_p), ("kexpand", ctypes.c_void_p),
+                ("rkeys_size", ctypes.c_size_t)]
+
+
+def bench_ctypes(k, n, a, m, count):
+    lib = ctypes.CDLL(cymric.__file__)
+    lib.aes_get_cipher_ctx.restype = CipherCtx
+    ctx = lib.aes_get_cipher_ctx()
+    rkeys = ctypes.create_string_buffer(2 * 176 + 16)
+    ctx.roundkeys = ctypes.addressof(rkeys)
+    out = ctypes.create_string_buffer(32)
+    outlen = ctypes.c_size_t()
+    enc = lib.cymric1_enc
+    t0 = time.perf_counter()
+    for _ in range(count):
+        enc(out, ctypes.byref(outlen), k, n, NLEN, m, MLEN, a, ALEN, ctypes.byref(ctx))
+    return time.perf_counter() - t0
+
+
+def bench_call(k, n, a, m, count):
+    enc = cymric.encrypt
+    t0 = time.perf_counter()
+    for _ in range(count):
+        enc(k, n, a, m)
+    return time.perf_counter() - t0
+
+
+def columns(count):
+    lens = bytes([NLEN, ALEN, MLEN, 0]) * count
+    return (bytearray(os.urandom(16 * count)), bytearray(os.urandom(16 * count)),
+            bytearray(os.urandom(16 * count)), bytearray(16 * count),
+            bytearray(16 * count), lens, bytearray(8 * ((count + 63) // 64)))
+
+
+def bench_batch(key, cols, threads, dec=False):
+    n, a, m, c, t, lens, ok = cols
+    t0 = time.perf_counter()
+    if dec:
+        key.decrypt(n, a, c, t, m, lens, ok, threads=threads)
+    else:
+        key.encrypt(n, a, m, c, t, lens, ok, threads=threads)
+    return time.perf_counter() - t0
+
+
+def bench_python_threads(key, cols, threads):
+    """Python threads each encrypting their own slice: scales since the GIL
+    is released while the kernel runs."""
+    n, a, m, c, t, lens, ok = cols
+    count = len(lens) // 4
+    per = (count // threads) // 64 * 64
+    views = [memoryview(x) for x in (n, a, m, c, t, lens, ok)]
+
+    def work(i):
+        s, e = i * per, (i + 1) * per
+        key.encrypt(views[0][16 * s:16 * e], views[1][16 * s:16 * e],
+                    views[2][16 * s:16 * e], views[3][16 * s:16 * e],
+                    views[4][16 * s:16 * e], views[5][4 * s:4 * e],
+                    views[6][s // 8:e // 8])
+
+    pool = [threading.Thread(target=work, args=(i,)) for i in range(threads)]
+    t0 = time.perf_counter()
+    for p in pool:
+        p.start()
+    for p in pool:
+        p.join()
+    return time.perf_counter() - t0, per * threads
+
+
+def main():
+    k = os.urandom(32)
+    n, a, m = os.urandom(NLEN), os.urandom(ALEN), os.urandom(MLEN)
+    key = cymric.Key(k)
+    calls = min(COUNT, 200000)
+
+    report("per-call ctypes cymric1_enc", calls, bench_ctypes(k, n, a, m, calls))
+    report("per-call cymric.encrypt", calls, bench_call(k, n, a, m, calls))
+
+    cols = columns(COUNT)
+    t = 1
+    while t <= THREADS:
+        report(f"batch Key.encrypt threads={t}", COUNT, bench_batch(key, cols, t))
+        report(f"batch Key.decrypt threads={t}", COUNT, bench_batch(key, cols, t, True))
+        sec, done = bench_python_threads(key, cols, t)
+        report(f"batch python threads={t}", done, sec)
+        t *= 2
+
+    src = os.urandom(MLEN * COUNT)
+    dst = bytearray((MLEN + 16) * COUNT)
+    t0 = time.perf_counter()
+    key.seal(src, dst, MLEN, id=b"bench", threads=THREADS)
+    report(f"archive Key.seal threads={THREADS}", COUNT, time.perf_counter() - t0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,441 @@
+/**
+ * @file cymricmodule.c
+ *
+ * @brief CPython extension exposing the batch and archive functions over
+ * buffers of fixed-width slots (bytes, bytearray, memoryview, NumPy arrays,
+ * ...), without any copy and with the GIL released while the kernels run.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../cymric.h"
+#include "../aes.h"
+#include "../cymric-batch.h"
+#include "../cymric-archive.h"
+
+#define MAX_THREADS     64
+#define MIN_CHUNK       4096    // minimum number of messages per thread (multiple of 64)
+#define DIR_ENC         0
+#define DIR_DEC         1
+
+/**
+ * Key object holding the round keys of K and K' expanded once.
+ */
+typedef struct {
+    PyObject_HEAD
+    cymric_batch_key_t* key;
+} KeyObject;
+
+typedef struct {
+    cymric_soa_t view;
+    const cymric_batch_key_t* key;
+    int variant;
+    int dir;
+    size_t failed;
+} job_t;
+
+static void* job_run(void* arg)
+{
+    job_t* j = arg;
+
+    if (j->variant == 1)
+        j->failed = (j->dir == DIR_ENC) ? cymric1_batch_enc(&j->view, j->key)
+                                        : cymric1_batch_dec(&j->view, j->key);
+    else
+        j->failed = (j->dir == DIR_ENC) ? cymric2_batch_enc(&j->view, j->key)
+                                        : cymric2_batch_dec(&j->view, j->key);
+    return NULL;
+}
+
+/**
+ * @brief Split a batch in contiguous ranges of at least MIN_CHUNK messages,
+ * one per thread, the calling thread taking the first one.
+ *
+ * @return The number of messages which failed
+ */
+static size_t run(cymric_soa_t* b, const cymric_batch_key_t* key, int variant,
+            int dir, unsigned int threads)
+{
+    job_t job[MAX_THREADS];
+    pthread_t tid[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+    unsigned int i, nthreads = (threads > 1) ? threads : 1;
+    size_t range, failed = 0;
+
+    if (nthreads > b->count/MIN_CHUNK)
+        nthreads = (b->count/MIN_CHUNK > 0) ? b->count/MIN_CHUNK : 1;
+    // ranges are multiples of 64 messages so that the result bitmap stays word-aligned
+    range = ((b->count + nthreads - 1)/nthreads + 63) & ~(size_t)63;
+
+    for (i = 0; i < nthreads; i++) {
+        size_t first = (i*range < b->count) ? i*range : b->count;
+        size_t last  = ((i + 1)*range < b->count) ? (i + 1)*range : b->count;
+
+        job[i] = (job_t){.key = key, .variant = variant, .dir = dir, .failed = 0};
+        cymric_soa_slice(&job[i].view, b, first, last - first);
+    }
+    // fall back to the calling thread for the ranges which cannot be started
+    for (i = 1; i < nthreads; i++)
+        started[i] = (pthread_create(&tid[i], NULL, job_run, &job[i]) == 0);
+    job_run(&job[0]);
+    for (i = 1; i < nthreads; i++) {
+        if (started[i])
+            pthread_join(tid[i], NULL);
+        else
+            job_run(&job[i]);
+    }
+    for (i = 0; i < nthreads; i++)
+        failed += job[i].failed;
+    return failed;
+}
+
+/**
+ * @brief Check that a buffer holds exactly count slots of width bytes.
+ */
+static int check_column(const Py_buffer* v, size_t count, size_t width, const char* name)
+{
+    if ((size_t)v->len != count*width) {
+        PyErr_Format(PyExc_ValueError, "%s must hold %zu bytes (%zu slots of %zu bytes), got %zd",
+                name, count*width, count, width, v->len);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_variant(int variant)
+{
+    if (variant != 1 && variant != 2) {
+        PyErr_SetString(PyExc_ValueError, "variant must be 1 or 2");
+        return -1;
+    }
+    return 0;
+}
+
+static int Key_init(KeyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = {"k", NULL};
+    Py_buffer k;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*", kwlist, &k))
+        return -1;
+    if (k.len != 2*KEYBYTES) {
+        PyErr_Format(PyExc_ValueError, "the key K||K' must be %d bytes long", 2*KEYBYTES);
+        PyBuffer_Release(&k);
+        return -1;
+    }
+    if (self->key == NULL)
+        self->key = aligned_alloc(CYMRIC_SOA_ALIGN, sizeof(cymric_batch_key_t));
+    if (self->key == NULL) {
+        PyBuffer_Release(&k);
+        PyErr_NoMemory();
+        return -1;
+    }
+    cymric_batch_key_init(self->key, k.buf);
+    PyBuffer_Release(&k);
+    return 0;
+}
+
+static void Key_dealloc(KeyObject* self)
+{
+    if (self->key != NULL) {
+        memset(self->key, 0x00, sizeof(cymric_batch_key_t));
+        free(self->key);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/**
+ * @brief Common body of Key.encrypt and Key.decrypt: the input column of
+ * messages is m for encryption and c for decryption, all the others being
+ * outputs.
+ */
+static PyObject* Key_batch(KeyObject* self, PyObject* args, PyObject* kwds, int dir)
+{
+    static char* kwlist_enc[] = {"n", "a", "m", "c", "t", "lens", "ok", "variant", "threads", NULL};
+    static char* kwlist_dec[] = {"n", "a", "c", "t", "m", "lens", "ok", "variant", "threads", NULL};
+    Py_buffer n = {0}, a = {0}, in = {0}, out = {0}, t = {0}, lens = {0}, ok = {0};
+    PyObject* okobj = Py_None;
+    int variant = 1, res = -1;
+    unsigned int threads = 1;
+    uint64_t* okbuf = NULL;
+    cymric_soa_t b;
+    size_t count, words, failed = 0;
+
+    if (self->key == NULL) {
+        PyErr_SetString(PyExc_ValueError, "uninitialized key");
+        return NULL;
+    }
+    if (dir == DIR_ENC) {
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*y*y*w*w*y*|O$iI", kwlist_enc,
+                    &n, &a, &in, &out, &t, &lens, &okobj, &variant, &threads))
+            return NULL;
+    }
+    else {
+        // the tag column is an input for decryption
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*y*y*y*w*y*|O$iI", kwlist_dec,
+                    &n, &a, &in, &t, &out, &lens, &okobj, &variant, &threads))
+            return NULL;
+    }
+
+    count = lens.len / sizeof(cymric_len_t);
+    words = (count + 63)/64;
+    if (check_variant(variant) != 0 ||
+        check_column(&lens, count, sizeof(cymric_len_t), "lens") != 0 ||
+        check_column(&n, count, BLOCKBYTES, "n") != 0 ||
+        check_column(&a, count, BLOCKBYTES, "a") != 0 ||
+        check_column(&in, count, BLOCKBYTES, dir == DIR_ENC ? "m" : "c") != 0 ||
+        check_column(&out, count, BLOCKBYTES, dir == DIR_ENC ? "c" : "m") != 0 ||
+        check_column(&t, count, TAGBYTES, "t") != 0)
+        goto end;
+    if (okobj != Py_None) {
+        if (PyObject_GetBuffer(okobj, &ok, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0)
+            goto end;
+        if (check_column(&ok, words, sizeof(uint64_t), "ok") != 0)
+            goto end;
+        okbuf = ok.buf;
+    }
+    else if ((okbuf = malloc(words ? words*sizeof(uint64_t) : 1)) == NULL) {
+        PyErr_NoMemory();
+        goto end;
+    }
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    // zero-copy view over the caller's columns (the kernels only read n, a and the input)
+    b = (cymric_soa_t){
+        .n = n.buf, .a = a.buf, .t = t.buf, .len = lens.buf,
+        .ok = okbuf, .count = count, .mem = NULL,
+    };
+    if (dir == DIR_ENC) {
+        b.m = in.buf;
+        b.c = out.buf;
+    }
+    else {
+        b.c = in.buf;
+        b.m = out.buf;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    failed = run(&b, self->key, variant, dir, threads);
+    Py_END_ALLOW_THREADS
+    res = 0;
+
+end:
+    if (okobj == Py_None)
+        free(okbuf);
+    if (ok.obj != NULL)
+        PyBuffer_Release(&ok);
+    PyBuffer_Release(&n);
+    PyBuffer_Release(&a);
+    PyBuffer_Release(&in);
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&t);
+    PyBuffer_Release(&lens);
+    return (res == 0) ? PyLong_FromSize_t(failed) : NULL;
+}
+
+static PyObject* Key_encrypt(KeyObject* self, PyObject* args, PyObject* kwds)
+{
+    return Key_batch(self, args, kwds, DIR_ENC);
+}
+
+static PyObject* Key_decrypt(KeyObject* self, PyObject* args, PyObject* kwds)
+{
+    return Key_batch(self, args, kwds, DIR_DEC);
+}
+
+/**
+ * @brief Common body of Key.seal and Key.open (see cymric-archive.h).
+ */
+static PyObject* Key_archive(KeyObject* self, PyObject* args, PyObject* kwds, int op)
+{
+    static char* kwlist[] = {"src", "dst", "width", "id", "first", "variant", "threads", NULL};
+    Py_buffer src = {0}, dst = {0}, id = {0};
+    cymric_archive_params_t p = {.variant = 1, .threads = 1};
+    unsigned long long first = 0;
+    size_t count, inw, outw, failed = 0;
+    int res = -1;
+
+    if (self->key == NULL) {
+        PyErr_SetString(PyExc_ValueError, "uninitialized key");
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*w*n|$y*KiI", kwlist,
+                &src, &dst, &p.width, &id, &first, &p.variant, &p.threads))
+        return NULL;
+    p.first = first;
+    p.idlen = (id.obj != NULL) ? (size_t)id.len : 0;
+    if (p.idlen <= CYMRIC_ARCHIVE_MAX_IDBYTES && p.idlen > 0)
+        memcpy(p.id, id.buf, p.idlen);
+    if (p.threads > CYMRIC_ARCHIVE_MAX_THREADS)
+        p.threads = CYMRIC_ARCHIVE_MAX_THREADS;
+    if (cymric_archive_check(&p) != 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid archive parameters (variant, width or id)");
+        goto end;
+    }
+
+    inw   = (op == CYMRIC_ARCHIVE_SEAL) ? p.width : p.width + TAGBYTES;
+    outw  = (op == CYMRIC_ARCHIVE_SEAL) ? p.width + TAGBYTES : p.width;
+    count = src.len / inw;
+    if (check_column(&src, count, inw, "src") != 0 ||
+        check_column(&dst, count, outw, "dst") != 0)
+        goto end;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (op == CYMRIC_ARCHIVE_SEAL)
+        cymric_archive_seal(dst.buf, src.buf, count, &p, self->key);
+    else
+        cymric_archive_open(dst.buf, src.buf, count, &p, self->key, &failed);
+    Py_END_ALLOW_THREADS
+    res = 0;
+
+end:
+    if (id.obj != NULL)
+        PyBuffer_Release(&id);
+    PyBuffer_Release(&src);
+    PyBuffer_Release(&dst);
+    if (res != 0)
+        return NULL;
+    if (op == CYMRIC_ARCHIVE_SEAL)
+        Py_RETURN_NONE;
+    return PyLong_FromSize_t(failed);
+}
+
+static PyObject* Key_seal(KeyObject* self, PyObject* args, PyObject* kwds)
+{
+    return Key_archive(self, args, kwds, CYMRIC_ARCHIVE_SEAL);
+}
+
+static PyObject* Key_open(KeyObject* self, PyObject* args, PyObject* kwds)
+{
+    return Key_archive(self, args, kwds, CYMRIC_ARCHIVE_OPEN);
+}
+
+static PyMethodDef Key_methods[] = {
+    {"encrypt", (PyCFunction)(void(*)(void))Key_encrypt, METH_VARARGS | METH_KEYWORDS,
+     "encrypt(n, a, m, c, t, lens, ok=None, *, variant=1, threads=1) -> failed\n\n"
+     "Encrypt a batch of messages held in columns of 16-byte slots (n, a, m,\n"
+     "c, t) with their lengths (lens, 4 bytes per message: nlen, alen, mlen, 0).\n"
+     "The result bitmap is written to ok (one 64-bit word per 64 messages)."},
+    {"decrypt", (PyCFunction)(void(*)(void))Key_decrypt, METH_VARARGS | METH_KEYWORDS,
+     "decrypt(n, a, c, t, m, lens, ok=None, *, variant=1, threads=1) -> failed\n\n"
+     "Decrypt a batch of messages (see encrypt). Plaintexts of the messages\n"
+     "which fail are zeroed."},
+    {"seal", (PyCFunction)(void(*)(void))Key_seal, METH_VARARGS | METH_KEYWORDS,
+     "seal(src, dst, width, *, id=b'', first=0, variant=1, threads=1)\n\n"
+     "Seal the fixed-width records of src into dst (width+16 bytes each)."},
+    {"open", (PyCFunction)(void(*)(void))Key_open, METH_VARARGS | METH_KEYWORDS,
+     "open(src, dst, width, *, id=b'', first=0, variant=1, threads=1) -> failed\n\n"
+     "Open the sealed records of src into dst. Records which fail are zeroed."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject KeyType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name      = "cymric.Key",
+    .tp_doc       = "Key(k)\n\nRound keys of K||K' (32 bytes) for the batch functions.",
+    .tp_basicsize = sizeof(KeyObject),
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_new       = PyType_GenericNew,
+    .tp_init      = (initproc)Key_init,
+    .tp_dealloc   = (destructor)Key_dealloc,
+    .tp_methods   = Key_methods,
+};
+
+/**
+ * @brief Per-call path: one message, key expanded at each call.
+ */
+static PyObject* scalar(PyObject* args, PyObject* kwds, int dir)
+{
+    static char* kwlist[] = {"k", "n", "a", "m", "variant", NULL};
+    Py_buffer k, n, a, m;
+    uint8_t out[BLOCKBYTES + TAGBYTES];
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+    size_t outlen = 0;
+    int variant = 1, ret = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*y*y*y*|$i", kwlist,
+                &k, &n, &a, &m, &variant))
+        return NULL;
+    if (check_variant(variant) == 0 && k.len != 2*KEYBYTES)
+        PyErr_Format(PyExc_ValueError, "the key K||K' must be %d bytes long", 2*KEYBYTES);
+    else if (!PyErr_Occurred() && dir == DIR_DEC && m.len < TAGBYTES)
+        PyErr_Format(PyExc_ValueError, "the ciphertext must be at least %d bytes long", TAGBYTES);
+    else if (!PyErr_Occurred() && m.len <= BLOCKBYTES + (dir == DIR_DEC ? TAGBYTES : 0)) {
+        ctx.roundkeys = &rkeys;
+        if (variant == 1)
+            ret = (dir == DIR_ENC)
+                ? cymric1_enc(out, &outlen, k.buf, n.buf, n.len, m.buf, m.len, a.buf, a.len, &ctx)
+                : cymric1_dec(out, &outlen, k.buf, n.buf, n.len, m.buf, m.len, a.buf, a.len, &ctx);
+        else
+            ret = (dir == DIR_ENC)
+                ? cymric2_enc(out, &outlen, k.buf, n.buf, n.len, m.buf, m.len, a.buf, a.len, &ctx)
+                : cymric2_dec(out, &outlen, k.buf, n.buf, n.len, m.buf, m.len, a.buf, a.len, &ctx);
+    }
+    PyBuffer_Release(&k);
+    PyBuffer_Release(&n);
+    PyBuffer_Release(&a);
+    PyBuffer_Release(&m);
+
+    if (PyErr_Occurred())
+        return NULL;
+    if (ret == 1)
+        Py_RETURN_NONE;
+    if (ret != 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid lengths");
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize((const char*)out, outlen);
+}
+
+static PyObject* py_encrypt(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    (void)self;
+    return scalar(args, kwds, DIR_ENC);
+}
+
+static PyObject* py_decrypt(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    (void)self;
+    return scalar(args, kwds, DIR_DEC);
+}
+
+static PyMethodDef module_methods[] = {
+    {"encrypt", (PyCFunction)(void(*)(void))py_encrypt, METH_VARARGS | METH_KEYWORDS,
+     "encrypt(k, n, a, m, *, variant=1) -> bytes\n\n"
+     "Encrypt a single message into C||T."},
+    {"decrypt", (PyCFunction)(void(*)(void))py_decrypt, METH_VARARGS | METH_KEYWORDS,
+     "decrypt(k, n, a, c, *, variant=1) -> bytes or None\n\n"
+     "Decrypt a single C||T, None if the tag is invalid."},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name    = "cymric",
+    .m_doc     = "Cymric authenticated encryption (AES-128), batch and per-call APIs.",
+    .m_size    = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit_cymric(void)
+{
+    PyObject* m;
+
+    if (PyType_Ready(&KeyType) < 0)
+        return NULL;
+    if ((m = PyModule_Create(&module)) == NULL)
+        return NULL;
+    Py_INCREF(&KeyType);
+    if (PyModule_AddObject(m, "Key", (PyObject*)&KeyType) < 0) {
+        Py_DECREF(&KeyType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    PyModule_AddIntConstant(m, "BLOCKBYTES", BLOCKBYTES);
+    PyModule_AddIntConstant(m, "TAGBYTES", TAGBYTES);
+    PyModule_AddIntConstant(m, "KEYBYTES", 2*KEYBYTES);
+    return m;
+}
@@ -0,0 +1,17 @@
+# Build the extension in place: python3 setup.py build_ext --inplace
+import glob
+from setuptools import setup, Extension
+
+sources = ["cymricmodule.c"] + sorted(glob.glob("../*.c"))
+
+setup(
+    name="cymric",
+    version="1.0",
+    description="Cymric authenticated encryption (AES-128), batch and per-call APIs",
+    ext_modules=[Extension(
+        "cymric",
+        sources=sources,
+        extra_compile_args=["-march=native", "-O2", "-Wall", "-Wextra", "-Wstrict-prototypes"],
+        extra_link_args=["-lpthread"],
+    )],
+)
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Smoke test of the Cymric extension.
+
+Usage: PYTHONPATH=. ./test.py
+
+Checks the batch paths (Key.encrypt/Key.decrypt, Key.seal/Key.open) against
+the per-call ones (cymric.encrypt/cymric.decrypt) over every valid length,
+with tampered tags, and the rejection of invalid lengths.
+"""
+import os
+import struct
+import unittest
+
+import cymric
+
+BLOCK = TAG = 16
+
+
+def lengths(variant):
+    """Every valid (nlen, alen, mlen) of a variant."""
+    return [(nlen, alen, mlen)
+            for nlen in range(BLOCK)
+            for alen in range(BLOCK - nlen)
+            for mlen in range((BLOCK - nlen if variant == 1 else BLOCK) + 1)]
+
+
+def ok_bits(ok, count):
+    words = struct.unpack(f"<{len(ok) // 8}Q", ok)
+    return [(words[i // 64] >> (i % 64)) & 1 for i in range(count)]
+
+
+class TestBatch(unittest.TestCase):
+    def setUp(self):
+        self.k = os.urandom(32)
+        self.key = cymric.Key(self.k)
+
+    def check_variant(self, variant):
+        lens = lengths(variant)
+        count = len(lens)
+        n, a, m = os.urandom(count * BLOCK), os.urandom(count * BLOCK), os.urandom(count * BLOCK)
+        c, t = bytearray(count * BLOCK), bytearray(count * TAG)
+        packed = b"".join(struct.pack("4B", nlen, alen, mlen, 0) for nlen, alen, mlen in lens)
+        ok = bytearray(8 * ((count + 63) // 64))
+
+        self.assertEqual(self.key.encrypt(n, a, m, c, t, packed, ok, variant=variant), 0)
+        self.assertTrue(all(ok_bits(ok, count)))
+        for i, (nlen, alen, mlen) in enumerate(lens):
+            o = i * BLOCK
+            ni, ai, mi = n[o:o + nlen], a[o:o + alen], m[o:o + mlen]
+            ref = cymric.encrypt(self.k, ni, ai, mi, variant=variant)
+            self.assertEqual(bytes(c[o:o + mlen]) + bytes(t[i * TAG:(i + 1) * TAG]), ref)
+            self.assertEqual(cymric.decrypt(self.k, ni, ai, ref, variant=variant), mi)
+
+        # tamper with every third tag
+        for i in range(0, count, 3):
+            t[i * TAG] ^= 0x01
+        out = bytearray(count * BLOCK)
+        self.assertEqual(self.key.decrypt(n, a, c, t, out, packed, ok, variant=variant), (count + 2) // 3)
+        for i, ((nlen, alen, mlen), good) in enumerate(zip(lens, ok_bits(ok, count))):
+            o = i * BLOCK
+            self.assertEqual(good, i % 3 != 0)
+            if good:
+                self.assertEqual(out[o:o + mlen], m[o:o + mlen])
+            else:
+                self.assertEqual(out[o:o + BLOCK], bytes(BLOCK))
+                ct = bytes(c[o:o + mlen]) + bytes(t[i * TAG:(i + 1) * TAG])
+                self.assertIsNone(cymric.decrypt(self.k, n[o:o + nlen], a[o:o + alen], ct, variant=variant))
+
+    def test_cymric1(self):
+        self.check_variant(1)
+
+    def test_cymric2(self):
+        self.check_variant(2)
+
+    def test_invalid(self):
+        # N||A filling a block, M too long for Cymric1
+        packed = struct.pack("8B", 12, 4, 0, 0, 8, 3, 9, 0)
+        n = a = m = bytes(2 * BLOCK)
+        c, t = bytearray(2 * BLOCK), bytearray(2 * TAG)
+        self.assertEqual(self.key.encrypt(n, a, m, c, t, packed, variant=1), 2)
+        self.assertEqual(self.key.encrypt(n, a, m, c, t, packed, variant=2), 1)
+        with self.assertRaises(ValueError):
+            cymric.encrypt(self.k, bytes(12), bytes(4), b"")
+        with self.assertRaises(ValueError):
+            cymric.encrypt(self.k, bytes(8), bytes(3), bytes(9), variant=1)
+        with self.assertRaises(ValueError):
+            cymric.decrypt(self.k, bytes(8), b"", bytes(TAG - 1))
+        with self.assertRaises(ValueError):
+            self.key.encrypt(n, a, m, c, t, packed, variant=3)
+        with self.assertRaises(ValueError):
+            cymric.Key(bytes(16))
+
+    def test_archive(self):
+        for variant, width in ((1, 8), (2, 5), (2, 16)):
+            count, ident, first = 100, b"arc", 2**40 - 3
+            src = os.urandom(count * width)
+            sealed = bytearray(count * (width + TAG))
+            self.key.seal(src, sealed, width, id=ident, first=first, variant=variant)
+            for i in range(0, count, 7):
+                rec = sealed[i * (width + TAG):(i + 1) * (width + TAG)]
+                ref = cymric.encrypt(self.k, struct.pack(">Q", first + i), ident,
+                                     src[i * width:(i + 1) * width], variant=variant)
+                self.assertEqual(bytes(rec), ref)
+            sealed[5 * (width + TAG)] ^= 0x01
+            out = bytearray(count * width)
+            self.assertEqual(self.key.open(sealed, out, width, id=ident, first=first, variant=variant), 1)
+            self.assertEqual(out[5 * width:6 * width], bytes(width))
+            self.assertEqual(out[:5 * width] + out[6 * width:], src[:5 * width] + src[6 * width:])
+
+
+if __name__ == "__main__":
+    unittest.main()
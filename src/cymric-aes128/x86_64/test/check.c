@@ -0,0 +1,77 @@
+/**
+ * @file check.c
+ *
+ * @brief Runner of the API tests: each API is checked for equivalence with
+ * cymric1_enc/dec and cymric2_enc/dec over the range of N, A and M lengths,
+ * for the rejection of tampered tags, and for its own failure cases.
+ */
+#include <string.h>
+#include "check.h"
+
+static const struct {
+    const char* name;
+    int (*run)(void);
+} tests[] = {
+    {"session", test_session},
+    {"nvnonce", test_nvnonce},
+    {"stream",  test_stream},
+    {"batch",   test_batch},
+    {"archive", test_archive},
+    {"recfile", test_recfile},
+    {"replay",  test_replay},
+    {"mb",      test_mb},
+    {"fused",   test_fused},
+    {"oneshot", test_oneshot},
+    {"gateway", test_gateway},
+};
+
+void check_fill(uint8_t* p, size_t len, uint64_t* seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        *seed ^= *seed << 13;
+        *seed ^= *seed >> 7;
+        *seed ^= *seed << 17;
+        p[i] = (uint8_t)*seed;
+    }
+}
+
+int ref_enc(int variant, uint8_t c[], size_t* clen, const uint8_t k[],
+            const uint8_t n[], size_t nlen, const uint8_t m[], size_t mlen,
+            const uint8_t a[], size_t alen)
+{
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+
+    ctx.roundkeys = &rkeys;
+    if (variant == 1)
+        return cymric1_enc(c, clen, k, n, nlen, m, mlen, a, alen, &ctx);
+    return cymric2_enc(c, clen, k, n, nlen, m, mlen, a, alen, &ctx);
+}
+
+int ref_dec(int variant, uint8_t m[], size_t* mlen, const uint8_t k[],
+            const uint8_t n[], size_t nlen, const uint8_t c[], size_t clen,
+            const uint8_t a[], size_t alen)
+{
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+
+    ctx.roundkeys = &rkeys;
+    if (variant == 1)
+        return cymric1_dec(m, mlen, k, n, nlen, c, clen, a, alen, &ctx);
+    return cymric2_dec(m, mlen, k, n, nlen, c, clen, a, alen, &ctx);
+}
+
+int main(void)
+{
+    unsigned int i, failed = 0;
+
+    for (i = 0; i < sizeof(tests)/sizeof(tests[0]); i++) {
+        int failures = tests[i].run();
+
+        printf("%-10s %s\n", tests[i].name, failures ? "FAILED" : "ok");
+        failed += (failures != 0);
+    }
+    return failed != 0;
+}
@@ -0,0 +1,59 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "../cymric.h"
+#include "../aes.h"
+
+/**
+ * Minimal harness of the API tests (make check): each test_*() function
+ * checks one API against the reference cymric1/cymric2 functions and returns
+ * its number of failed checks.
+ */
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                         \
+        }                                                                       \
+    } while (0)
+
+/**
+ * @brief Fill a buffer with pseudorandom bytes (xorshift64).
+ */
+void check_fill(uint8_t* p, size_t len, uint64_t* seed);
+
+/**
+ * @brief Reference encryption (resp. decryption) by cymric1_enc or
+ * cymric2_enc (resp. cymric1_dec or cymric2_dec) with online key expansion.
+ */
+int ref_enc(int variant, uint8_t c[], size_t* clen, const uint8_t k[],
+        const uint8_t n[], size_t nlen, const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen);
+int ref_dec(int variant, uint8_t m[], size_t* mlen, const uint8_t k[],
+        const uint8_t n[], size_t nlen, const uint8_t c[], size_t clen,
+        const uint8_t a[], size_t alen);
+
+/**
+ * @brief Largest message length allowed by a variant for a nonce length.
+ */
+static inline size_t max_mlen(int variant, size_t nlen)
+{
+    return (variant == 1) ? BLOCKBYTES - nlen : BLOCKBYTES;
+}
+
+int test_session(void);
+int test_nvnonce(void);
+int test_stream(void);
+int test_batch(void);
+int test_archive(void);
+int test_recfile(void);
+int test_replay(void);
+int test_mb(void);
+int test_fused(void);
+int test_oneshot(void);
+int test_gateway(void);
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @file test-archive.c
+ *
+ * @brief Archives of fixed-width records and their rekeying (cymric-archive.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "check.h"
+#include "../cymric-archive.h"
+
+#define COUNT   37      // not a multiple of the number of lanes
+
+/**
+ * @brief Check that records from to to-1 of a sealed archive match the
+ * reference functions, with the nonce first+i and the identifier as
+ * associated data.
+ */
+static int check_sealed(const uint8_t* sealed, const uint8_t* plain, size_t from, size_t to,
+            const cymric_archive_params_t* p, const uint8_t k[])
+{
+    uint8_t n[CYMRIC_ARCHIVE_NONCEBYTES], r[BLOCKBYTES + TAGBYTES];
+    size_t i, j, rlen;
+    int failures = 0;
+
+    for (i = from; i < to; i++) {
+        for (j = 0; j < CYMRIC_ARCHIVE_NONCEBYTES; j++)
+            n[j] = (uint8_t)((p->first + i) >> (8*(CYMRIC_ARCHIVE_NONCEBYTES - 1 - j)));
+        CHECK(ref_enc(p->variant, r, &rlen, k, n, sizeof(n), plain + i*p->width, p->width, p->id, p->idlen) == 0);
+        CHECK(rlen == p->width + TAGBYTES && memcmp(sealed + i*rlen, r, rlen) == 0);
+    }
+    return failures;
+}
+
+/**
+ * @brief Seal, open and rekey an archive, with tampered records, and check
+ * the results against the reference functions.
+ */
+static int check_archive(const cymric_archive_params_t* p, const uint8_t k[],
+            const cymric_batch_key_t* key, const uint8_t k2[],
+            const cymric_batch_key_t* key2, uint64_t* seed)
+{
+    static const uint8_t zero[BLOCKBYTES + TAGBYTES];
+    size_t rec = p->width + TAGBYTES, i, failed;
+    uint8_t plain[COUNT*BLOCKBYTES], sealed[COUNT*(BLOCKBYTES + TAGBYTES)];
+    uint8_t out[COUNT*BLOCKBYTES], resealed[COUNT*(BLOCKBYTES + TAGBYTES)];
+    int failures = 0;
+
+    check_fill(plain, COUNT*p->width, seed);
+    CHECK(cymric_archive_seal(sealed, plain, COUNT, p, key) == 0);
+    failures += check_sealed(sealed, plain, 0, COUNT, p, k);
+
+    failed = COUNT;
+    CHECK(cymric_archive_open(out, sealed, COUNT, p, key, &failed) == 0);
+    CHECK(failed == 0 && memcmp(out, plain, COUNT*p->width) == 0);
+
+    // rekeying gives the archive sealed under the new key, which the old one
+    // no longer opens
+    failed = COUNT;
+    CHECK(cymric_archive_rekey(resealed, sealed, COUNT, p, key, key2, &failed) == 0);
+    CHECK(failed == 0);
+    failures += check_sealed(resealed, plain, 0, COUNT, p, k2);
+    CHECK(cymric_archive_open(out, resealed, COUNT, p, key, &failed) == 1);
+    CHECK(failed == COUNT);
+    CHECK(cymric_archive_open(out, resealed, COUNT, p, key2, &failed) == 0);
+    CHECK(failed == 0 && memcmp(out, plain, COUNT*p->width) == 0);
+
+    // records tampered with (tag or ciphertext) are zeroed by open and rekey
+    for (i = 0; i < COUNT; i += 5)
+        sealed[i*rec + (i % rec)] ^= 0x01;
+    CHECK(cymric_archive_open(out, sealed, COUNT, p, key, &failed) == 1);
+    CHECK(failed == (COUNT + 4)/5);
+    CHECK(cymric_archive_rekey(resealed, sealed, COUNT, p, key, key2, &failed) == 1);
+    CHECK(failed == (COUNT + 4)/5);
+    for (i = 0; i < COUNT; i++) {
+        if (i % 5 == 0) {
+            CHECK(memcmp(out + i*p->width, zero, p->width) == 0);
+            CHECK(memcmp(resealed + i*rec, zero, rec) == 0);
+        } else {
+            CHECK(memcmp(out + i*p->width, plain + i*p->width, p->width) == 0);
+            failures += check_sealed(resealed, plain, i, i + 1, p, k2);
+        }
+    }
+    return failures;
+}
+
+/**
+ * @brief Seal, rekey and open a file of records split among threads, and
+ * check that it matches the in-memory functions.
+ */
+static int check_file(const cymric_archive_params_t* p, const cymric_batch_key_t* key,
+            const cymric_batch_key_t* key2, uint64_t* seed)
+{
+    char plainpath[] = "/tmp/cymric-archive-XXXXXX";
+    char sealedpath[] = "/tmp/cymric-archive-XXXXXX";
+    char outpath[] = "/tmp/cymric-archive-XXXXXX";
+    char linkpath[sizeof(outpath) + 5];
+    size_t count = 3*CYMRIC_ARCHIVE_CHUNK + 5, rec = p->width + TAGBYTES;
+    uint8_t* plain = malloc(count*p->width);
+    uint8_t* sealed = malloc(count*rec);
+    uint8_t* buf = malloc(count*rec);
+    cymric_archive_stats_t stats;
+    int fd[3], failures = 0;
+
+    fd[0] = mkstemp(plainpath);
+    fd[1] = mkstemp(sealedpath);
+    fd[2] = mkstemp(outpath);
+    snprintf(linkpath, sizeof(linkpath), "%s.link", outpath);
+    if (plain == NULL || sealed == NULL || buf == NULL || fd[0] < 0 || fd[1] < 0 || fd[2] < 0) {
+        failures++;
+        goto end;
+    }
+    check_fill(plain, count*p->width, seed);
+    CHECK(write(fd[0], plain, count*p->width) == (ssize_t)(count*p->width));
+
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_SEAL, sealedpath, plainpath, p, key, NULL, &stats) == 0);
+    CHECK(stats.records == count && stats.failed == 0);
+    CHECK(cymric_archive_seal(sealed, plain, count, p, key) == 0);
+    CHECK(pread(fd[1], buf, count*rec, 0) == (ssize_t)(count*rec) && memcmp(buf, sealed, count*rec) == 0);
+
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_REKEY, outpath, sealedpath, p, key, key2, &stats) == 0);
+    CHECK(stats.records == count && stats.failed == 0);
+    CHECK(cymric_archive_seal(sealed, plain, count, p, key2) == 0);
+    CHECK(pread(fd[2], buf, count*rec, 0) == (ssize_t)(count*rec) && memcmp(buf, sealed, count*rec) == 0);
+
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_OPEN, plainpath, outpath, p, key, NULL, &stats) == 1);
+    CHECK(stats.failed == count);
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_OPEN, plainpath, outpath, p, key2, NULL, &stats) == 0);
+    CHECK(stats.failed == 0);
+    CHECK(pread(fd[0], buf, count*p->width, 0) == (ssize_t)(count*p->width) && memcmp(buf, plain, count*p->width) == 0);
+
+    // rekeying in place (same path or another link to the input) is rejected
+    // and leaves the input untouched
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_REKEY, outpath, outpath, p, key2, key, NULL) == -1);
+    CHECK(link(outpath, linkpath) == 0);
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_REKEY, linkpath, outpath, p, key2, key, NULL) == -1);
+    CHECK(pread(fd[2], buf, count*rec, 0) == (ssize_t)(count*rec) && memcmp(buf, sealed, count*rec) == 0);
+
+    // a truncated input is not a whole number of records
+    CHECK(ftruncate(fd[2], count*rec - 1) == 0);
+    CHECK(cymric_archive_file(CYMRIC_ARCHIVE_OPEN, plainpath, outpath, p, key2, NULL, NULL) == -1);
+end:
+    unlink(plainpath);
+    unlink(sealedpath);
+    unlink(outpath);
+    unlink(linkpath);
+    free(plain);
+    free(sealed);
+    free(buf);
+    return failures;
+}
+
+int test_archive(void)
+{
+    uint8_t k[2*KEYBYTES], k2[2*KEYBYTES];
+    cymric_batch_key_t key, key2;
+    cymric_archive_params_t p = {.first = 0x01020304050607f0};
+    uint64_t seed = 42;
+    int failures = 0;
+
+    check_fill(k, sizeof(k), &seed);
+    check_fill(k2, sizeof(k2), &seed);
+    cymric_batch_key_init(&key, k);
+    cymric_batch_key_init(&key2, k2);
+
+    // invalid parameters
+    p.variant = 3, p.width = 8;
+    CHECK(cymric_archive_check(&p) == -1);
+    p.variant = 1, p.width = 9;
+    CHECK(cymric_archive_check(&p) == -1);
+    p.variant = 2, p.width = 0;
+    CHECK(cymric_archive_check(&p) == -1);
+    p.width = 17;
+    CHECK(cymric_archive_check(&p) == -1);
+    p.width = 16, p.idlen = CYMRIC_ARCHIVE_MAX_IDBYTES + 1;
+    CHECK(cymric_archive_check(&p) == -1);
+    CHECK(cymric_archive_seal(NULL, NULL, 0, &p, &key) == -1);
+
+    for (p.variant = 1; p.variant <= 2; p.variant++) {
+        for (p.width = 1; p.width <= max_mlen(p.variant, CYMRIC_ARCHIVE_NONCEBYTES); p.width++) {
+            for (p.idlen = 0; p.idlen <= CYMRIC_ARCHIVE_MAX_IDBYTES; p.idlen++) {
+                check_fill(p.id, p.idlen, &seed);
+                CHECK(cymric_archive_check(&p) == 0);
+                failures += check_archive(&p, k, &key, k2, &key2, &seed);
+            }
+        }
+    }
+
+    p = (cymric_archive_params_t){.variant = 2, .width = 5, .idlen = 3, .first = 7, .threads = 4};
+    failures += check_file(&p, &key, &key2, &seed);
+    return failures;
+}
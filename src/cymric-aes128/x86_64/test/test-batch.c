@@ -0,0 +1,137 @@
+/**
+ * @file test-batch.c
+ *
+ * @brief Structure-of-arrays batches and their 8-lane kernels (cymric-batch.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "../cymric-batch.h"
+
+typedef size_t (*batch_fn_t)(cymric_soa_t*, const cymric_batch_key_t*);
+
+/**
+ * @brief Fill a batch with valid (nlen, alen, mlen) of a variant (all of them
+ * if the batch is large enough) followed by a few invalid ones, the bytes of
+ * the slots beyond the lengths being random.
+ *
+ * @return The number of invalid messages
+ */
+static size_t fill_batch(cymric_soa_t* b, int variant, uint64_t* seed)
+{
+    static const cymric_len_t invalid[] = {{12, 4, 0, 0}, {15, 1, 0, 0}, {8, 3, 17, 0}, {8, 3, 9, 0}};
+    size_t max = b->count - sizeof(invalid)/sizeof(invalid[0]);
+    size_t nlen, alen, mlen, i = 0, j;
+
+    // a short batch takes lengths at random rather than the first ones
+    for (nlen = 0; nlen < BLOCKBYTES; nlen++)
+        for (alen = 0; nlen + alen < BLOCKBYTES; alen++)
+            for (mlen = 0; mlen <= max_mlen(variant, nlen) && i < max; mlen++)
+                b->len[i++] = (cymric_len_t){nlen, alen, mlen, 0};
+    if (max < 64) {
+        uint8_t r[3];
+        for (i = 0; i < max; i++) {
+            check_fill(r, sizeof(r), seed);
+            nlen = r[0] % BLOCKBYTES;
+            alen = r[1] % (BLOCKBYTES - nlen);
+            mlen = r[2] % (max_mlen(variant, nlen) + 1);
+            b->len[i] = (cymric_len_t){nlen, alen, mlen, 0};
+        }
+    }
+    for (j = 0; j < sizeof(invalid)/sizeof(invalid[0]); j++)
+        if (variant == 1 || invalid[j].mlen > BLOCKBYTES || invalid[j].nlen + invalid[j].alen >= BLOCKBYTES)
+            b->len[i++] = invalid[j];
+    b->count = i;
+    check_fill(&b->n[0][0], i*BLOCKBYTES, seed);
+    check_fill(&b->a[0][0], i*BLOCKBYTES, seed);
+    check_fill(&b->m[0][0], i*BLOCKBYTES, seed);
+    check_fill(&b->c[0][0], i*BLOCKBYTES, seed);
+    check_fill(&b->t[0][0], i*TAGBYTES, seed);
+    for (j = 0; j < i; j++) {
+        cymric_len_t l = b->len[j];
+
+        if (l.nlen + l.alen > BLOCKBYTES - 1 || l.mlen > max_mlen(variant, l.nlen))
+            break;
+    }
+    return i - j;
+}
+
+/**
+ * @brief Encrypt then decrypt a batch filled by fill_batch (with every third
+ * tag tampered) and check each message against the reference functions.
+ */
+static int check_batch(cymric_soa_t* b, int variant, const uint8_t k[], const cymric_batch_key_t* key,
+            batch_fn_t enc, batch_fn_t dec, uint64_t* seed)
+{
+    static const uint8_t zero[BLOCKBYTES];
+    uint8_t (*m)[BLOCKBYTES] = malloc(b->count*BLOCKBYTES);
+    uint8_t r[BLOCKBYTES + TAGBYTES];
+    size_t invalid = fill_batch(b, variant, seed);
+    size_t i, rlen, tampered = 0;
+    int failures = 0;
+
+    if (m == NULL)
+        return 1;
+    memcpy(m, b->m, b->count*BLOCKBYTES);
+    CHECK(enc(b, key) == invalid);
+    for (i = 0; i < b->count; i++) {
+        cymric_len_t l = b->len[i];
+        int ret = ref_enc(variant, r, &rlen, k, b->n[i], l.nlen, m[i], l.mlen, b->a[i], l.alen);
+
+        CHECK(cymric_soa_ok(b, i) == (ret == 0));
+        if (ret == 0) {
+            CHECK(memcmp(b->c[i], r, l.mlen) == 0 && memcmp(b->t[i], r + l.mlen, TAGBYTES) == 0);
+            CHECK(memcmp(b->c[i] + l.mlen, zero, BLOCKBYTES - l.mlen) == 0);
+        }
+    }
+
+    // decryption, tampering with every third tag
+    check_fill(&b->m[0][0], b->count*BLOCKBYTES, seed);
+    for (i = 0; i < b->count; i += 3) {
+        b->t[i][i % TAGBYTES] ^= 0x10;
+        tampered += cymric_soa_ok(b, i);
+    }
+    CHECK(dec(b, key) == invalid + tampered);
+    for (i = 0; i < b->count; i++) {
+        cymric_len_t l = b->len[i];
+        int good = (i % 3 != 0) && (l.nlen + l.alen < BLOCKBYTES) && (l.mlen <= max_mlen(variant, l.nlen));
+
+        CHECK(cymric_soa_ok(b, i) == good);
+        if (good)
+            CHECK(memcmp(b->m[i], m[i], l.mlen) == 0 && memcmp(b->m[i] + l.mlen, zero, BLOCKBYTES - l.mlen) == 0);
+        else
+            CHECK(memcmp(b->m[i], zero, BLOCKBYTES) == 0);
+    }
+    free(m);
+    return failures;
+}
+
+int test_batch(void)
+{
+    uint8_t k[2*KEYBYTES];
+    cymric_batch_key_t key;
+    cymric_soa_t b, view;
+    uint64_t seed = 32;
+    int failures = 0;
+
+    check_fill(k, sizeof(k), &seed);
+    cymric_batch_key_init(&key, k);
+    CHECK(cymric_soa_alloc(&b, 4096) == 0);
+
+    b.count = 4096;
+    failures += check_batch(&b, 1, k, &key, cymric1_batch_enc, cymric1_batch_dec, &seed);
+    b.count = 4096;
+    failures += check_batch(&b, 2, k, &key, cymric2_batch_enc, cymric2_batch_dec, &seed);
+
+    // views start on a bitmap word and process partial groups of lanes
+    b.count = 4096;
+    CHECK(cymric_soa_slice(&view, &b, 60, 10) != 0);
+    CHECK(cymric_soa_slice(&view, &b, 64, 4096) != 0);
+    CHECK(cymric_soa_slice(&view, &b, 128, 29) == 0);
+    failures += check_batch(&view, 1, k, &key, cymric1_batch_enc, cymric1_batch_dec, &seed);
+    CHECK(cymric_soa_slice(&view, &b, 192, 11) == 0);
+    failures += check_batch(&view, 2, k, &key, cymric2_batch_enc, cymric2_batch_dec, &seed);
+
+    cymric_soa_free(&b);
+    return failures;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file test-fused.c
+ *
+ * @brief Single-message latency kernels and one-shot-key kernels
+ * (cymric-fused.h).
+ */
+#include <string.h>
+#include "check.h"
+#include "../cymric-fused.h"
+
+typedef int (*enc_fn_t)(uint8_t[], size_t*, const uint8_t[], const uint8_t[], size_t,
+        const uint8_t[], size_t, const uint8_t[], size_t, const cipher_ctx_t*);
+typedef int (*dec_fn_t)(uint8_t[], size_t*, const uint8_t[], const uint8_t[], size_t,
+        const uint8_t[], size_t, const uint8_t[], size_t, const cipher_ctx_t*);
+
+/**
+ * @brief Encrypt and decrypt every (nlen, alen, mlen), valid or not, with a
+ * key given as k to the kernels, and check the results and return codes
+ * against the reference functions with online key expansion of kref.
+ */
+static int check_kernel(int variant, enc_fn_t enc, dec_fn_t dec, const uint8_t kref[],
+            const uint8_t k[], const cipher_ctx_t* ctx, uint64_t* seed)
+{
+    static const uint8_t zero[BLOCKBYTES];
+    uint8_t n[BLOCKBYTES], a[BLOCKBYTES], m[BLOCKBYTES + 1];
+    uint8_t c[BLOCKBYTES + TAGBYTES + 1], r[BLOCKBYTES + TAGBYTES + 1], x[BLOCKBYTES];
+    size_t nlen, alen, mlen, clen, rlen, xlen;
+    int ret, failures = 0;
+
+    for (nlen = 0; nlen <= BLOCKBYTES; nlen++) {
+        for (alen = 0; nlen + alen <= BLOCKBYTES; alen++) {
+            for (mlen = 0; mlen <= BLOCKBYTES + 1; mlen++) {
+                check_fill(n, sizeof(n), seed);
+                check_fill(a, sizeof(a), seed);
+                check_fill(m, sizeof(m), seed);
+                ret = ref_enc(variant, r, &rlen, kref, n, nlen, m, mlen, a, alen);
+                CHECK(enc(c, &clen, k, n, nlen, m, mlen, a, alen, ctx) == ret);
+                if (ret != 0)
+                    continue;
+                CHECK(clen == rlen && memcmp(c, r, rlen) == 0);
+
+                CHECK(dec(x, &xlen, k, n, nlen, c, clen, a, alen, ctx) == 0);
+                CHECK(xlen == mlen && memcmp(x, m, mlen) == 0);
+
+                // tampering with the ciphertext or the tag
+                c[(nlen + alen + mlen) % clen] ^= 0x08;
+                memset(x, 0xff, sizeof(x));
+                CHECK(dec(x, &xlen, k, n, nlen, c, clen, a, alen, ctx) == 1);
+                CHECK(memcmp(x, zero, mlen) == 0);
+                CHECK(ref_dec(variant, x, &xlen, kref, n, nlen, c, clen, a, alen) == 1);
+            }
+        }
+    }
+
+    // ciphertexts shorter than a tag
+    for (clen = 0; clen < TAGBYTES; clen++)
+        CHECK(dec(x, &xlen, k, n, 4, c, clen, a, 4, ctx) == -1);
+    return failures;
+}
+
+int test_fused(void)
+{
+    uint8_t k[2*KEYBYTES], pre[2*sizeof(aes_roundkeys_t) + 1];
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t online = aes_get_cipher_ctx(), precomputed = aes_get_cipher_ctx();
+    uint64_t seed = 49;
+    int variant, failures = 0;
+
+    check_fill(k, sizeof(k), &seed);
+    online.roundkeys = &rkeys;
+
+    // precomputed round keys of K and K', at an unaligned address
+    precomputed.kexpand = NULL;
+    aes128_kexp(&rkeys, k);
+    memcpy(pre + 1, &rkeys, sizeof(rkeys));
+    aes128_kexp(&rkeys, k + KEYBYTES);
+    memcpy(pre + 1 + sizeof(rkeys), &rkeys, sizeof(rkeys));
+
+    for (variant = 1; variant <= 2; variant++) {
+        enc_fn_t enc = (variant == 1) ? cymric1_enc_fused : cymric2_enc_fused;
+        dec_fn_t dec = (variant == 1) ? cymric1_dec_fused : cymric2_dec_fused;
+
+        failures += check_kernel(variant, enc, dec, k, k, &online, &seed);
+        failures += check_kernel(variant, enc, dec, k, pre + 1, &precomputed, &seed);
+    }
+    return failures;
+}
+
+// the one-shot kernels behind the signature of the fused ones, ctx being unused
+#define ONESHOT(name)                                                           \
+    static int name##_ctx(uint8_t out[], size_t* outlen, const uint8_t k[],    \
+                const uint8_t n[], size_t nlen, const uint8_t in[], size_t inlen, \
+                const uint8_t a[], size_t alen, const cipher_ctx_t* ctx)        \
+    {                                                                           \
+        (void)ctx;                                                              \
+        return name(out, outlen, k, n, nlen, in, inlen, a, alen);               \
+    }
+
+ONESHOT(cymric1_enc_oneshot)
+ONESHOT(cymric1_dec_oneshot)
+ONESHOT(cymric2_enc_oneshot)
+ONESHOT(cymric2_dec_oneshot)
+
+int test_oneshot(void)
+{
+    uint8_t k[2*KEYBYTES + 1];
+    uint64_t seed = 50;
+    int i, failures = 0;
+
+    // a few keys, at an unaligned address
+    for (i = 0; i < 4; i++) {
+        check_fill(k + 1, 2*KEYBYTES, &seed);
+        failures += check_kernel(1, cymric1_enc_oneshot_ctx, cymric1_dec_oneshot_ctx, k + 1, k + 1, NULL, &seed);
+        failures += check_kernel(2, cymric2_enc_oneshot_ctx, cymric2_dec_oneshot_ctx, k + 1, k + 1, NULL, &seed);
+    }
+    return failures;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file test-gateway.c
+ *
+ * @brief Receive -> decrypt -> forward path over loopback, with both backends
+ * (cymric-gateway.h).
+ */
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "check.h"
+#include "../cymric-gateway.h"
+
+#define FRAMES  40      // authentic frames, followed by 6 forged or malformed ones
+#define CTRLEN  4
+#define BATCH   8
+#define BUFFERS 16      // fewer than the datagrams sent: the receive is re-armed
+
+/**
+ * @brief UDP socket bound to an ephemeral loopback port, connected to port
+ * unless it is 0.
+ */
+static int udp_socket(uint16_t* port, uint16_t to)
+{
+    struct sockaddr_in sa = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(sa);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 ||
+        getsockname(fd, (struct sockaddr*)&sa, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(sa.sin_port);
+    sa.sin_port = htons(to);
+    if (to != 0 && connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Build frame i in plain (m in the C slot, as forwarded) and sealed,
+ * its counter i being the last CTRLEN bytes of the nonce.
+ */
+static void make_frame(uint8_t plain[CYMRIC_GW_FWDBYTES], uint8_t sealed[CYMRIC_GW_FRAMEBYTES + 1],
+            int variant, const uint8_t k[], size_t i, uint64_t* seed)
+{
+    cymric_len_t len;
+    uint8_t r[BLOCKBYTES + TAGBYTES];
+    size_t j, rlen;
+
+    len.nlen = CTRLEN + i % (BLOCKBYTES - CTRLEN);
+    len.alen = i % (BLOCKBYTES - len.nlen);
+    len.mlen = i % (max_mlen(variant, len.nlen) + 1);
+    len.reserved = 0;
+    memset(plain, 0x00, CYMRIC_GW_FWDBYTES);
+    memcpy(plain, &len, sizeof(len));
+    check_fill(plain + 4, 12, seed);
+    check_fill(plain + 16, len.nlen, seed);
+    check_fill(plain + 32, len.alen, seed);
+    check_fill(plain + 48, len.mlen, seed);
+    for (j = 0; j < CTRLEN; j++)
+        plain[16 + len.nlen - 1 - j] = (uint8_t)(i >> (8*j));
+
+    ref_enc(variant, r, &rlen, k, plain + 16, len.nlen, plain + 48, len.mlen, plain + 32, len.alen);
+    memset(sealed, 0x00, CYMRIC_GW_FRAMEBYTES + 1);
+    memcpy(sealed, plain, 48);
+    memcpy(sealed + 48, r, len.mlen);
+    memcpy(sealed + 64, r + len.mlen, TAGBYTES);
+}
+
+/**
+ * @brief Send authentic, forged, malformed and replayed frames through a
+ * gateway, and check that exactly the authentic ones reach the sink, once and
+ * with their plaintext, the others being counted as dropped.
+ */
+static int check_backend(int backend, int variant, const uint8_t k[],
+            const cymric_batch_key_t* key, uint64_t* seed)
+{
+    uint8_t plain[FRAMES + 6][CYMRIC_GW_FWDBYTES], sealed[FRAMES + 6][CYMRIC_GW_FRAMEBYTES + 1];
+    uint8_t buf[CYMRIC_GW_BUFBYTES], seen[FRAMES] = {0};
+    cymric_gw_config_t cfg = {.backend = backend, .variant = variant, .key = key,
+                              .batch = BATCH, .buffers = BUFFERS};
+    cymric_replay_t filter;
+    cymric_gw_t gw;
+    struct pollfd pfd;
+    uint16_t rx_port, sink_port, port;
+    size_t i, sent = 0, received = 0;
+    int gen, sink, idle, failures = 0;
+    ssize_t len;
+
+    CHECK(cymric_replay_init(&filter, CTRLEN) == 0);
+    cfg.filter = &filter;
+    sink   = udp_socket(&sink_port, 0);
+    cfg.rx = udp_socket(&rx_port, 0);
+    cfg.tx = udp_socket(&port, sink_port);
+    gen    = udp_socket(&port, rx_port);
+    CHECK(sink >= 0 && cfg.rx >= 0 && cfg.tx >= 0 && gen >= 0);
+    if (sink < 0 || cfg.rx < 0 || cfg.tx < 0 || gen < 0 || cymric_gw_init(&gw, &cfg) != 0) {
+        // the io_uring backend may not be available (or allowed) in this kernel
+        CHECK(backend == CYMRIC_GW_URING && sink >= 0 && cfg.rx >= 0 && cfg.tx >= 0 && gen >= 0);
+        goto end;
+    }
+
+    for (i = 0; i < FRAMES + 6; i++)
+        make_frame(plain[i], sealed[i], variant, k, i, seed);
+    for (i = 0; i < FRAMES; i++)
+        sent += (send(gen, sealed[i], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+
+    // forged tag and ciphertext, with fresh counters
+    sealed[FRAMES][64 + 5] ^= 0x01;
+    sealed[FRAMES + 1][48] ^= 0x80;
+    sealed[FRAMES + 1][64] ^= (sealed[FRAMES + 1][2] == 0);     // no ciphertext: forge the tag
+    sent += (send(gen, sealed[FRAMES], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+    sent += (send(gen, sealed[FRAMES + 1], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+
+    // malformed, with fresh counters as well: truncated, oversized (the frame
+    // itself being authentic), and lengths out of range
+    sent += (send(gen, sealed[FRAMES + 2], CYMRIC_GW_FRAMEBYTES - 1, 0) == CYMRIC_GW_FRAMEBYTES - 1);
+    sent += (send(gen, sealed[FRAMES + 3], CYMRIC_GW_FRAMEBYTES + 1, 0) == CYMRIC_GW_FRAMEBYTES + 1);
+    sealed[FRAMES + 4][1] = BLOCKBYTES - sealed[FRAMES + 4][0];
+    sealed[FRAMES + 5][2] = BLOCKBYTES + 1;
+    sent += (send(gen, sealed[FRAMES + 4], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+    sent += (send(gen, sealed[FRAMES + 5], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+
+    // replayed
+    sent += (send(gen, sealed[2], CYMRIC_GW_FRAMEBYTES, 0) == CYMRIC_GW_FRAMEBYTES);
+    CHECK(sent == FRAMES + 7);
+
+    for (idle = 0; gw.stats.received < sent && idle < 20; ) {
+        int n = cymric_gw_poll(&gw, 50);
+
+        CHECK(n >= 0);
+        idle = (n <= 0) ? idle + 1 : 0;
+    }
+    CHECK(gw.stats.received == sent);
+    CHECK(gw.stats.forwarded == FRAMES && gw.stats.dropped == sent - FRAMES);
+
+    // the sink gets each authentic frame once, without its tag
+    pfd = (struct pollfd){.fd = sink, .events = POLLIN};
+    for (idle = 0; received < FRAMES + 1 && idle < 5; ) {
+        if ((len = recv(sink, buf, sizeof(buf), MSG_DONTWAIT)) < 0) {
+            // sends of the io_uring backend complete in a later poll
+            cymric_gw_poll(&gw, 0);
+            idle += (poll(&pfd, 1, 50) <= 0);
+            continue;
+        }
+        received++;
+        i = (len == CYMRIC_GW_FWDBYTES && buf[0] >= CTRLEN && buf[0] <= BLOCKBYTES)
+            ? (size_t)buf[16 + buf[0] - 1] | (size_t)buf[16 + buf[0] - 2] << 8 : FRAMES;
+        CHECK(i < FRAMES && !seen[i]);
+        if (i < FRAMES && !seen[i]) {
+            CHECK(memcmp(buf, plain[i], CYMRIC_GW_FWDBYTES) == 0);
+            seen[i] = 1;
+        }
+    }
+    CHECK(received == FRAMES);
+    cymric_gw_close(&gw);
+
+end:
+    close(gen);
+    close(cfg.tx);
+    close(cfg.rx);
+    close(sink);
+    return failures;
+}
+
+int test_gateway(void)
+{
+    uint8_t k[2*KEYBYTES];
+    cymric_batch_key_t key;
+    cymric_gw_config_t cfg = {.backend = CYMRIC_GW_URING, .variant = 1, .key = &key,
+                              .rx = -1, .tx = -1, .batch = BATCH, .buffers = 12};
+    cymric_gw_t gw;
+    uint64_t seed = 48;
+    int variant, failures = 0;
+
+    check_fill(k, sizeof(k), &seed);
+    cymric_batch_key_init(&key, k);
+
+    // invalid configurations
+    CHECK(cymric_gw_init(&gw, &cfg) != 0);
+    cfg.buffers = BATCH/2;
+    CHECK(cymric_gw_init(&gw, &cfg) != 0);
+    cfg.backend = CYMRIC_GW_RECVMMSG, cfg.batch = CYMRIC_GW_MAX_BATCH + 1;
+    CHECK(cymric_gw_init(&gw, &cfg) != 0);
+    cfg.batch = BATCH, cfg.variant = 3;
+    CHECK(cymric_gw_init(&gw, &cfg) != 0);
+
+    for (variant = 1; variant <= 2; variant++) {
+        failures += check_backend(CYMRIC_GW_RECVMMSG, variant, k, &key, &seed);
+        failures += check_backend(CYMRIC_GW_URING, variant, k, &key, &seed);
+    }
+    return failures;
+}
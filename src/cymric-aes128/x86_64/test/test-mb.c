@@ -0,0 +1,197 @@
+/**
+ * @file test-mb.c
+ *
+ * @brief Multi-buffer job manager (cymric-mb.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "../cymric-mb.h"
+
+#define KEYS    3
+#define MAXJOBS (2*BLOCKBYTES*BLOCKBYTES*(BLOCKBYTES + 1) + 16)
+
+typedef struct {
+    cymric_job_t job;
+    int key;
+    uint8_t n[BLOCKBYTES], a[BLOCKBYTES], in[BLOCKBYTES + TAGBYTES], out[BLOCKBYTES + TAGBYTES];
+} test_job_t;
+
+/**
+ * @brief Submit jobs one at a time then flush the manager, checking that each
+ * job is returned exactly once.
+ */
+static int run_jobs(cymric_mb_mgr_t* mgr, test_job_t* t, size_t count)
+{
+    uint8_t* returned = calloc(count, 1);
+    cymric_job_t* done;
+    size_t i, total = 0;
+    int failures = 0;
+
+    if (returned == NULL)
+        return 1;
+    for (i = 0; i <= count; i++) {
+        done = (i < count) ? cymric_mb_submit(mgr, &t[i].job) : cymric_mb_flush(mgr);
+        while (done != NULL) {
+            size_t j = (test_job_t*)done - t;
+
+            CHECK(j < count && !returned[j] && done->status != CYMRIC_JOB_PENDING);
+            returned[j] = 1;
+            total++;
+            done = (i < count) ? cymric_mb_get_completed(mgr) : cymric_mb_flush(mgr);
+        }
+    }
+    CHECK(total == count && cymric_mb_in_flight(mgr) == 0);
+    free(returned);
+    return failures;
+}
+
+/**
+ * @brief Encrypt then decrypt every valid length of both variants, with
+ * several keys, tampered tags and invalid jobs mixed in, and check each job
+ * against the reference functions.
+ */
+static int check_jobs(cymric_mb_mgr_t* mgr, uint8_t k[KEYS][2*KEYBYTES],
+            const cymric_batch_key_t key[KEYS], uint64_t* seed)
+{
+    static const uint8_t zero[BLOCKBYTES];
+    test_job_t* t = malloc(MAXJOBS*sizeof(test_job_t));
+    uint8_t r[BLOCKBYTES + TAGBYTES];
+    size_t i, count = 0, nlen, alen, mlen, rlen;
+    int variant, failures = 0;
+
+    if (t == NULL)
+        return 1;
+
+    // both variants interleaved, so that their lanes fill concurrently
+    for (nlen = 0; nlen < BLOCKBYTES; nlen++)
+        for (alen = 0; nlen + alen < BLOCKBYTES; alen++)
+            for (mlen = 0; mlen <= BLOCKBYTES; mlen++)
+                for (variant = 1; variant <= 2; variant++) {
+                    if (mlen > max_mlen(variant, nlen))
+                        continue;
+                    t[count].key = count % KEYS;
+                    t[count].job = (cymric_job_t){
+                        .key = &key[t[count].key], .variant = variant, .dir = CYMRIC_JOB_ENC,
+                        .n = t[count].n, .nlen = nlen, .a = t[count].a, .alen = alen,
+                        .in = t[count].in, .inlen = mlen, .out = t[count].out,
+                    };
+                    count++;
+                }
+    for (i = 0; i < count; i++) {
+        check_fill(t[i].n, BLOCKBYTES, seed);
+        check_fill(t[i].a, BLOCKBYTES, seed);
+        check_fill(t[i].in, BLOCKBYTES, seed);
+    }
+    failures += run_jobs(mgr, t, count);
+    for (i = 0; i < count; i++) {
+        cymric_job_t* j = &t[i].job;
+
+        CHECK(ref_enc(j->variant, r, &rlen, k[t[i].key], j->n, j->nlen, j->in, j->inlen, j->a, j->alen) == 0);
+        CHECK(j->status == CYMRIC_JOB_OK && j->outlen == rlen && memcmp(j->out, r, rlen) == 0);
+    }
+
+    // decryption of the outputs, with every third tag tampered
+    for (i = 0; i < count; i++) {
+        cymric_job_t* j = &t[i].job;
+
+        memcpy(t[i].in, t[i].out, j->outlen);
+        j->inlen = j->outlen;
+        j->dir = CYMRIC_JOB_DEC;
+        if (i % 3 == 0)
+            t[i].in[j->inlen - 1 - i % TAGBYTES] ^= 0x04;
+    }
+    failures += run_jobs(mgr, t, count);
+    for (i = 0; i < count; i++) {
+        cymric_job_t* j = &t[i].job;
+
+        rlen = j->inlen - TAGBYTES;
+        CHECK(j->outlen == rlen);
+        if (i % 3 == 0) {
+            CHECK(j->status == CYMRIC_JOB_AUTH && memcmp(j->out, zero, rlen) == 0);
+            CHECK(ref_dec(j->variant, r, &rlen, k[t[i].key], j->n, j->nlen, j->in, j->inlen, j->a, j->alen) == 1);
+        } else {
+            CHECK(ref_dec(j->variant, r, &rlen, k[t[i].key], j->n, j->nlen, j->in, j->inlen, j->a, j->alen) == 0);
+            CHECK(j->status == CYMRIC_JOB_OK && j->outlen == rlen && memcmp(j->out, r, rlen) == 0);
+        }
+    }
+
+    // invalid jobs complete at once, among valid ones
+    for (i = 0; i < 8; i++) {
+        cymric_job_t* j = &t[i].job;
+
+        j->dir = CYMRIC_JOB_ENC;
+        j->variant = 1 + (i & 1);
+        j->nlen = 8, j->alen = 3, j->inlen = 5;
+    }
+    t[1].job.alen = 8;                      // N||A fills a block
+    t[2].job.inlen = 9;                     // N||M too long for Cymric1
+    t[3].job.inlen = 17;                    // M too long
+    t[4].job.variant = 3;
+    t[5].job.dir = 2;
+    t[6].job.dir = CYMRIC_JOB_DEC;          // shorter than a tag
+    t[7].job.key = NULL;
+    failures += run_jobs(mgr, t, 8);
+    CHECK(t[0].job.status == CYMRIC_JOB_OK);
+    for (i = 1; i < 8; i++)
+        CHECK(t[i].job.status == CYMRIC_JOB_INVALID && t[i].job.outlen == 0);
+
+    free(t);
+    return failures;
+}
+
+/**
+ * @brief Re-initialize a key object in place between jobs: the lanes holding
+ * its former round keys must reload them.
+ */
+static int check_rekey(cymric_mb_mgr_t* mgr, uint64_t* seed)
+{
+    test_job_t t[2*CYMRIC_BATCH_LANES];
+    uint8_t k[2*KEYBYTES], r[BLOCKBYTES + TAGBYTES];
+    cymric_batch_key_t key;
+    size_t i, round, rlen;
+    int failures = 0;
+
+    for (round = 0; round < 3; round++) {
+        check_fill(k, sizeof(k), seed);
+        cymric_batch_key_init(&key, k);
+        for (i = 0; i < 2*CYMRIC_BATCH_LANES; i++) {
+            check_fill(t[i].n, BLOCKBYTES, seed);
+            check_fill(t[i].in, BLOCKBYTES, seed);
+            t[i].job = (cymric_job_t){
+                .key = &key, .variant = 2, .dir = CYMRIC_JOB_ENC,
+                .n = t[i].n, .nlen = 12, .a = t[i].a, .alen = 0,
+                .in = t[i].in, .inlen = 16, .out = t[i].out,
+            };
+        }
+        // a partial group first, so that lanes keep keys across flushes
+        failures += run_jobs(mgr, t, 3 + round);
+        failures += run_jobs(mgr, t + 3 + round, 2*CYMRIC_BATCH_LANES - 3 - round);
+        for (i = 0; i < 2*CYMRIC_BATCH_LANES; i++) {
+            cymric_job_t* j = &t[i].job;
+
+            CHECK(ref_enc(2, r, &rlen, k, j->n, j->nlen, j->in, j->inlen, j->a, j->alen) == 0);
+            CHECK(j->status == CYMRIC_JOB_OK && memcmp(j->out, r, rlen) == 0);
+        }
+    }
+    return failures;
+}
+
+int test_mb(void)
+{
+    uint8_t k[KEYS][2*KEYBYTES];
+    cymric_batch_key_t key[KEYS];
+    cymric_mb_mgr_t mgr;
+    uint64_t seed = 47;
+    int i, failures = 0;
+
+    for (i = 0; i < KEYS; i++) {
+        check_fill(k[i], sizeof(k[i]), &seed);
+        cymric_batch_key_init(&key[i], k[i]);
+    }
+    cymric_mb_init(&mgr);
+    CHECK(cymric_mb_flush(&mgr) == NULL && cymric_mb_get_completed(&mgr) == NULL);
+    failures += check_jobs(&mgr, k, key, &seed);
+    failures += check_rekey(&mgr, &seed);
+    return failures;
+}
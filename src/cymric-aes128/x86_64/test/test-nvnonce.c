@@ -0,0 +1,186 @@
+/**
+ * @file test-nvnonce.c
+ *
+ * @brief Persistent counter-based nonces and their storage backends
+ * (cymric-nvnonce.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "check.h"
+#include "../cymric-nvnonce.h"
+
+#define CTRLEN  3
+#define STEP    16
+#define PAGE    64      // 4 records per flash page
+
+static const uint8_t prefix[] = {0xde, 0xad, 0xbe, 0xef};
+static uint8_t flash[2][PAGE];
+
+static int flash_erase(const uint8_t* page)
+{
+    memset((uint8_t*)page, 0xff, PAGE);
+    return 0;
+}
+
+static int flash_program(const uint8_t* addr, const uint8_t* data, size_t len)
+{
+    memcpy((uint8_t*)addr, data, len);
+    return 0;
+}
+
+static int write_file(const char* path, const void* data, size_t len)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600), ret;
+
+    if (fd < 0)
+        return -1;
+    ret = (write(fd, data, len) == (ssize_t)len) ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+/**
+ * @brief Open a state on a backend and encrypt count messages, checking that
+ * the counter goes on from first and that each message is encrypted under
+ * prefix || counter.
+ */
+static int take(const cymric_nvnonce_backend_t* backend, uint64_t first, size_t count,
+            uint64_t* seed)
+{
+    uint8_t k[2*KEYBYTES], m[4], c[4 + TAGBYTES], r[4 + TAGBYTES];
+    aes_roundkeys_t rkeys;
+    cipher_ctx_t ctx = aes_get_cipher_ctx();
+    cymric_nvnonce_t s;
+    size_t i, j, clen, rlen;
+    uint64_t ctr;
+    int failures = 0;
+
+    ctx.roundkeys = &rkeys;
+    check_fill(k, sizeof(k), seed);
+    CHECK(cymric_nvnonce_open(&s, backend, prefix, sizeof(prefix), CTRLEN, STEP) == 0);
+    for (i = 0; i < count; i++) {
+        check_fill(m, sizeof(m), seed);
+        CHECK(cymric1_nvnonce_enc(&s, c, &clen, k, m, sizeof(m), prefix, 2, &ctx) == 0);
+        CHECK(s.nlen == sizeof(prefix) + CTRLEN && memcmp(s.n, prefix, sizeof(prefix)) == 0);
+        for (j = sizeof(prefix), ctr = 0; j < s.nlen; j++)
+            ctr = (ctr << 8) | s.n[j];
+        CHECK(ctr == first + i);
+        CHECK(ref_enc(1, r, &rlen, k, s.n, s.nlen, m, sizeof(m), prefix, 2) == 0);
+        CHECK(clen == rlen && memcmp(c, r, rlen) == 0);
+    }
+    return failures;
+}
+
+/**
+ * @brief File backend: fresh state, recovery from the stored high-water
+ * mark, and corrupt or unreadable files failing instead of restarting the
+ * counter from 0.
+ */
+static int check_file(uint64_t* seed)
+{
+    char dir[] = "/tmp/cymric-nvnonce-XXXXXX", path[64], notdir[64], tmp[64];
+    uint8_t rec[CYMRIC_NVNONCE_RECBYTES];
+    cymric_nvnonce_backend_t backend;
+    cymric_nvnonce_t s;
+    int failures = 0;
+
+    if (mkdtemp(dir) == NULL)
+        return 1;
+    snprintf(path, sizeof(path), "%s/hwm", dir);
+    snprintf(notdir, sizeof(notdir), "%s/hwm/hwm", dir);
+    snprintf(tmp, sizeof(tmp), "%s/hwm.tmp", dir);
+    backend = cymric_nvnonce_file_backend(path);
+
+    // no file yet: counter from 0, then from the end of each reservation
+    failures += take(&backend, 0, 5, seed);
+    failures += take(&backend, STEP, STEP + 1, seed);
+    failures += take(&backend, 3*STEP, 1, seed);
+
+    // corrupt and short records
+    CHECK(write_file(path, "0123456789abcdef", CYMRIC_NVNONCE_RECBYTES) == 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+    memset(rec, 0xff, sizeof(rec));
+    CHECK(write_file(path, rec, sizeof(rec)) == 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+    CHECK(write_file(path, rec, sizeof(rec)/2) == 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+    CHECK(write_file(path, rec, 0) == 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+
+    // files which cannot be opened or read for another reason than not existing
+    backend = cymric_nvnonce_file_backend(notdir);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+    unlink(path);
+    CHECK(mkdir(path, 0700) == 0);
+    backend = cymric_nvnonce_file_backend(path);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, STEP) != 0);
+    rmdir(path);
+
+    unlink(tmp);
+    rmdir(dir);
+    return failures;
+}
+
+/**
+ * @brief Flash backend: recovery across page switches, torn records being
+ * skipped, and exhaustion of the counter space.
+ */
+static int check_flash(uint64_t* seed)
+{
+    cymric_nvnonce_flash_t f = {
+        .pages = {flash[0], flash[1]}, .page_size = PAGE,
+        .erase = flash_erase, .program = flash_program,
+    };
+    cymric_nvnonce_backend_t backend;
+    cymric_nvnonce_t s;
+    uint64_t next = 0;
+    int i, failures = 0;
+
+    memset(flash, 0xff, sizeof(flash));
+    for (i = 0; i < 11; i++) {
+        backend = cymric_nvnonce_flash_backend(&f);
+        failures += take(&backend, next, STEP/2 + i, seed);
+        next = ((next + STEP/2 + i + STEP - 1)/STEP)*STEP;
+    }
+
+    // a record torn while being programmed (half of it written) is skipped
+    CHECK(f.slot < PAGE/CYMRIC_NVNONCE_RECBYTES);
+    if (f.slot < PAGE/CYMRIC_NVNONCE_RECBYTES) {
+        uint8_t torn[CYMRIC_NVNONCE_RECBYTES/2];
+
+        memset(torn, 0x00, sizeof(torn));
+        flash_program(flash[f.page] + f.slot*CYMRIC_NVNONCE_RECBYTES, torn, sizeof(torn));
+    }
+    backend = cymric_nvnonce_flash_backend(&f);
+    failures += take(&backend, next, 1, seed);
+
+    // counter space exhausted
+    memset(flash, 0xff, sizeof(flash));
+    backend = cymric_nvnonce_flash_backend(&f);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), 1, 100) == 0);
+    for (i = 0; i < 256; i++)
+        CHECK(cymric_nvnonce_next(&s) != NULL);
+    CHECK(cymric_nvnonce_next(&s) == NULL);
+    return failures;
+}
+
+int test_nvnonce(void)
+{
+    cymric_nvnonce_flash_t f = {.pages = {flash[0], flash[1]}, .page_size = PAGE};
+    cymric_nvnonce_backend_t backend = cymric_nvnonce_flash_backend(&f);
+    cymric_nvnonce_t s;
+    uint64_t seed = 30;
+    int failures = 0;
+
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), 0, STEP) != 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), 9, STEP) != 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, sizeof(prefix), CTRLEN, 0) != 0);
+    CHECK(cymric_nvnonce_open(&s, &backend, prefix, BLOCKBYTES - CTRLEN, CTRLEN, STEP) != 0);
+    failures += check_file(&seed);
+    failures += check_flash(&seed);
+    return failures;
+}
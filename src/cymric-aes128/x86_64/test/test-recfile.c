@@ -0,0 +1,193 @@
+/**
+ * @file test-recfile.c
+ *
+ * @brief Random-access record files (cymric-recfile.h).
+ */
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "check.h"
+#include "../cymric-recfile.h"
+
+#define COUNT   100
+#define BLOCK   7       // records per block, the last block being partial
+
+/**
+ * @brief Length of record i of a variant, going through every valid length.
+ */
+static size_t record_len(int variant, uint64_t i)
+{
+    return i % (max_mlen(variant, CYMRIC_RF_NONCEBYTES) + 1);
+}
+
+static uint64_t load_le64(const uint8_t* p)
+{
+    uint64_t x = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+        x = (x << 8) | p[i];
+    return x;
+}
+
+static void store_le64(uint8_t* p, uint64_t x)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> (8*i));
+}
+
+/**
+ * @brief Flip a bit of a file at a given offset.
+ */
+static int flip(const char* path, off_t off)
+{
+    uint8_t x;
+    int fd = open(path, O_RDWR), ret = -1;
+
+    if (fd >= 0 && pread(fd, &x, 1, off) == 1) {
+        x ^= 0x01;
+        ret = (pwrite(fd, &x, 1, off) == 1) ? 0 : -1;
+    }
+    if (fd >= 0)
+        close(fd);
+    return ret;
+}
+
+/**
+ * @brief Write a record file, check its records against the reference
+ * functions and read them back one at a time and in batches.
+ */
+static int check_recfile(const char* path, int variant, const uint8_t k[],
+            const uint8_t id[], size_t idlen, uint64_t* seed)
+{
+    uint8_t m[COUNT][BLOCKBYTES], n[CYMRIC_RF_NONCEBYTES], x[BLOCKBYTES + TAGBYTES];
+    cymric_rf_writer_t w;
+    cymric_rf_reader_t r;
+    cymric_soa_t b;
+    size_t i, j, len, xlen, failed;
+    uint64_t pos = 0;
+    int failures = 0;
+
+    check_fill(&m[0][0], sizeof(m), seed);
+    CHECK(cymric_rf_create(&w, path, variant, id, idlen, BLOCK, k) == 0);
+    for (i = 0; i < COUNT; i++)
+        CHECK(cymric_rf_append(&w, m[i], record_len(variant, i)) == 0);
+    CHECK(cymric_rf_append(&w, m[0], max_mlen(variant, CYMRIC_RF_NONCEBYTES) + 1) == -1);
+    CHECK(cymric_rf_close(&w) == 0);
+
+    CHECK(cymric_rf_open(&r, path, k) == 0);
+    if (r.map == NULL)
+        return failures + 1;
+    CHECK(r.variant == variant && r.count == COUNT && r.idlen == idlen && memcmp(r.id, id, idlen) == 0);
+
+    // each record is C_i || T_i of the reference functions, with nonce i
+    for (i = 0; i < COUNT; i++) {
+        if (i % BLOCK == 0)
+            pos = load_le64(r.index + 8*(i/BLOCK)) + (COUNT - i < BLOCK ? COUNT - i : BLOCK);
+        len = record_len(variant, i);
+        for (j = 0; j < CYMRIC_RF_NONCEBYTES; j++)
+            n[j] = (uint8_t)(i >> (8*(CYMRIC_RF_NONCEBYTES - 1 - j)));
+        CHECK(ref_enc(variant, x, &xlen, k, n, sizeof(n), m[i], len, id, idlen) == 0);
+        CHECK(pos + xlen <= r.size && memcmp(r.map + pos, x, xlen) == 0);
+        pos += xlen;
+
+        CHECK(cymric_rf_get(&r, i, x, &xlen) == 0);
+        CHECK(xlen == len && memcmp(x, m[i], len) == 0);
+    }
+    CHECK(cymric_rf_get(&r, COUNT, x, &xlen) == -1);
+
+    CHECK(cymric_soa_alloc(&b, COUNT) == 0);
+    CHECK(cymric_rf_scan(&r, 3, COUNT - 3, &b, &failed) == 0);
+    CHECK(failed == 0);
+    for (i = 3; i < COUNT; i++) {
+        len = record_len(variant, i);
+        CHECK(cymric_soa_ok(&b, i - 3) && b.len[i - 3].mlen == len && memcmp(b.m[i - 3], m[i], len) == 0);
+    }
+    CHECK(cymric_rf_scan(&r, 1, COUNT, &b, &failed) == -1);
+    cymric_soa_free(&b);
+    cymric_rf_unmap(&r);
+    return failures;
+}
+
+int test_recfile(void)
+{
+    static const uint8_t zero[BLOCKBYTES];
+    char path[] = "/tmp/cymric-recfile-XXXXXX";
+    uint8_t k[2*KEYBYTES], k2[2*KEYBYTES], id[CYMRIC_RF_MAX_IDBYTES + 1], x[BLOCKBYTES];
+    cymric_rf_writer_t w;
+    cymric_rf_reader_t r;
+    cymric_soa_t b;
+    uint64_t seed = 43, off;
+    size_t idlen, xlen, failed;
+    int fd, variant, failures = 0;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+    check_fill(k, sizeof(k), &seed);
+    check_fill(k2, sizeof(k2), &seed);
+    check_fill(id, sizeof(id), &seed);
+
+    // invalid parameters
+    CHECK(cymric_rf_create(&w, path, 3, id, 0, BLOCK, k) == -1);
+    CHECK(cymric_rf_create(&w, path, 1, id, CYMRIC_RF_MAX_IDBYTES + 1, BLOCK, k) == -1);
+    CHECK(cymric_rf_create(&w, path, 1, id, 0, 0, k) == -1);
+    CHECK(cymric_rf_create(&w, path, 1, id, 0, CYMRIC_RF_MAX_BLOCK + 1, k) == -1);
+
+    for (variant = 1; variant <= 2; variant++)
+        for (idlen = 0; idlen <= CYMRIC_RF_MAX_IDBYTES; idlen++)
+            failures += check_recfile(path, variant, k, id, idlen, &seed);
+
+    // a wrong key or identifier does not authenticate the number of records
+    CHECK(cymric_rf_open(&r, path, k2) == 1);
+    CHECK(flip(path, 16) == 0);
+    CHECK(cymric_rf_open(&r, path, k) == 1);
+    CHECK(flip(path, 16) == 0);
+
+    // a tampered record is rejected and zeroed, the other ones are still read
+    CHECK(cymric_rf_open(&r, path, k) == 0);
+    off = load_le64(r.index + 8) + BLOCK;
+    cymric_rf_unmap(&r);
+    CHECK(flip(path, off) == 0);
+    CHECK(cymric_rf_open(&r, path, k) == 0);
+    memset(x, 0xff, sizeof(x));
+    CHECK(cymric_rf_get(&r, BLOCK, x, &xlen) == 1);
+    CHECK(memcmp(x, zero, record_len(2, BLOCK)) == 0);
+    CHECK(cymric_rf_get(&r, BLOCK + 1, x, &xlen) == 0);
+    CHECK(cymric_soa_alloc(&b, COUNT) == 0);
+    CHECK(cymric_rf_scan(&r, 0, COUNT, &b, &failed) == 1);
+    CHECK(failed == 1 && !cymric_soa_ok(&b, BLOCK) && b.len[BLOCK].mlen == 0);
+    cymric_soa_free(&b);
+    off = r.size;
+    cymric_rf_unmap(&r);
+
+    // a truncated file or a file whose last block is dropped is rejected
+    CHECK(truncate(path, off - 1) == 0);
+    CHECK(cymric_rf_open(&r, path, k) == -1);
+    CHECK(cymric_rf_create(&w, path, 2, id, 3, BLOCK, k) == 0);
+    for (off = 0; off < 2*BLOCK; off++)
+        CHECK(cymric_rf_append(&w, x, 5) == 0);
+    CHECK(cymric_rf_close(&w) == 0);
+    CHECK(cymric_rf_open(&r, path, k) == 0);
+    off = load_le64(r.index + 8);
+    cymric_rf_unmap(&r);
+    fd = open(path, O_RDWR);
+    if (fd >= 0) {
+        uint8_t le[3][8];
+
+        // block 1 replaced by an index of block 0 alone, with a header to match
+        store_le64(le[0], CYMRIC_RF_HEADERBYTES);
+        store_le64(le[1], off);
+        store_le64(le[2], 1);
+        CHECK(pwrite(fd, le, 16, off) == 16 && ftruncate(fd, off + 16) == 0);
+        CHECK(pwrite(fd, le[1], 8, 24) == 8 && pwrite(fd, le[2], 8, 32) == 8);
+        close(fd);
+    }
+    CHECK(cymric_rf_open(&r, path, k) == -1);
+
+    unlink(path);
+    return failures;
+}
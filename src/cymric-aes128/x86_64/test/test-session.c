@@ -0,0 +1,81 @@
+/**
+ * @file test-session.c
+ *
+ * @brief Counter-nonce sessions (cymric-session.h).
+ */
+#include <string.h>
+#include "check.h"
+#include "../cymric-session.h"
+
+typedef int (*session_fn_t)(cymric_session_t*, uint8_t*, size_t*, const uint8_t*, size_t);
+
+int test_session(void)
+{
+    session_fn_t enc[2] = {cymric1_session_enc, cymric2_session_enc};
+    session_fn_t dec[2] = {cymric1_session_dec, cymric2_session_dec};
+    uint8_t k[2*KEYBYTES], n[BLOCKBYTES], a[BLOCKBYTES], m[BLOCKBYTES];
+    uint8_t nonce[BLOCKBYTES], c[BLOCKBYTES + TAGBYTES], r[BLOCKBYTES + TAGBYTES];
+    uint8_t p[BLOCKBYTES];
+    aes_roundkeys_t rk_tx, rk_rx;
+    cipher_ctx_t tx_ctx = aes_get_cipher_ctx(), rx_ctx = aes_get_cipher_ctx();
+    cymric_session_t tx, rx;
+    uint64_t seed = 28;
+    size_t nlen, alen, mlen, clen, rlen, plen;
+    int v, failures = 0;
+
+    tx_ctx.roundkeys = &rk_tx;
+    rx_ctx.roundkeys = &rk_rx;
+    check_fill(k, sizeof(k), &seed);
+    for (v = 1; v <= 2; v++) {
+        for (nlen = 1; nlen < BLOCKBYTES; nlen++) {
+            for (alen = 0; nlen + alen < BLOCKBYTES; alen++) {
+                size_t ctr_len = (nlen < 4) ? nlen : 4;
+
+                // random prefix, counter starting from 0 (at most 17 messages)
+                check_fill(n, sizeof(n), &seed);
+                check_fill(a, sizeof(a), &seed);
+                memset(n + nlen - ctr_len, 0x00, ctr_len);
+                CHECK(cymric_session_init(&tx, k, n, nlen, nlen - ctr_len, ctr_len, a, alen, &tx_ctx) == 0);
+                CHECK(cymric_session_init(&rx, k, n, nlen, nlen - ctr_len, ctr_len, a, alen, &rx_ctx) == 0);
+                for (mlen = 0; mlen <= max_mlen(v, nlen); mlen++) {
+                    check_fill(m, mlen, &seed);
+                    memcpy(nonce, cymric_session_nonce(&tx), nlen);
+
+                    // same as the reference under the current nonce
+                    CHECK(enc[v - 1](&tx, c, &clen, m, mlen) == 0);
+                    CHECK(ref_enc(v, r, &rlen, k, nonce, nlen, m, mlen, a, alen) == 0);
+                    CHECK(clen == rlen && memcmp(c, r, clen) == 0);
+                    CHECK(memcmp(cymric_session_nonce(&tx), nonce, nlen) != 0);
+
+                    // a tampered tag is rejected without advancing the counter
+                    c[clen - 1] ^= 0x01;
+                    memset(p, 0xff, sizeof(p));
+                    CHECK(dec[v - 1](&rx, p, &plen, c, clen) == 1);
+                    CHECK(plen == 0 && (mlen == 0 || p[0] == 0x00));
+                    CHECK(memcmp(cymric_session_nonce(&rx), nonce, nlen) == 0);
+                    c[clen - 1] ^= 0x01;
+
+                    CHECK(dec[v - 1](&rx, p, &plen, c, clen) == 0);
+                    CHECK(plen == mlen && memcmp(p, m, mlen) == 0);
+                    CHECK(memcmp(cymric_session_nonce(&rx), cymric_session_nonce(&tx), nlen) == 0);
+                }
+                // too long messages and ciphertexts shorter than the tag
+                CHECK(enc[v - 1](&tx, c, &clen, m, max_mlen(v, nlen) + 1) == -1);
+                CHECK(dec[v - 1](&rx, p, &plen, c, TAGBYTES - 1) == -1);
+            }
+        }
+    }
+
+    // invalid parameters
+    CHECK(cymric_session_init(&tx, k, n, 12, 0, 0, a, 3, &tx_ctx) == -1);
+    CHECK(cymric_session_init(&tx, k, n, 12, 10, 4, a, 3, &tx_ctx) == -1);
+    CHECK(cymric_session_init(&tx, k, n, 12, 8, 4, a, 4, &tx_ctx) == -1);
+
+    // the session refuses any message once the counter wrapped around
+    memset(n, 0xff, sizeof(n));
+    CHECK(cymric_session_init(&tx, k, n, 12, 11, 1, a, 3, &tx_ctx) == 0);
+    CHECK(cymric1_session_enc(&tx, c, &clen, m, 4) == 0);
+    CHECK(cymric1_session_enc(&tx, c, &clen, m, 4) == -1);
+    CHECK(cymric2_session_enc(&tx, c, &clen, m, 4) == -1);
+    return failures;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file test-stream.c
+ *
+ * @brief Software-pipelined streaming engine (cymric-stream.h).
+ */
+#include <string.h>
+#include <stdint.h>
+#include "check.h"
+#include "../cymric-stream.h"
+
+#define CAPACITY    8
+#define PENDING     64      // expected results kept, indexed by push number
+
+typedef struct {
+    int ret;
+    size_t outlen;
+    uint8_t out[BLOCKBYTES + TAGBYTES];
+} expect_t;
+
+static expect_t expect[PENDING];
+
+/**
+ * @brief Check the popped results against the expected ones, in push order.
+ */
+static int drain(cymric_stream_t* s, size_t* popped)
+{
+    const cymric_stream_slot_t* slot;
+    int failures = 0;
+
+    while ((slot = cymric_stream_pop(s)) != NULL) {
+        const expect_t* e = &expect[*popped % PENDING];
+
+        CHECK((uintptr_t)slot->user == *popped);
+        CHECK(slot->ret == e->ret && slot->outlen == e->outlen);
+        CHECK(memcmp(slot->out, e->out, e->outlen) == 0);
+        (*popped)++;
+    }
+    return failures;
+}
+
+int test_stream(void)
+{
+    static cymric_stream_slot_t ring[CAPACITY];
+    uint8_t k[2*KEYBYTES], n[BLOCKBYTES], a[BLOCKBYTES], m[BLOCKBYTES];
+    uint8_t c[BLOCKBYTES + TAGBYTES];
+    cymric_stream_t s;
+    uint64_t seed = 31;
+    size_t nlen, alen, mlen, clen, pushed = 0, popped = 0;
+    int v, failures = 0;
+    unsigned int i;
+
+    check_fill(k, sizeof(k), &seed);
+    CHECK(cymric_stream_init(&s, k, ring, 6) == -1);
+    CHECK(cymric_stream_init(&s, k, ring, CAPACITY) == 0);
+
+    for (v = 1; v <= 2; v++) {
+        for (nlen = 0; nlen < BLOCKBYTES; nlen++) {
+            for (alen = 0; nlen + alen < BLOCKBYTES; alen++) {
+                for (mlen = 0; mlen <= max_mlen(v, nlen); mlen++) {
+                    expect_t* e;
+
+                    check_fill(n, nlen, &seed);
+                    check_fill(a, alen, &seed);
+                    check_fill(m, mlen, &seed);
+
+                    // encryption, same as the reference
+                    e = &expect[pushed % PENDING];
+                    e->ret = ref_enc(v, e->out, &e->outlen, k, n, nlen, m, mlen, a, alen);
+                    memcpy(c, e->out, e->outlen);
+                    clen = e->outlen;
+                    CHECK(cymric_stream_push(&s, v, CYMRIC_STREAM_ENC, n, nlen, m, mlen,
+                            a, alen, (void*)(uintptr_t)pushed++) == 0);
+                    failures += drain(&s, &popped);
+
+                    // decryption, with a tampered tag every other message
+                    e = &expect[pushed % PENDING];
+                    if (mlen & 1)
+                        c[clen - 1 - (mlen % TAGBYTES)] ^= 0x04;
+                    e->ret = ref_dec(v, e->out, &e->outlen, k, n, nlen, c, clen, a, alen);
+                    CHECK(e->ret == (int)(mlen & 1));
+                    CHECK(cymric_stream_push(&s, v, CYMRIC_STREAM_DEC, n, nlen, c, clen,
+                            a, alen, (void*)(uintptr_t)pushed++) == 0);
+                    failures += drain(&s, &popped);
+                }
+            }
+        }
+        cymric_stream_flush(&s);
+        failures += drain(&s, &popped);
+        CHECK(popped == pushed);
+    }
+
+    // invalid inputs complete in order, with ret -1
+    for (i = 0; i < 3; i++) {
+        expect_t* e = &expect[(pushed + i) % PENDING];
+
+        e->ret = -1;
+        e->outlen = 0;
+    }
+    CHECK(cymric_stream_push(&s, 1, CYMRIC_STREAM_DEC, n, 12, c, TAGBYTES - 1, a, 3,
+            (void*)(uintptr_t)pushed++) == 0);
+    CHECK(cymric_stream_push(&s, 1, CYMRIC_STREAM_ENC, n, 12, m, 5, a, 3,
+            (void*)(uintptr_t)pushed++) == 0);
+    CHECK(cymric_stream_push(&s, 3, CYMRIC_STREAM_ENC, n, 12, m, 4, a, 3,
+            (void*)(uintptr_t)pushed++) == 0);
+    failures += drain(&s, &popped);
+    CHECK(popped == pushed);
+
+    // a full ring refuses further messages until popped
+    for (i = 0; i < CAPACITY; i++) {
+        expect_t* e = &expect[pushed % PENDING];
+
+        e->ret = ref_enc(1, e->out, &e->outlen, k, n, 12, m, 4, a, 3);
+        CHECK(cymric_stream_push(&s, 1, CYMRIC_STREAM_ENC, n, 12, m, 4, a, 3,
+                (void*)(uintptr_t)pushed++) == 0);
+    }
+    CHECK(cymric_stream_push(&s, 1, CYMRIC_STREAM_ENC, n, 12, m, 4, a, 3, NULL) == -1);
+    cymric_stream_flush(&s);
+    failures += drain(&s, &popped);
+    CHECK(popped == pushed);
+    return failures;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file archive.c
+ *
+ * @brief Command-line tool sealing, opening and rekeying archives of
+ * fixed-width records (see cymric-archive.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../cymric-archive.h"
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s seal|open|rekey -w width -k keyfile [-K newkeyfile] [-1|-2]\n"
+        "          [-i hexid] [-f first] [-t threads] input output\n"
+        "  -w  record width in bytes (1..8 with -1, 1..16 with -2)\n"
+        "  -k  file holding K||K' (32 bytes)\n"
+        "  -K  file holding the new K||K' (rekey only)\n"
+        "  -1  Cymric1 (default), -2 Cymric2\n"
+        "  -i  archive identifier in hexadecimal (AD of every record, up to %d bytes)\n"
+        "  -f  index of the first record (default 0)\n"
+        "  -t  number of threads (default: number of online processors)\n",
+        prog, CYMRIC_ARCHIVE_MAX_IDBYTES);
+}
+
+static int read_key(cymric_batch_key_t* key, const char* path)
+{
+    uint8_t k[2*KEYBYTES];
+    FILE* f = fopen(path, "rb");
+    size_t len;
+
+    if (f == NULL)
+        return -1;
+    len = fread(k, 1, sizeof(k), f);
+    fclose(f);
+    if (len != sizeof(k))
+        return -1;
+    cymric_batch_key_init(key, k);
+    memset(k, 0x00, sizeof(k));
+    return 0;
+}
+
+static int parse_hex(uint8_t* out, size_t* outlen, size_t max, const char* hex)
+{
+    size_t len = strlen(hex), i;
+
+    if (len % 2 != 0 || len/2 > max)
+        return -1;
+    for (i = 0; i < len/2; i++)
+        if (sscanf(hex + 2*i, "%2hhx", &out[i]) != 1)
+            return -1;
+    *outlen = len/2;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    cymric_archive_params_t p = {.variant = 1};
+    cymric_archive_stats_t st;
+    cymric_batch_key_t key, newkey;
+    const char *keyfile = NULL, *newkeyfile = NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int op, opt, ret;
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (strcmp(argv[1], "seal") == 0)
+        op = CYMRIC_ARCHIVE_SEAL;
+    else if (strcmp(argv[1], "open") == 0)
+        op = CYMRIC_ARCHIVE_OPEN;
+    else if (strcmp(argv[1], "rekey") == 0)
+        op = CYMRIC_ARCHIVE_REKEY;
+    else {
+        usage(argv[0]);
+        return 2;
+    }
+
+    p.threads = (cpus < 1) ? 1 : (cpus > CYMRIC_ARCHIVE_MAX_THREADS) ? CYMRIC_ARCHIVE_MAX_THREADS : cpus;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "w:k:K:12i:f:t:")) != -1) {
+        switch (opt) {
+        case 'w': p.width = strtoul(optarg, NULL, 0); break;
+        case 'k': keyfile = optarg; break;
+        case 'K': newkeyfile = optarg; break;
+        case '1': p.variant = 1; break;
+        case '2': p.variant = 2; break;
+        case 'f': p.first = strtoull(optarg, NULL, 0); break;
+        case 't': p.threads = strtoul(optarg, NULL, 0); break;
+        case 'i':
+            if (parse_hex(p.id, &p.idlen, CYMRIC_ARCHIVE_MAX_IDBYTES, optarg) != 0) {
+                fprintf(stderr, "invalid archive identifier\n");
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc - optind != 2 || keyfile == NULL || (op == CYMRIC_ARCHIVE_REKEY) != (newkeyfile != NULL)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (cymric_archive_check(&p) != 0) {
+        fprintf(stderr, "invalid parameters\n");
+        return 2;
+    }
+    if (read_key(&key, keyfile) != 0 || (newkeyfile != NULL && read_key(&newkey, newkeyfile) != 0)) {
+        fprintf(stderr, "cannot read a %d-byte key\n", 2*KEYBYTES);
+        return 2;
+    }
+
+    ret = cymric_archive_file(op, argv[optind + 1], argv[optind], &p, &key,
+              newkeyfile != NULL ? &newkey : NULL, &st);
+    if (ret < 0) {
+        fprintf(stderr, "cannot process %s into %s (size not a multiple of the record size, "
+                "output being the input?)\n", argv[optind], argv[optind + 1]);
+        return 2;
+    }
+    printf("%zu records, %zu failed, %.3f s, %.2f GB/s\n", st.records, st.failed,
+        st.seconds, st.seconds > 0 ? st.bytes/st.seconds*1e-9 : 0.0);
+    return ret;
+}
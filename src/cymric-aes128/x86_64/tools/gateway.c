@@ -0,0 +1,329 @@
+/**
+ * @file gateway.c
+ *
+ * @brief Loopback benchmark of the gateway backends (see cymric-gateway.h): a
+ * generator thread sends sealed frames to the gateway, which decrypts and
+ * forwards them to a sink thread checking them against what was sealed and
+ * measuring the throughput and the latency from generation to reception.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "../cymric-gateway.h"
+
+#define BURST   64
+
+typedef struct {
+    int variant;
+    size_t frames;
+    unsigned int rate;          // frames per second, 0 for unpaced
+    cymric_batch_key_t key;
+    int gen;                    // generator socket, connected to the gateway
+    int sink;                   // sink socket, bound
+    uint64_t* sent;             // generation time of each frame (ns)
+    uint64_t* lat;              // latency of each frame received by the sink (ns)
+    volatile size_t received;
+    volatile size_t bad;        // frames received other than they were sealed
+    double first, last;         // reception time of the first and last frames
+    volatile int done;
+} bench_t;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+static int udp_socket(uint16_t* port)
+{
+    struct sockaddr_in sa = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(sa);
+    int size = 16 << 20;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 ||
+        getsockname(fd, (struct sockaddr*)&sa, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(sa.sin_port);
+    return fd;
+}
+
+static int udp_connect(int fd, uint16_t port)
+{
+    struct sockaddr_in sa = {.sin_family = AF_INET, .sin_port = htons(port),
+                             .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+
+    return connect(fd, (struct sockaddr*)&sa, sizeof(sa));
+}
+
+/**
+ * @brief Seal frame i: 8-byte nonce holding i, 4-byte AD, and the generation
+ * time as an 8-byte message.
+ */
+static void seal_frame(uint8_t f[CYMRIC_GW_FRAMEBYTES], cymric_soa_t* b, size_t j,
+            uint64_t i, uint64_t t)
+{
+    size_t k;
+
+    memset(f, 0x00, CYMRIC_GW_FRAMEBYTES);
+    b->len[j] = (cymric_len_t){8, 4, 8, 0};
+    memset(b->n[j], 0x00, BLOCKBYTES);
+    memset(b->a[j], 0x00, BLOCKBYTES);
+    memset(b->m[j], 0x00, BLOCKBYTES);
+    for (k = 0; k < 8; k++)
+        b->n[j][k] = (uint8_t)(i >> (56 - 8*k));
+    memcpy(b->a[j], "node", 4);
+    memcpy(b->m[j], &t, 8);
+}
+
+/**
+ * @brief Frame i as forwarded by the gateway, the message of seal_frame in
+ * place of its ciphertext.
+ */
+static void plain_frame(uint8_t f[CYMRIC_GW_FWDBYTES], uint64_t i, uint64_t t)
+{
+    static const cymric_len_t len = {8, 4, 8, 0};
+    size_t k;
+
+    memset(f, 0x00, CYMRIC_GW_FWDBYTES);
+    memcpy(f, &len, sizeof(len));
+    for (k = 0; k < 8; k++)
+        f[16 + k] = (uint8_t)(i >> (56 - 8*k));
+    memcpy(f + 32, "node", 4);
+    memcpy(f + 48, &t, 8);
+}
+
+static void* generator(void* arg)
+{
+    bench_t* s = arg;
+    uint8_t frames[BURST][CYMRIC_GW_FRAMEBYTES];
+    struct mmsghdr msg[BURST];
+    struct iovec iov[BURST];
+    cymric_soa_t b;
+    size_t i = 0, j;
+    double t0 = now();
+
+    if (cymric_soa_alloc(&b, BURST) != 0)
+        return NULL;
+    while (i < s->frames) {
+        size_t cnt = (s->frames - i < BURST) ? s->frames - i : BURST;
+        uint64_t t = now_ns();
+
+        if (s->rate > 0) {
+            // pace the bursts, sleeping so as to leave the cpu to the gateway
+            double ahead = t0 + (double)i/s->rate - now();
+
+            if (ahead > 0) {
+                struct timespec ts = {(time_t)ahead, (long)((ahead - (time_t)ahead)*1e9)};
+
+                nanosleep(&ts, NULL);
+            }
+            t = now_ns();
+        }
+        b.count = cnt;
+        for (j = 0; j < cnt; j++) {
+            seal_frame(frames[j], &b, j, i + j, t);
+            __atomic_store_n(&s->sent[i + j], t, __ATOMIC_RELEASE);
+        }
+        if (s->variant == 1)
+            cymric1_batch_enc(&b, &s->key);
+        else
+            cymric2_batch_enc(&b, &s->key);
+        for (j = 0; j < cnt; j++) {
+            memcpy(frames[j], &b.len[j], sizeof(cymric_len_t));
+            memcpy(frames[j] + 16, b.n[j], BLOCKBYTES);
+            memcpy(frames[j] + 32, b.a[j], BLOCKBYTES);
+            memcpy(frames[j] + 48, b.c[j], BLOCKBYTES);
+            memcpy(frames[j] + 64, b.t[j], TAGBYTES);
+            iov[j] = (struct iovec){frames[j], CYMRIC_GW_FRAMEBYTES};
+            msg[j].msg_hdr = (struct msghdr){.msg_iov = &iov[j], .msg_iovlen = 1};
+        }
+        for (j = 0; j < cnt; ) {
+            int sent = sendmmsg(s->gen, msg + j, cnt - j, 0);
+
+            if (sent <= 0)
+                break;
+            j += sent;
+        }
+        i += cnt;
+    }
+    cymric_soa_free(&b);
+    return NULL;
+}
+
+static void* sink(void* arg)
+{
+    bench_t* s = arg;
+    uint8_t frames[BURST][CYMRIC_GW_BUFBYTES], expected[CYMRIC_GW_FWDBYTES];
+    struct mmsghdr msg[BURST];
+    struct iovec iov[BURST];
+    struct timeval tv = {0, 200000};
+    int i, n;
+    size_t k;
+
+    setsockopt(s->sink, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (!s->done && s->received + s->bad < s->frames) {
+        for (i = 0; i < BURST; i++) {
+            iov[i] = (struct iovec){frames[i], CYMRIC_GW_BUFBYTES};
+            msg[i].msg_hdr = (struct msghdr){.msg_iov = &iov[i], .msg_iovlen = 1};
+        }
+        n = recvmmsg(s->sink, msg, BURST, MSG_WAITFORONE, NULL);
+        if (n <= 0)
+            continue;
+        for (i = 0; i < n && s->received < s->frames; i++) {
+            uint64_t id = 0, t = 0;
+
+            // N holds the frame index, and the plaintext (generation time)
+            // sits in the C slot: both must be those of a sealed frame
+            for (k = 0; k < 8; k++)
+                id = (id << 8) | frames[i][16 + k];
+            if (id < s->frames)
+                t = __atomic_load_n(&s->sent[id], __ATOMIC_ACQUIRE);
+            plain_frame(expected, id, t);
+            if (msg[i].msg_len != CYMRIC_GW_FWDBYTES || t == 0 ||
+                memcmp(frames[i], expected, CYMRIC_GW_FWDBYTES) != 0) {
+                s->bad++;
+                continue;
+            }
+            s->lat[s->received++] = now_ns() - t;
+        }
+        if (s->first == 0)
+            s->first = now();
+        s->last = now();
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void* x, const void* y)
+{
+    uint64_t a = *(const uint64_t*)x, b = *(const uint64_t*)y;
+
+    return (a > b) - (a < b);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [-b mmsg|uring] [-n frames] [-B batch] [-r rate] [-2] [-R]\n"
+        "  -b  gateway backend (default uring)\n"
+        "  -n  number of frames (default 1000000)\n"
+        "  -B  maximum number of frames per batch (default 64, at most %d)\n"
+        "  -r  frames per second sent by the generator (default 0: unpaced)\n"
+        "  -2  Cymric2 (default Cymric1)\n"
+        "  -R  check the frames against an anti-replay filter\n",
+        prog, CYMRIC_GW_MAX_BATCH);
+}
+
+int main(int argc, char* argv[])
+{
+    static bench_t s;
+    static cymric_replay_t filter;
+    cymric_gw_config_t cfg = {.backend = CYMRIC_GW_URING, .variant = 1, .batch = 64, .buffers = 4096};
+    cymric_gw_t gw;
+    pthread_t gen_tid, sink_tid;
+    uint8_t k[2*KEYBYTES];
+    uint16_t gw_port, tx_port, sink_port, gen_port;
+    int opt, idle = 0, ret = 0;
+    size_t i;
+    double elapsed;
+
+    s.variant = 1;
+    s.frames  = 1000000;
+    while ((opt = getopt(argc, argv, "b:n:B:r:2R")) != -1) {
+        switch (opt) {
+        case 'b': cfg.backend = strcmp(optarg, "mmsg") ? CYMRIC_GW_URING : CYMRIC_GW_RECVMMSG; break;
+        case 'n': s.frames = strtoull(optarg, NULL, 0); break;
+        case 'B': cfg.batch = strtoul(optarg, NULL, 0); break;
+        case 'r': s.rate = strtoul(optarg, NULL, 0); break;
+        case '2': s.variant = cfg.variant = 2; break;
+        case 'R': cfg.filter = &filter; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(k); i++)
+        k[i] = (uint8_t)(7*i + 1);
+    cymric_batch_key_init(&s.key, k);
+    cymric_replay_init(&filter, 8);
+    cfg.key = &s.key;
+    s.sent = calloc(s.frames, sizeof(uint64_t));
+    s.lat  = malloc(s.frames*sizeof(uint64_t));
+
+    // generator -> gateway rx -> gateway tx -> sink
+    cfg.rx = udp_socket(&gw_port);
+    cfg.tx = udp_socket(&tx_port);
+    s.sink = udp_socket(&sink_port);
+    s.gen  = udp_socket(&gen_port);
+    if (s.sent == NULL || s.lat == NULL || cfg.rx < 0 || cfg.tx < 0 || s.sink < 0 || s.gen < 0 ||
+        udp_connect(cfg.tx, sink_port) != 0 || udp_connect(s.gen, gw_port) != 0) {
+        fprintf(stderr, "cannot set up the loopback sockets\n");
+        return 1;
+    }
+    if (cymric_gw_init(&gw, &cfg) != 0) {
+        fprintf(stderr, "cannot initialize the %s backend\n",
+            cfg.backend == CYMRIC_GW_URING ? "io_uring" : "recvmmsg");
+        return 1;
+    }
+
+    pthread_create(&sink_tid, NULL, sink, &s);
+    pthread_create(&gen_tid, NULL, generator, &s);
+    // run until the sink got every frame or nothing arrived for 0.5 s
+    while (s.received + s.bad < s.frames && idle < 5) {
+        int n = cymric_gw_poll(&gw, 100);
+
+        if (n < 0) {
+            ret = 1;
+            break;
+        }
+        idle = (n == 0) ? idle + 1 : 0;
+    }
+    s.done = 1;
+    pthread_join(gen_tid, NULL);
+    pthread_join(sink_tid, NULL);
+
+    elapsed = s.last - s.first;
+    qsort(s.lat, s.received, sizeof(uint64_t), cmp_u64);
+    printf("%-8s cymric%d batch=%-3u rate=%-8u received=%zu/%zu  %.3f Mframe/s  ",
+        cfg.backend == CYMRIC_GW_URING ? "io_uring" : "recvmmsg", cfg.variant, cfg.batch,
+        s.rate, s.received, s.frames, elapsed > 0 ? s.received/elapsed*1e-6 : 0.0);
+    if (s.received > 0)
+        printf("p50=%.1f p99=%.1f us  ", s.lat[s.received/2]*1e-3, s.lat[s.received*99/100]*1e-3);
+    printf("syscalls/frame=%.3f frames/batch=%.1f dropped=%llu\n",
+        gw.stats.received ? (double)gw.stats.syscalls/gw.stats.received : 0.0,
+        gw.stats.batches ? (double)gw.stats.received/gw.stats.batches : 0.0,
+        (unsigned long long)gw.stats.dropped);
+    if (s.bad > 0) {
+        fprintf(stderr, "%zu frames forwarded other than they were sealed\n", s.bad);
+        ret = 1;
+    }
+
+    cymric_gw_close(&gw);
+    free(s.sent);
+    free(s.lat);
+    return ret;
+}
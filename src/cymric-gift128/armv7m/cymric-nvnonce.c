@@ -0,0 +1 @@
+../../cymric/cymric-nvnonce.c
\ No newline at end of file
@@ -1,9 +1,22 @@
 #include "gift128.h"
 
+// define GIFT128_FAST to select the speed-optimized implementation
+// define GIFT128_FLASH_RKEYS if the round keys of K||K' are provisioned in flash
 cipher_ctx_t gift128_get_cipher_ctx(void) {
     cipher_ctx_t ctx = {
+#if defined(GIFT128_FAST)
+        .encrypt = giftb128_encrypt_fast,
+        .encrypt_x2 = giftb128_encrypt_fast_x2,
+#else
         .encrypt = giftb128_encrypt,
+#endif
+#if defined(GIFT128_FLASH_RKEYS)
+        .kexpand = NULL,    // round keys read from flash (.rodata) as is
+#elif defined(GIFT128_FAST)
+        .kexpand = gift128_keyschedule_fast,
+#else
         .kexpand = gift128_keyschedule,
+#endif
         .rkeys_size = sizeof(gift128_roundkeys_t),
     };
     return ctx;
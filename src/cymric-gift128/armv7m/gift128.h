@@ -11,4 +11,12 @@ void gift128_keyschedule(void* rkeys, const uint8_t* key);
 
 void giftb128_encrypt(uint8_t* ctext, const uint8_t* ptext, const void* rkeys);
 
+// fully unrolled variants (see gift128_fast.s), same round key layout
+void gift128_keyschedule_fast(void* rkeys, const uint8_t* key);
+
+void giftb128_encrypt_fast(uint8_t* ctext, const uint8_t* ptext, const void* rkeys);
+
+void giftb128_encrypt_fast_x2(uint8_t* ctext0, uint8_t* ctext1,
+                const uint8_t* ptext0, const uint8_t* ptext1, const void* rkeys);
+
 #endif  // GIFT128_H_
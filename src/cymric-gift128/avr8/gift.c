@@ -1,13 +1,29 @@
 #include "gift128.h"
 
 cipher_ctx_t gift128_get_cipher_ctx(void) {
+#if defined(GIFT128_OTF)
+	cipher_ctx_t ctx = {
+		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))gift128_encrypt_otf,
+		.kexpand = NULL,	// key is expanded on-the-fly => no kexpand func
+		.rkeys_size = 16,	// key is expanded on-the-fly => rkeys = key
+	};
+#elif defined(GIFT128_FLASH_RKEYS)
+	cipher_ctx_t ctx = {
+		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))gift128_encrypt_P,
+		.kexpand = NULL,	// round keys of K||K' provisioned in program memory
+		.rkeys_size = sizeof(gift128_roundkeys_t),
+	};
+#else
 	cipher_ctx_t ctx = {
 		.encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))gift128_encrypt,
 		.kexpand = (void (*)(void *, const uint8_t *))gift128_kexpand,
 		.rkeys_size = sizeof(gift128_roundkeys_t),
 	};
+#endif
 	return ctx;
 }
 
 extern void gift128_kexpand(unsigned char* rkeys, const unsigned char* key);
 extern void gift128_encrypt(unsigned char* out_block, const unsigned char* in_block, const unsigned char* rkeys);
+extern void gift128_encrypt_otf(unsigned char* out_block, const unsigned char* in_block, const unsigned char* key);
+extern void gift128_encrypt_P(unsigned char* out_block, const unsigned char* in_block, const unsigned char* rkeys);
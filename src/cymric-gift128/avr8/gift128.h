@@ -13,5 +13,7 @@ cipher_ctx_t gift128_get_cipher_ctx(void);
 
 void gift128_kexpand(unsigned char* rkeys, const unsigned char* key);
 void gift128_encrypt(unsigned char* out_block, const unsigned char* in_block, const unsigned char* rkeys);
+void gift128_encrypt_otf(unsigned char* out_block, const unsigned char* in_block, const unsigned char* key);
+void gift128_encrypt_P(unsigned char* out_block, const unsigned char* in_block, const unsigned char* rkeys);
 
 #endif  // GIFT128_H_
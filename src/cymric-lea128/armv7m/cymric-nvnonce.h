@@ -0,0 +1 @@
+../../cymric/cymric-nvnonce.h
\ No newline at end of file
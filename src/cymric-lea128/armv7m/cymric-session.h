@@ -0,0 +1 @@
+../../cymric/cymric-session.h
\ No newline at end of file
@@ -7,4 +7,7 @@ cipher_ctx_t lea128_get_cipher_ctx(void);
 
 void lea128_encrypt(uint8_t* ctext, const uint8_t* ptext, const void* key);
 
+void lea128_encrypt_x2(uint8_t* ctext0, uint8_t* ctext1,
+        const uint8_t* ptext0, const uint8_t* ptext1, const void* key);
+
 #endif 	// LEA128_H_
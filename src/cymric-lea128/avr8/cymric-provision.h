@@ -0,0 +1 @@
+../../cymric/cymric-provision.h
\ No newline at end of file
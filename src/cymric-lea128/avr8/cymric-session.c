@@ -0,0 +1 @@
+../../cymric/cymric-session.c
\ No newline at end of file
@@ -1,13 +1,29 @@
 #include "lea128.h"
 
 cipher_ctx_t lea128_get_cipher_ctx(void) {
+#if defined(LEA128_OTF)
+    cipher_ctx_t ctx = {
+        .encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))lea128_encrypt_otf,
+        .kexpand = NULL,    // key is expanded on-the-fly => no kexpand func
+        .rkeys_size = 16,   // key is expanded on-the-fly => rkeys = key
+    };
+#elif defined(LEA128_FLASH_RKEYS)
+    cipher_ctx_t ctx = {
+        .encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))lea128_encrypt_P,
+        .kexpand = NULL,    // round keys of K||K' provisioned in program memory
+        .rkeys_size = sizeof(lea128_roundkeys_t),
+    };
+#else
     cipher_ctx_t ctx = {
         .encrypt = (void (*)(uint8_t*, const uint8_t*, const void*))lea128_encrypt,
         .kexpand = (void (*)(void *, const uint8_t *))lea128_kexpand,
         .rkeys_size = sizeof(lea128_roundkeys_t),
     };
+#endif
     return ctx;
 }
 
 extern void lea128_kexpand(uint8_t* round_keys, const uint8_t* key);
 extern void lea128_encrypt(uint8_t* out, const uint8_t* in, const uint8_t* round_keys);
+extern void lea128_encrypt_otf(uint8_t* out, const uint8_t* in, const uint8_t* key);
+extern void lea128_encrypt_P(uint8_t* out, const uint8_t* in, const uint8_t* round_keys);
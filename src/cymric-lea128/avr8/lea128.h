@@ -9,5 +9,7 @@ cipher_ctx_t lea128_get_cipher_ctx(void);
 
 void lea128_kexpand(uint8_t* round_keys, const uint8_t* key);
 void lea128_encrypt(uint8_t* out, const uint8_t* in, const uint8_t* round_keys);
+void lea128_encrypt_otf(uint8_t* out, const uint8_t* in, const uint8_t* key);
+void lea128_encrypt_P(uint8_t* out, const uint8_t* in, const uint8_t* round_keys);
 
 #endif /* LEA128_H_ */
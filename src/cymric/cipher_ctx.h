@@ -7,6 +7,7 @@
 typedef struct {
     void* roundkeys;
     void (*encrypt)(uint8_t*, const uint8_t*, const void*);
+    void (*encrypt_x2)(uint8_t*, uint8_t*, const uint8_t*, const uint8_t*, const void*);  // Can be NULL if not provided
     void (*kexpand)(void*, const uint8_t*);  // Can be NULL for precomputed keys
     size_t rkeys_size;
 } cipher_ctx_t;
@@ -1,6 +1,150 @@
 #ifndef CYMRIC_COMMON_H
 #define CYMRIC_COMMON_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Blocks are built and combined in 64-bit words on little-endian targets,
+ * where partial N, A and M are loaded and stored with at most one load/store
+ * per power of two of their length. AVR sticks to byte-wise loops, which are
+ * cheaper than 64-bit arithmetic on an 8-bit core.
+ */
+#if !defined(__AVR__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CYMRIC_WORDS
+#endif
+
+#if defined(CYMRIC_WORDS)
+/**
+ * @brief Load len bytes (len <= 8) as a little-endian word, upper bytes being
+ * zero, without reading beyond p + len.
+ */
+static inline uint64_t load_partial(const uint8_t* p, size_t len)
+{
+    uint64_t w = 0;
+    uint32_t w32;
+    uint16_t w16;
+    size_t i = 0;
+
+    if (len == 8) {
+        memcpy(&w, p, 8);
+        return w;
+    }
+    if (len & 4) {
+        memcpy(&w32, p, 4);
+        w = w32;
+        i = 4;
+    }
+    if (len & 2) {
+        memcpy(&w16, p + i, 2);
+        w |= (uint64_t)w16 << (8*i);
+        i += 2;
+    }
+    if (len & 1)
+        w |= (uint64_t)p[i] << (8*i);
+    return w;
+}
+
+/**
+ * @brief Store the len lower bytes (len <= 8) of a little-endian word without
+ * writing beyond p + len.
+ */
+static inline void store_partial(uint8_t* p, uint64_t w, size_t len)
+{
+    uint32_t w32;
+    uint16_t w16;
+    size_t i = 0;
+
+    if (len == 8) {
+        memcpy(p, &w, 8);
+        return;
+    }
+    if (len & 4) {
+        w32 = (uint32_t)w;
+        memcpy(p, &w32, 4);
+        i = 4;
+    }
+    if (len & 2) {
+        w16 = (uint16_t)(w >> (8*i));
+        memcpy(p + i, &w16, 2);
+        i += 2;
+    }
+    if (len & 1)
+        p[i] = (uint8_t)(w >> (8*i));
+}
+
+/**
+ * @brief Load len bytes (len <= 16) to the two words of a block, remaining
+ * bytes being zero.
+ */
+static inline void load_block(uint64_t w[2], const uint8_t* p, size_t len)
+{
+    if (len >= 8) {
+        w[0] = load_partial(p, 8);
+        w[1] = load_partial(p + 8, len - 8);
+    }
+    else {
+        w[0] = load_partial(p, len);
+        w[1] = 0;
+    }
+}
+#endif
+
+/**
+ * @brief Build the block x||y||0* where xlen + ylen <= 16.
+ *
+ * @param out The output block
+ * @param x The first byte array
+ * @param xlen The length of x
+ * @param y The second byte array
+ * @param ylen The length of y
+ */
+static inline void concat_block(uint8_t out[16],
+    const uint8_t*  x, size_t xlen,
+    const uint8_t*  y, size_t ylen)
+{
+#if defined(CYMRIC_WORDS)
+    uint64_t w[2], v[2];
+    unsigned int s = 8*xlen;
+
+    load_block(w, x, xlen);
+    load_block(v, y, ylen);
+    // move y by xlen bytes
+    if (s >= 64) {
+        v[1] = (s >= 128) ? 0 : v[0] << (s - 64);
+        v[0] = 0;
+    }
+    else if (s != 0) {
+        v[1] = (v[1] << s) | (v[0] >> (64 - s));
+        v[0] <<= s;
+    }
+    w[0] |= v[0];
+    w[1] |= v[1];
+    memcpy(out, w, 16);
+#else
+    memset(out, 0x00, 16);
+    memcpy(out,        x, xlen);
+    memcpy(out + xlen, y, ylen);
+#endif
+}
+
+/**
+ * @brief Build the block x||0* where xlen <= 16.
+ */
+static inline void load_pad_block(uint8_t out[16], const uint8_t* x, size_t xlen)
+{
+#if defined(CYMRIC_WORDS)
+    uint64_t w[2];
+
+    load_block(w, x, xlen);
+    memcpy(out, w, 16);
+#else
+    memset(out, 0x00, 16);
+    memcpy(out, x, xlen);
+#endif
+}
+
 /**
  * @brief Exclusive-or between two byte arrays for a given number of bytes.
  * 
@@ -15,8 +159,22 @@ static inline void xor_bytes(
     const uint8_t*  c,
     size_t        len)
 {
+#if defined(CYMRIC_WORDS)
+    uint64_t x, y;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&x, b + i, 8);
+        memcpy(&y, c + i, 8);
+        x ^= y;
+        memcpy(a + i, &x, 8);
+    }
+    if (i < len)
+        store_partial(a + i, load_partial(b + i, len - i) ^ load_partial(c + i, len - i), len - i);
+#else
     for(unsigned int i = 0; i < len; i++)
         a[i] = b[i] ^ c[i];
+#endif
 }
 
 /**
@@ -30,6 +188,21 @@ static inline void xor_bytes(
  */
 static int sec_memcmp(const uint8_t *x, const uint8_t *y, size_t len)
 {
+#if defined(CYMRIC_WORDS)
+    uint64_t d = 0, u, v;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&u, x + i, 8);
+        memcpy(&v, y + i, 8);
+        d |= u ^ v;
+    }
+    if (i < len)
+        d |= load_partial(x + i, len - i) ^ load_partial(y + i, len - i);
+
+    // 1 if d != 0, without branching on the secret difference
+    return (int)((d | (0 - d)) >> 63);
+#else
     size_t    i = 0;
     uint8_t ret = 0x00; 
 
@@ -40,6 +213,7 @@ static int sec_memcmp(const uint8_t *x, const uint8_t *y, size_t len)
     }
 
     return ret;
+#endif
 }
 
 #endif
@@ -0,0 +1,99 @@
+/**
+ * @file cymric-nonce.c
+ *
+ * @brief Lock-free allocation of counter-based nonces among several threads
+ * sharing the same key.
+ */
+#include <string.h>
+#include "cymric-nonce.h"
+
+int cymric_nonce_pool_init(cymric_nonce_pool_t* pool, int variant,
+            const uint8_t prefix[], size_t prefix_len,
+            size_t ctr_len)
+{
+    unsigned int bound;
+
+    if (ctr_len == 0 || ctr_len > CYMRIC_NONCE_MAX_CTRBYTES)
+        return -1;
+    if (prefix_len + ctr_len > BLOCKBYTES - 1)
+        return -1;
+    if (variant == 1)
+        bound = CYMRIC1_MAX_QUERIES_LOG2;
+    else if (variant == 2)
+        bound = CYMRIC2_MAX_QUERIES_LOG2;
+    else
+        return -1;
+
+    // hard limit = min(2^(8*ctr_len), 2^bound), saturated to 64 bits
+    if (8*ctr_len < bound)
+        bound = 8*ctr_len;
+    pool->max   = (bound >= 64) ? UINT64_MAX : ((uint64_t)1 << bound);
+    pool->rekey = pool->max - (pool->max >> 3);
+
+    memset(pool->prefix, 0x00, BLOCKBYTES);
+    memcpy(pool->prefix, prefix, prefix_len);
+    pool->prefix_len = prefix_len;
+    pool->ctr_len    = ctr_len;
+    atomic_init(&pool->next, 0);
+    return 0;
+}
+
+int cymric_nonce_lease(cymric_nonce_pool_t* pool,
+            cymric_nonce_lease_t* lease,
+            uint64_t count)
+{
+    uint64_t start = atomic_load_explicit(&pool->next, memory_order_relaxed);
+    uint64_t end;
+
+    // a single CAS in the common case, clamped so that the counter never wraps
+    do {
+        if (start >= pool->max) {
+            lease->next = lease->end = start;
+            return CYMRIC_NONCE_EXHAUSTED;
+        }
+        end = (count > pool->max - start) ? pool->max : start + count;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->next, &start, end,
+                memory_order_relaxed, memory_order_relaxed));
+
+    memcpy(lease->n, pool->prefix, pool->prefix_len);
+    lease->nlen    = pool->prefix_len + pool->ctr_len;
+    lease->ctr_len = pool->ctr_len;
+    lease->next    = start;
+    lease->end     = end;
+    return (end > pool->rekey) ? CYMRIC_NONCE_REKEY : CYMRIC_NONCE_OK;
+}
+
+/**
+ * @brief Write a counter value as a big-endian integer of ctr_len bytes.
+ */
+static inline void store_ctr(uint8_t* dst, uint64_t ctr, unsigned int ctr_len)
+{
+    while (ctr_len--) {
+        dst[ctr_len] = (uint8_t)ctr;
+        ctr >>= 8;
+    }
+}
+
+const uint8_t* cymric_nonce_next(cymric_nonce_lease_t* lease)
+{
+    if (lease->next == lease->end)
+        return NULL;
+    store_ctr(lease->n + lease->nlen - lease->ctr_len, lease->next++, lease->ctr_len);
+    return lease->n;
+}
+
+size_t cymric_nonce_fill(cymric_nonce_lease_t* lease,
+            uint8_t n[], size_t stride,
+            size_t count)
+{
+    size_t i;
+    size_t plen = lease->nlen - lease->ctr_len;
+
+    if (count > cymric_nonce_remaining(lease))
+        count = cymric_nonce_remaining(lease);
+    for (i = 0; i < count; i++, n += stride) {
+        memcpy(n, lease->n, plen);
+        store_ctr(n + plen, lease->next++, lease->ctr_len);
+    }
+    return count;
+}
@@ -0,0 +1,118 @@
+#ifndef CYMRIC_NONCE_H_
+#define CYMRIC_NONCE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cymric.h"
+
+/**
+ * log2 of the number of encryption queries which can be processed under a
+ * single key while keeping the adversarial advantage below 2^-32, according
+ * to the n-bit (resp. 2n/3-bit) security of Cymric1 (resp. Cymric2).
+ */
+#define CYMRIC1_MAX_QUERIES_LOG2    (8*BLOCKBYTES - 32)
+#define CYMRIC2_MAX_QUERIES_LOG2    (2*8*BLOCKBYTES/3 - 32)
+
+#define CYMRIC_NONCE_MAX_CTRBYTES   8
+
+// return codes of cymric_nonce_lease
+#define CYMRIC_NONCE_OK         0
+#define CYMRIC_NONCE_REKEY      1   // lease granted but rekeying is due
+#define CYMRIC_NONCE_EXHAUSTED  -1  // no more nonces under this key
+
+/**
+ * Nonce allocator shared by all the threads encrypting under the same key.
+ * Nonces are made of a fixed prefix followed by a big-endian counter. Threads
+ * lease ranges of counter values with a single atomic operation, and then
+ * derive nonces from their lease without any synchronization.
+ */
+typedef struct {
+    _Atomic uint64_t next;          // first counter value not leased yet
+    uint64_t max;                   // hard limit of the counter
+    uint64_t rekey;                 // soft limit from which rekeying is due
+    uint8_t prefix[BLOCKBYTES];
+    uint8_t prefix_len;
+    uint8_t ctr_len;
+} cymric_nonce_pool_t;
+
+/**
+ * Range of counter values [next, end) owned by a single thread.
+ */
+typedef struct {
+    uint8_t n[BLOCKBYTES];          // prefix || counter of the last nonce
+    uint8_t nlen;
+    uint8_t ctr_len;
+    uint64_t next;
+    uint64_t end;
+} cymric_nonce_lease_t;
+
+/**
+ * @brief Initialize a nonce pool for a fresh key.
+ *
+ * The hard limit is the smallest between the counter space and the number of
+ * queries allowed by the security bound of the mode, while the rekeying
+ * threshold is set at 7/8 of the hard limit (and can be adjusted afterwards).
+ *
+ * @param pool The nonce pool
+ * @param variant The Cymric variant (1 or 2)
+ * @param prefix The fixed part of the nonce (e.g. a sender identifier)
+ * @param prefix_len The fixed part length (in bytes)
+ * @param ctr_len The counter length (in bytes)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_nonce_pool_init(cymric_nonce_pool_t* pool, int variant,
+        const uint8_t prefix[], size_t prefix_len,
+        size_t ctr_len);
+
+/**
+ * @brief Lease a range of consecutive counter values.
+ *
+ * Less than count values might be granted when reaching the hard limit.
+ *
+ * @param pool The nonce pool
+ * @param lease The lease to fill in
+ * @param count The number of nonces to lease
+ *
+ * @return CYMRIC_NONCE_OK, CYMRIC_NONCE_REKEY or CYMRIC_NONCE_EXHAUSTED
+ */
+int cymric_nonce_lease(cymric_nonce_pool_t* pool,
+        cymric_nonce_lease_t* lease,
+        uint64_t count);
+
+/**
+ * @brief Return the number of nonces left in a lease.
+ */
+static inline uint64_t cymric_nonce_remaining(const cymric_nonce_lease_t* lease)
+{
+    return lease->end - lease->next;
+}
+
+/**
+ * @brief Get the next nonce of a lease, to be passed to the Cymric functions
+ * along with lease->nlen.
+ *
+ * @param lease The lease
+ *
+ * @return A pointer to the nonce (valid until the next call), or NULL if the
+ *      lease is exhausted
+ */
+const uint8_t* cymric_nonce_next(cymric_nonce_lease_t* lease);
+
+/**
+ * @brief Write the next nonces of a lease to a strided buffer (e.g. the nonce
+ * column of a batch of messages).
+ *
+ * @param lease The lease
+ * @param n The output buffer
+ * @param stride The distance between two consecutive nonces (in bytes)
+ * @param count The number of nonces to write
+ *
+ * @return The number of nonces written
+ */
+size_t cymric_nonce_fill(cymric_nonce_lease_t* lease,
+        uint8_t n[], size_t stride,
+        size_t count);
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * @file cymric-nvnonce.c
+ *
+ * @brief Persistent counter-based nonces with amortized durable writes.
+ */
+#include <string.h>
+#include "cymric-nvnonce.h"
+
+/**
+ * @brief Record end as the new high-water mark, which must be durable before
+ * any of the counter values below it is used.
+ */
+static int reserve(cymric_nvnonce_t* s, uint64_t end)
+{
+    if (s->backend.store(s->backend.arg, end) != 0)
+        return -1;
+    s->hwm = end;
+    return 0;
+}
+
+int cymric_nvnonce_open(cymric_nvnonce_t* s,
+            const cymric_nvnonce_backend_t* backend,
+            const uint8_t prefix[], size_t prefix_len,
+            size_t ctr_len, uint64_t step)
+{
+    uint64_t hwm = 0;
+    int ret;
+
+    if (ctr_len == 0 || ctr_len > 8 || step == 0)
+        return -1;
+    if (prefix_len + ctr_len > BLOCKBYTES - 1)
+        return -1;
+
+    s->backend = *backend;
+    s->max     = (ctr_len == 8) ? UINT64_MAX : ((uint64_t)1 << (8*ctr_len));
+    s->step    = step;
+    s->nlen    = prefix_len + ctr_len;
+    s->ctr_len = ctr_len;
+    memset(s->n, 0x00, BLOCKBYTES);
+    memcpy(s->n, prefix, prefix_len);
+
+    ret = s->backend.load(s->backend.arg, &hwm);
+    if (ret < 0)
+        return -1;
+    if (ret > 0)
+        hwm = 0;    // fresh state
+
+    // skip the unused tail of the previous reservation
+    s->next = hwm;
+    s->hwm  = hwm;
+    return 0;
+}
+
+const uint8_t* cymric_nvnonce_next(cymric_nvnonce_t* s)
+{
+    uint64_t ctr;
+    unsigned int i;
+
+    if (s->next >= s->max)
+        return NULL;
+    if (s->next == s->hwm) {
+        uint64_t end = (s->step > s->max - s->next) ? s->max : s->next + s->step;
+        if (reserve(s, end) != 0)
+            return NULL;
+    }
+
+    // big-endian counter at the end of the nonce
+    ctr = s->next++;
+    i   = s->ctr_len;
+    while (i--) {
+        s->n[s->nlen - s->ctr_len + i] = (uint8_t)ctr;
+        ctr >>= 8;
+    }
+    return s->n;
+}
+
+int cymric1_nvnonce_enc(cymric_nvnonce_t* s,
+            uint8_t c[], size_t *clen,
+            const uint8_t k[],
+            const uint8_t m[], size_t mlen,
+            const uint8_t a[], size_t alen,
+            const cipher_ctx_t* ctx)
+{
+    const uint8_t* n = cymric_nvnonce_next(s);
+
+    if (n == NULL)
+        return -1;
+    return cymric1_enc(c, clen, k, n, s->nlen, m, mlen, a, alen, ctx);
+}
+
+int cymric2_nvnonce_enc(cymric_nvnonce_t* s,
+            uint8_t c[], size_t *clen,
+            const uint8_t k[],
+            const uint8_t m[], size_t mlen,
+            const uint8_t a[], size_t alen,
+            const cipher_ctx_t* ctx)
+{
+    const uint8_t* n = cymric_nvnonce_next(s);
+
+    if (n == NULL)
+        return -1;
+    return cymric2_enc(c, clen, k, n, s->nlen, m, mlen, a, alen, ctx);
+}
+
+/**
+ * Records are (hwm, ~hwm) in little-endian so that both erased (all 0xff)
+ * and partially programmed slots are detected as invalid.
+ */
+static void rec_encode(uint8_t rec[CYMRIC_NVNONCE_RECBYTES], uint64_t hwm)
+{
+    for (unsigned int i = 0; i < 8; i++) {
+        rec[i]     = (uint8_t)(hwm >> (8*i));
+        rec[i + 8] = (uint8_t)(~hwm >> (8*i));
+    }
+}
+
+static int rec_decode(const uint8_t rec[CYMRIC_NVNONCE_RECBYTES], uint64_t* hwm)
+{
+    uint64_t x = 0, y = 0;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        x |= (uint64_t)rec[i]     << (8*i);
+        y |= (uint64_t)rec[i + 8] << (8*i);
+    }
+    *hwm = x;
+    return (x == ~y) ? 0 : -1;
+}
+
+static int rec_erased(const uint8_t rec[CYMRIC_NVNONCE_RECBYTES])
+{
+    uint8_t acc = 0xff;
+
+    for (unsigned int i = 0; i < CYMRIC_NVNONCE_RECBYTES; i++)
+        acc &= rec[i];
+    return acc == 0xff;
+}
+
+static int flash_load(void* arg, uint64_t* hwm)
+{
+    cymric_nvnonce_flash_t* f = (cymric_nvnonce_flash_t*)arg;
+    size_t slots = f->page_size / CYMRIC_NVNONCE_RECBYTES;
+    int found = 0;
+    uint64_t v;
+
+    // the most recent record is the one with the highest value
+    f->page = 0;
+    f->slot = slots;
+    for (unsigned int p = 0; p < 2; p++) {
+        for (size_t i = 0; i < slots; i++) {
+            const uint8_t* rec = f->pages[p] + i*CYMRIC_NVNONCE_RECBYTES;
+            if (rec_erased(rec))
+                break;
+            if (rec_decode(rec, &v) != 0)
+                continue;   // torn write, skipped
+            if (!found || v > *hwm) {
+                *hwm    = v;
+                f->page = p;
+                found   = 1;
+            }
+        }
+    }
+    if (!found)
+        return 1;
+
+    // next free slot in the page holding the most recent record
+    for (size_t i = 0; i < slots; i++) {
+        if (rec_erased(f->pages[f->page] + i*CYMRIC_NVNONCE_RECBYTES)) {
+            f->slot = i;
+            break;
+        }
+    }
+    return 0;
+}
+
+static int flash_store(void* arg, uint64_t hwm)
+{
+    cymric_nvnonce_flash_t* f = (cymric_nvnonce_flash_t*)arg;
+    size_t slots = f->page_size / CYMRIC_NVNONCE_RECBYTES;
+    uint8_t rec[CYMRIC_NVNONCE_RECBYTES];
+
+    rec_encode(rec, hwm);
+    if (f->slot >= slots) {
+        // switch pages, the current one keeps the previous record meanwhile
+        f->page ^= 1;
+        f->slot  = 0;
+        if (f->erase(f->pages[f->page]) != 0)
+            return -1;
+    }
+    if (f->program(f->pages[f->page] + f->slot*CYMRIC_NVNONCE_RECBYTES,
+            rec, CYMRIC_NVNONCE_RECBYTES) != 0)
+        return -1;
+    f->slot++;
+    return 0;
+}
+
+cymric_nvnonce_backend_t cymric_nvnonce_flash_backend(cymric_nvnonce_flash_t* f)
+{
+    cymric_nvnonce_backend_t b = {
+        .load  = flash_load,
+        .store = flash_store,
+        .arg   = f,
+    };
+    // until loaded, behave as if both pages were full to force an erase
+    f->page = 1;
+    f->slot = f->page_size / CYMRIC_NVNONCE_RECBYTES;
+    return b;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+
+/**
+ * @brief Read (resp. write) exactly len bytes, resuming after interrupted
+ * calls and short transfers.
+ *
+ * @return 0 if successfully executed, -1 on error or end of file
+ */
+static int read_full(int fd, uint8_t* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t r = read(fd, buf, len);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const uint8_t* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t r = write(fd, buf, len);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+
+static int file_load(void* arg, uint64_t* hwm)
+{
+    const char* path = (const char*)arg;
+    uint8_t rec[CYMRIC_NVNONCE_RECBYTES];
+    int fd, ret;
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        // only a missing file means that nothing was recorded yet: any other
+        // failure (permissions, I/O error, missing mount...) must not restart
+        // the counter from 0
+        return (errno == ENOENT) ? 1 : -1;
+    }
+    ret = read_full(fd, rec, sizeof(rec));
+    close(fd);
+    if (ret != 0 || rec_decode(rec, hwm) != 0)
+        return -1;
+    return 0;
+}
+
+static int file_store(void* arg, uint64_t hwm)
+{
+    const char* path = (const char*)arg;
+    char tmp[4096], dir[4096];
+    uint8_t rec[CYMRIC_NVNONCE_RECBYTES];
+    int fd, ret = 0;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return -1;
+    rec_encode(rec, hwm);
+
+    // write the new record aside and make it durable before renaming it
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -1;
+    if (write_full(fd, rec, sizeof(rec)) != 0 || fsync(fd) != 0)
+        ret = -1;
+    if (close(fd) != 0 || ret != 0)
+        return -1;
+    if (rename(tmp, path) != 0)
+        return -1;
+
+    // make the rename itself durable
+    snprintf(dir, sizeof(dir), "%s", path);
+    fd = open(dirname(dir), O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+cymric_nvnonce_backend_t cymric_nvnonce_file_backend(const char* path)
+{
+    cymric_nvnonce_backend_t b = {
+        .load  = file_load,
+        .store = file_store,
+        .arg   = (void*)path,
+    };
+    return b;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef CYMRIC_NVNONCE_H_
+#define CYMRIC_NVNONCE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cymric.h"
+
+/**
+ * Persistent counter-based nonces which survive reboots without writing to
+ * durable storage for each message.
+ *
+ * Counter values are reserved by ranges of `step` values: only the end of the
+ * current reservation (i.e. the high-water mark) is recorded in durable
+ * storage, and it has to be durable before any nonce of the range is used.
+ * On recovery, the counter restarts from the recorded high-water mark, so the
+ * unused tail of the last reservation is skipped and no nonce is ever reused.
+ */
+
+/**
+ * Durable storage for the high-water mark.
+ * load returns 0 on success, 1 if nothing has been recorded yet and a
+ * negative value on error. store must return only once the value is durable.
+ */
+typedef struct {
+    int (*load)(void* arg, uint64_t* hwm);
+    int (*store)(void* arg, uint64_t hwm);
+    void* arg;
+} cymric_nvnonce_backend_t;
+
+typedef struct {
+    cymric_nvnonce_backend_t backend;
+    uint64_t next;              // next counter value
+    uint64_t hwm;               // end of the durable reservation
+    uint64_t step;              // reservation size
+    uint64_t max;               // counter space
+    uint8_t n[BLOCKBYTES];      // prefix || counter of the last nonce
+    uint8_t nlen;
+    uint8_t ctr_len;
+} cymric_nvnonce_t;
+
+/**
+ * @brief Recover the counter from durable storage and reserve a first range.
+ *
+ * @param s The persistent nonce state
+ * @param backend The durable storage backend
+ * @param prefix The fixed part of the nonce (e.g. a device identifier)
+ * @param prefix_len The fixed part length (in bytes)
+ * @param ctr_len The counter length (in bytes, at most 8)
+ * @param step The number of counter values reserved at once
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_nvnonce_open(cymric_nvnonce_t* s,
+        const cymric_nvnonce_backend_t* backend,
+        const uint8_t prefix[], size_t prefix_len,
+        size_t ctr_len, uint64_t step);
+
+/**
+ * @brief Get the next nonce, reserving a new range in durable storage when
+ * the current one is exhausted.
+ *
+ * @param s The persistent nonce state
+ *
+ * @return A pointer to the nonce of s->nlen bytes (valid until the next
+ *      call), or NULL if the counter space is exhausted or on storage error
+ */
+const uint8_t* cymric_nvnonce_next(cymric_nvnonce_t* s);
+
+/**
+ * @brief Authenticated encryption using Cymric1 under the next persistent
+ * nonce, which is available in s->n once the function returns.
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric1_nvnonce_enc(cymric_nvnonce_t* s,
+        uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+/**
+ * @brief Authenticated encryption using Cymric2 under the next persistent
+ * nonce, which is available in s->n once the function returns.
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric2_nvnonce_enc(cymric_nvnonce_t* s,
+        uint8_t c[], size_t *clen,
+        const uint8_t k[],
+        const uint8_t m[], size_t mlen,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+/**
+ * Flash backend which appends (hwm, ~hwm) records to one of two flash pages,
+ * so that the previous record is never erased before the new one is written.
+ * The pages are read through their memory-mapped addresses while erasing and
+ * programming are delegated to platform-specific functions.
+ */
+#define CYMRIC_NVNONCE_RECBYTES 16
+
+typedef struct {
+    const uint8_t* pages[2];    // memory-mapped addresses of the two pages
+    size_t page_size;
+    int (*erase)(const uint8_t* page);
+    int (*program)(const uint8_t* addr, const uint8_t* data, size_t len);
+    uint8_t page;               // page holding the last record
+    size_t slot;                // next free slot in that page
+} cymric_nvnonce_flash_t;
+
+/**
+ * @brief Get a backend relying on two flash pages.
+ *
+ * @param f The flash description, whose pages, page_size, erase and program
+ *      fields must be set beforehand
+ */
+cymric_nvnonce_backend_t cymric_nvnonce_flash_backend(cymric_nvnonce_flash_t* f);
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * @brief Get a backend relying on a file, updated atomically through
+ * write/fsync/rename. Only a missing file is taken as a fresh state: a file
+ * which cannot be opened or read, or holds a corrupt record, fails the load.
+ *
+ * @param path The path of the file (must remain valid while in use)
+ */
+cymric_nvnonce_backend_t cymric_nvnonce_file_backend(const char* path);
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file cymric-profile.c
+ *
+ * @brief Storage and reporting of the optional per-phase Cymric profiling.
+ * Nothing is compiled unless CYMRIC_PROFILE is defined.
+ *
+ * With per-thread states, the states are chained into a registry as threads
+ * record their first sample, and never freed, so that the samples of threads
+ * which have exited are still reported.
+ */
+#include "cymric-profile.h"
+
+#ifdef CYMRIC_PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CYMRIC_PROFILE_PERF) && !defined(CYMRIC_PROFILE_TIMER)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef CYMRIC_PROFILE_SINGLE_THREAD
+cymric_prof_t cymric_prof;
+#define first_state() (&cymric_prof)
+#else
+_Thread_local cymric_prof_t* cymric_prof_self;
+static cymric_prof_t* registry;     // most recently registered state first
+
+#define first_state() __atomic_load_n(&registry, __ATOMIC_ACQUIRE)
+
+cymric_prof_t* cymric_prof_register(void)
+{
+    cymric_prof_t* p = calloc(1, sizeof(cymric_prof_t));
+
+    if (p == NULL)
+        return NULL;
+    p->next = __atomic_load_n(&registry, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&registry, &p->next, p, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    cymric_prof_self = p;
+    return p;
+}
+#endif
+
+#if defined(CYMRIC_PROFILE_PERF) && !defined(CYMRIC_PROFILE_TIMER)
+CYMRIC_PROF_TLS int cymric_prof_perf_fd = -1;
+
+int cymric_prof_perf_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0x00, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    // count cycles for the calling thread on any cpu
+    cymric_prof_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cymric_prof_perf_fd >= 0)
+        return 0;
+    cymric_prof_perf_fd = -2;   // not retried by the probes
+    return -1;
+}
+#endif
+
+static const char* const op_names[CYMRIC_PROF_OPS] = {
+    "cymric1_enc", "cymric1_dec", "cymric2_enc", "cymric2_dec"
+};
+
+static const char* const phase_names[CYMRIC_PHASES] = {
+    "kexpand", "encrypt", "xor", "kexpand_tag", "encrypt_tag", "verify"
+};
+
+int cymric_profile_init(void)
+{
+#if defined(CYMRIC_PROFILE_TIMER)
+    // user-provided timer is expected to be already running
+#elif defined(CYMRIC_PROFILE_PERF)
+    // other threads open their own counter on their first probe
+    if (cymric_prof_perf_fd < 0 && cymric_prof_perf_open() != 0)
+        return -1;
+#elif defined(CYMRIC_PROFILE_DWT)
+    CYMRIC_PROF_SCS_DEMCR |= (1u << 24);    // TRCENA
+    CYMRIC_PROF_DWT_CYCCNT = 0;
+    CYMRIC_PROF_DWT_CTRL  |= 1u;            // CYCCNTENA
+#elif defined(CYMRIC_PROFILE_AVR)
+    TCCR1A = 0x00;
+    TCCR1B = _BV(CS10);                     // normal mode, no prescaler
+#endif
+    cymric_profile_reset();
+    return 0;
+}
+
+void cymric_profile_reset(void)
+{
+    for (cymric_prof_t* p = first_state(); p != NULL; p = p->next)
+        memset(p->hist, 0x00, sizeof(p->hist));
+}
+
+/**
+ * @brief Add the samples of histogram src to histogram dst.
+ */
+static void merge(cymric_prof_hist_t* dst, const cymric_prof_hist_t* src)
+{
+    if (src->count == 0)
+        return;
+    if (dst->count == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    dst->count += src->count;
+    dst->total += src->total;
+    for (unsigned int i = 0; i < CYMRIC_PROFILE_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+void cymric_profile_dump(int (*out)(const char*, ...))
+{
+    for (unsigned int op = 0; op < CYMRIC_PROF_OPS; op++) {
+        for (unsigned int ph = 0; ph < CYMRIC_PHASES; ph++) {
+            cymric_prof_hist_t h;
+            memset(&h, 0x00, sizeof(h));
+            for (const cymric_prof_t* p = first_state(); p != NULL; p = p->next)
+                merge(&h, &p->hist[op][ph]);
+            if (h.count == 0)
+                continue;
+            out("%s %-12s n=%lu min=%lu max=%lu avg=%lu\n",
+                op_names[op], phase_names[ph],
+                (unsigned long)h.count,
+                (unsigned long)h.min,
+                (unsigned long)h.max,
+                (unsigned long)(h.total / h.count));
+            for (unsigned int i = 0; i < CYMRIC_PROFILE_BUCKETS; i++) {
+                if (h.buckets[i] != 0)
+                    out("    [2^%-2u, 2^%-2u) %lu\n", i, i + 1,
+                        (unsigned long)h.buckets[i]);
+            }
+        }
+    }
+}
+
+#endif /* CYMRIC_PROFILE */
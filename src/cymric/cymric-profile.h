@@ -0,0 +1,211 @@
+#ifndef CYMRIC_PROFILE_H
+#define CYMRIC_PROFILE_H
+
+/**
+ * Optional per-phase profiling of the Cymric functions.
+ *
+ * Profiling is disabled by default and all the probes compile to nothing.
+ * It is enabled by defining CYMRIC_PROFILE at compile time, in which case the
+ * timer backend is selected as follows (first match wins):
+ *   - CYMRIC_PROFILE_TIMER()   user-provided timestamp expression
+ *   - CYMRIC_PROFILE_PERF      Linux perf_event cycle counter
+ *   - CYMRIC_PROFILE_DWT       Cortex-M DWT_CYCCNT register
+ *   - CYMRIC_PROFILE_AVR       AVR 16-bit TIMER1 without prescaler
+ *   - __x86_64__ / __i386__    rdtsc
+ *
+ * On hosted C11 targets, each thread records its samples into its own state,
+ * allocated on its first sample and kept until exit, and the reports merge
+ * the states of all the threads. Elsewhere (or if CYMRIC_PROFILE_SINGLE_THREAD
+ * is defined), a single state is shared and only one thread may be profiled.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    CYMRIC_PROF_CYMRIC1_ENC,
+    CYMRIC_PROF_CYMRIC1_DEC,
+    CYMRIC_PROF_CYMRIC2_ENC,
+    CYMRIC_PROF_CYMRIC2_DEC,
+    CYMRIC_PROF_OPS
+} cymric_prof_op_t;
+
+typedef enum {
+    CYMRIC_PHASE_KEXPAND,       // key expansion of K
+    CYMRIC_PHASE_ENCRYPT,       // Y0 and Y1 encryptions under K
+    CYMRIC_PHASE_XOR,           // padding, block construction and XORs
+    CYMRIC_PHASE_KEXPAND_TAG,   // key expansion of K'
+    CYMRIC_PHASE_ENCRYPT_TAG,   // tag encryption under K'
+    CYMRIC_PHASE_VERIFY,        // tag comparison (decryption only)
+    CYMRIC_PHASES
+} cymric_prof_phase_t;
+
+#ifdef CYMRIC_PROFILE
+
+#if !defined(CYMRIC_PROFILE_SINGLE_THREAD) && \
+    (defined(CYMRIC_PROFILE_DWT) || defined(CYMRIC_PROFILE_AVR) || !__STDC_HOSTED__ || \
+     !defined(__STDC_VERSION__) || __STDC_VERSION__ < 201112L || defined(__STDC_NO_THREADS__))
+#define CYMRIC_PROFILE_SINGLE_THREAD
+#endif
+
+#ifdef CYMRIC_PROFILE_SINGLE_THREAD
+#define CYMRIC_PROF_TLS
+#else
+#define CYMRIC_PROF_TLS _Thread_local
+#endif
+
+#if defined(CYMRIC_PROFILE_TIMER)
+    #ifndef CYMRIC_PROFILE_TICKS_T
+    #define CYMRIC_PROFILE_TICKS_T uint32_t
+    #endif
+    typedef CYMRIC_PROFILE_TICKS_T cymric_prof_ticks_t;
+    #define CYMRIC_PROF_NOW() ((cymric_prof_ticks_t)(CYMRIC_PROFILE_TIMER()))
+#elif defined(CYMRIC_PROFILE_PERF)
+    #include <unistd.h>
+    typedef uint64_t cymric_prof_ticks_t;
+    extern CYMRIC_PROF_TLS int cymric_prof_perf_fd;     // counter of the calling thread
+    int cymric_prof_perf_open(void);
+    static inline cymric_prof_ticks_t cymric_prof_now(void) {
+        uint64_t v = 0;
+        if (cymric_prof_perf_fd == -1 && cymric_prof_perf_open() != 0)
+            return 0;
+        if (read(cymric_prof_perf_fd, &v, sizeof(v)) != sizeof(v))
+            return 0;
+        return v;
+    }
+    #define CYMRIC_PROF_NOW() cymric_prof_now()
+#elif defined(CYMRIC_PROFILE_DWT)
+    typedef uint32_t cymric_prof_ticks_t;
+    #define CYMRIC_PROF_DWT_CTRL    (*(volatile uint32_t*)0xE0001000)
+    #define CYMRIC_PROF_DWT_CYCCNT  (*(volatile uint32_t*)0xE0001004)
+    #define CYMRIC_PROF_SCS_DEMCR   (*(volatile uint32_t*)0xE000EDFC)
+    #define CYMRIC_PROF_NOW() ((cymric_prof_ticks_t)CYMRIC_PROF_DWT_CYCCNT)
+#elif defined(CYMRIC_PROFILE_AVR)
+    #include <avr/io.h>
+    typedef uint16_t cymric_prof_ticks_t;
+    #define CYMRIC_PROF_NOW() ((cymric_prof_ticks_t)TCNT1)
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    typedef uint64_t cymric_prof_ticks_t;
+    #define CYMRIC_PROF_NOW() ((cymric_prof_ticks_t)__rdtsc())
+#else
+    #error "CYMRIC_PROFILE requires a timer backend (see cymric-profile.h)"
+#endif
+
+// log2 histogram: bucket i counts the samples in [2^i, 2^(i+1))
+#ifndef CYMRIC_PROFILE_BUCKETS
+#define CYMRIC_PROFILE_BUCKETS (8*sizeof(cymric_prof_ticks_t))
+#endif
+
+typedef struct {
+    uint32_t count;
+    uint64_t total;
+    cymric_prof_ticks_t min;
+    cymric_prof_ticks_t max;
+    uint32_t buckets[CYMRIC_PROFILE_BUCKETS];
+} cymric_prof_hist_t;
+
+typedef struct cymric_prof_s {
+    cymric_prof_hist_t hist[CYMRIC_PROF_OPS][CYMRIC_PHASES];
+    struct cymric_prof_s* next;     // next state of the registry
+} cymric_prof_t;
+
+#ifdef CYMRIC_PROFILE_SINGLE_THREAD
+extern cymric_prof_t cymric_prof;
+#define cymric_prof_state() (&cymric_prof)
+#else
+extern _Thread_local cymric_prof_t* cymric_prof_self;
+
+/**
+ * @brief Allocate the state of the calling thread and add it to the registry
+ * merged by the reports.
+ *
+ * @return The state, or NULL if it cannot be allocated
+ */
+cymric_prof_t* cymric_prof_register(void);
+
+static inline cymric_prof_t* cymric_prof_state(void)
+{
+    return (cymric_prof_self != NULL) ? cymric_prof_self : cymric_prof_register();
+}
+#endif
+
+/**
+ * @brief Setup the timer backend (e.g. enable the cycle counter).
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_profile_init(void);
+
+/**
+ * @brief Clear all the histograms (of all the threads, which must not be
+ * recording samples meanwhile).
+ */
+void cymric_profile_reset(void);
+
+/**
+ * @brief Print all the non-empty histograms, merged over all the threads
+ * which recorded samples (and which should be done recording them).
+ *
+ * @param out A printf-like function used to output the results
+ */
+void cymric_profile_dump(int (*out)(const char*, ...));
+
+/**
+ * @brief Record a sample for a given phase of a given operation.
+ *
+ * @param op The Cymric operation
+ * @param phase The phase within the operation
+ * @param ticks The number of ticks spent in the phase
+ */
+static inline void cymric_prof_record(
+    cymric_prof_op_t    op,
+    cymric_prof_phase_t phase,
+    cymric_prof_ticks_t ticks)
+{
+    cymric_prof_t* p = cymric_prof_state();
+    cymric_prof_hist_t* h;
+    unsigned int i = 0;
+
+    if (p == NULL)
+        return;
+    h = &p->hist[op][phase];
+    if (h->count == 0 || ticks < h->min)
+        h->min = ticks;
+    if (ticks > h->max)
+        h->max = ticks;
+    h->count++;
+    h->total += ticks;
+    while ((ticks >>= 1) && i < CYMRIC_PROFILE_BUCKETS - 1)
+        i++;
+    h->buckets[i]++;
+}
+
+/**
+ * The probes below measure consecutive phases: CYMRIC_PROF_BEGIN starts the
+ * clock and each CYMRIC_PROF_MARK accounts for the time elapsed since the
+ * previous probe. The clock is restarted after recording so that the
+ * bookkeeping itself is not charged to the next phase.
+ */
+#define CYMRIC_PROF_BEGIN(op) \
+    const cymric_prof_op_t cymric_prof_op = (op); \
+    cymric_prof_ticks_t cymric_prof_t0 = CYMRIC_PROF_NOW()
+
+#define CYMRIC_PROF_MARK(phase) do { \
+    cymric_prof_ticks_t cymric_prof_t1 = CYMRIC_PROF_NOW(); \
+    cymric_prof_record(cymric_prof_op, (phase), \
+        (cymric_prof_ticks_t)(cymric_prof_t1 - cymric_prof_t0)); \
+    cymric_prof_t0 = CYMRIC_PROF_NOW(); \
+} while (0)
+
+#else
+
+#define CYMRIC_PROF_BEGIN(op)       do {} while (0)
+#define CYMRIC_PROF_MARK(phase)     do {} while (0)
+#define cymric_profile_init()       0
+#define cymric_profile_reset()      do {} while (0)
+#define cymric_profile_dump(out)    do {} while (0)
+
+#endif /* CYMRIC_PROFILE */
+
+#endif /* CYMRIC_PROFILE_H */
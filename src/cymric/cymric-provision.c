@@ -0,0 +1,34 @@
+/**
+ * @file cymric-provision.c
+ *
+ * @brief Generation of the round key tables of K||K' to be stored in flash.
+ */
+#include "cymric-provision.h"
+
+/**
+ * @brief Print n bytes as the body of a C array, 16 bytes per line.
+ */
+static void dump_bytes(int (*out)(const char*, ...), const uint8_t* p, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out("%s0x%02x,%s", (i % 16 == 0) ? "    " : "", p[i], (i % 16 == 15 || i == n - 1) ? "\n" : " ");
+}
+
+int cymric_provision_dump(int (*out)(const char*, ...), const char* name,
+            const uint8_t k[], const cipher_ctx_t* ctx)
+{
+    if (ctx->kexpand == NULL || ctx->roundkeys == NULL)
+        return -1;
+
+    out("// Round keys of K||K' generated by cymric_provision_dump\n");
+    out("#include <stdint.h>\n#include \"cymric-provision.h\"\n\n");
+    out("const uint8_t %s[%lu] CYMRIC_FLASH = {\n", name, (unsigned long)(2*ctx->rkeys_size));
+    out("    // K\n");
+    ctx->kexpand(ctx->roundkeys, k);
+    dump_bytes(out, ctx->roundkeys, ctx->rkeys_size);
+    out("    // K'\n");
+    ctx->kexpand(ctx->roundkeys, k + KEYBYTES);
+    dump_bytes(out, ctx->roundkeys, ctx->rkeys_size);
+    out("};\n");
+    return 0;
+}
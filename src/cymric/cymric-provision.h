@@ -0,0 +1,51 @@
+#ifndef CYMRIC_PROVISION_H_
+#define CYMRIC_PROVISION_H_
+
+#include <stdint.h>
+#include "cymric.h"
+
+/**
+ * Round keys provisioned at manufacturing time.
+ *
+ * For devices whose key K||K' never changes, the round keys of K and K' can be
+ * computed once and stored in flash next to the firmware instead of being
+ * expanded in RAM for each message. The instantiations read them as is when
+ * built with the corresponding flag (e.g. AES128_FLASH_RKEYS), in which case
+ * the key passed to the Cymric functions is the provisioned array.
+ *
+ * Arrays to be read from flash must be declared with CYMRIC_FLASH: on AVR, they
+ * are placed in program memory and read with lpm, so that their address must
+ * be below 64 KB; on Cortex-M, const data is placed in .rodata, i.e. in flash.
+ * On x86_64, they are aligned on a cache line so that AES-NI reads the round
+ * keys with aligned loads.
+ */
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define CYMRIC_FLASH PROGMEM
+#elif defined(__x86_64__)
+#define CYMRIC_FLASH __attribute__((aligned(64)))
+#else
+#define CYMRIC_FLASH __attribute__((aligned(8)))
+#endif
+
+/**
+ * @brief Print the round keys of K and K' as a C source file defining
+ * `const uint8_t name[2*rkeys_size] CYMRIC_FLASH`, to be linked in firmware
+ * built with the corresponding *_FLASH_RKEYS flag.
+ *
+ * The round keys are expanded by ctx->kexpand into ctx->roundkeys, so that the
+ * provisioning program must be built for the same instantiation as the
+ * firmware (without the *_FLASH_RKEYS flag) and run on the target or on any
+ * platform sharing its round key layout and endianness.
+ *
+ * @param out A printf-like function used to output the source file
+ * @param name The name of the array
+ * @param k The encryption key K||K'
+ * @param ctx The cipher context
+ *
+ * @return 0 if successfully executed, -1 if the context has no key expansion
+ */
+int cymric_provision_dump(int (*out)(const char*, ...), const char* name,
+        const uint8_t k[], const cipher_ctx_t* ctx);
+
+#endif
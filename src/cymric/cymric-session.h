@@ -0,0 +1,119 @@
+#ifndef CYMRIC_SESSION_H_
+#define CYMRIC_SESSION_H_
+
+#include <stdint.h>
+#include "cymric.h"
+
+/**
+ * Session for a sequence of messages sharing a key and an associated data,
+ * where the nonce embeds a big-endian counter which is incremented after each
+ * message. The block padn(N||A||b) is built once at initialization and then
+ * updated in place for each message, so that no byte copy of the nonce and
+ * the associated data is required on a per-message basis.
+ */
+typedef struct {
+    uint8_t blk[BLOCKBYTES];    // padn(N||A||b) template
+    const uint8_t* k;           // K||K' key material
+    const cipher_ctx_t* ctx;
+    uint8_t nlen;
+    uint8_t alen;
+    uint8_t ctr_off;            // offset of the counter within N
+    uint8_t ctr_len;            // length of the counter (in bytes)
+    uint8_t exhausted;          // set when the counter has wrapped around
+} cymric_session_t;
+
+/**
+ * @brief Initialize a counter-nonce session.
+ *
+ * @param s The session to initialize
+ * @param k The encryption key (must remain valid during the session)
+ * @param n The initial nonce
+ * @param nlen The nonce length (in bytes)
+ * @param ctr_off The offset of the counter field within the nonce
+ * @param ctr_len The length of the counter field (in bytes)
+ * @param a The additional data shared by all the messages
+ * @param alen The additional data length (in bytes)
+ * @param ctx The cipher context (must remain valid during the session)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric_session_init(cymric_session_t* s,
+        const uint8_t k[],
+        const uint8_t n[], size_t nlen,
+        size_t ctr_off, size_t ctr_len,
+        const uint8_t a[], size_t alen,
+        const cipher_ctx_t* ctx);
+
+/**
+ * @brief Return the nonce to be used for the next message.
+ */
+static inline const uint8_t* cymric_session_nonce(const cymric_session_t* s)
+{
+    return s->blk;
+}
+
+/**
+ * @brief Authenticated encryption using Cymric1 under the current nonce,
+ * which is then incremented.
+ *
+ * @param s The session
+ * @param c The output ciphertext (should be at least TAGBYTES+mlen long)
+ * @param clen The length of the ciphertext
+ * @param m The message to secure
+ * @param mlen The message length (in bytes)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric1_session_enc(cymric_session_t* s,
+        uint8_t c[], size_t *clen,
+        const uint8_t m[], size_t mlen);
+
+/**
+ * @brief Authenticated decryption using Cymric1 under the current nonce,
+ * which is then incremented if the tag is valid.
+ *
+ * @param s The session
+ * @param p The output plaintext (should be at least clen-TAGBYTES long)
+ * @param plen The length of the plaintext
+ * @param c The ciphertext to decrypt/verify
+ * @param clen The ciphertext length (in bytes)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric1_session_dec(cymric_session_t* s,
+        uint8_t p[], size_t *plen,
+        const uint8_t c[], size_t clen);
+
+/**
+ * @brief Authenticated encryption using Cymric2 under the current nonce,
+ * which is then incremented.
+ *
+ * @param s The session
+ * @param c The output ciphertext (should be at least TAGBYTES+mlen long)
+ * @param clen The length of the ciphertext
+ * @param m The message to secure
+ * @param mlen The message length (in bytes)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric2_session_enc(cymric_session_t* s,
+        uint8_t c[], size_t *clen,
+        const uint8_t m[], size_t mlen);
+
+/**
+ * @brief Authenticated decryption using Cymric2 under the current nonce,
+ * which is then incremented if the tag is valid.
+ *
+ * @param s The session
+ * @param p The output plaintext (should be at least clen-TAGBYTES long)
+ * @param plen The length of the plaintext
+ * @param c The ciphertext to decrypt/verify
+ * @param clen The ciphertext length (in bytes)
+ *
+ * @return 0 if successfully executed, error code otherwise
+ */
+int cymric2_session_dec(cymric_session_t* s,
+        uint8_t p[], size_t *plen,
+        const uint8_t c[], size_t clen);
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file cymric-shape.h
+ *
+ * @brief Cymric1 and Cymric2 specialized for a fixed shape, i.e. for protocols
+ * where the lengths of N, A and M are always the same.
+ *
+ * All the lengths being compile-time constants, the blocks are built with
+ * constant-size copies, the flag and padding bytes are written at constant
+ * positions and the validity of the shape is checked at compile time, so
+ * that the functions are free of any length-dependent branch.
+ *
+ * This file is a template to be included once per shape after defining:
+ * ~~~
+ * #define CYMRIC_SHAPE_NAME  proto    // prefix of the generated functions
+ * #define CYMRIC_SHAPE_NLEN  12       // nonce length
+ * #define CYMRIC_SHAPE_ALEN  3        // associated data length
+ * #define CYMRIC_SHAPE_MLEN  4        // message length
+ * #include "cymric-shape.h"
+ * ~~~
+ * which defines the following static functions:
+ * ~~~
+ * void proto_cymric1_enc(uint8_t c[], const uint8_t k[], const uint8_t n[],
+ *         const uint8_t m[], const uint8_t a[], const cipher_ctx_t* ctx);
+ * int  proto_cymric1_dec(uint8_t m[], const uint8_t k[], const uint8_t n[],
+ *         const uint8_t c[], const uint8_t a[], const cipher_ctx_t* ctx);
+ * ~~~
+ * and the same for Cymric2, where c is made of the MLEN-byte ciphertext
+ * followed by the tag and dec returns 0 if the tag is valid, 1 otherwise (in
+ * which case m is zeroed), as cymric*_dec. Cymric1 (resp. Cymric2) functions
+ * are only defined if NLEN + MLEN <= BLOCKBYTES (resp. MLEN <= BLOCKBYTES).
+ * The shape macros are undefined at the end of the file.
+ */
+#include <string.h>
+#include "cymric.h"
+#include "cymric-common.h"
+
+#ifndef CYMRIC_SHAPE_H_
+#define CYMRIC_SHAPE_H_
+
+#define CYMRIC_SHAPE_CAT_(a, b)     a##_##b
+#define CYMRIC_SHAPE_CAT(a, b)      CYMRIC_SHAPE_CAT_(a, b)
+#define CYMRIC_SHAPE_FN(f)          CYMRIC_SHAPE_CAT(CYMRIC_SHAPE_NAME, f)
+
+#endif
+
+#if !defined(CYMRIC_SHAPE_NAME) || !defined(CYMRIC_SHAPE_NLEN) || \
+    !defined(CYMRIC_SHAPE_ALEN) || !defined(CYMRIC_SHAPE_MLEN)
+#error "CYMRIC_SHAPE_NAME, CYMRIC_SHAPE_NLEN, CYMRIC_SHAPE_ALEN and CYMRIC_SHAPE_MLEN must be defined"
+#endif
+#if CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_ALEN > BLOCKBYTES - 1
+#error "Cymric requires NLEN + ALEN < BLOCKBYTES"
+#endif
+#if CYMRIC_SHAPE_MLEN > BLOCKBYTES
+#error "Cymric requires MLEN <= BLOCKBYTES"
+#endif
+
+/**
+ * @brief Y0 <- E_K(padn(N||A||b0)) and Y1 <- E_K(padn(N||A||b1)), where b is
+ * the flag of the full block case.
+ */
+static inline void CYMRIC_SHAPE_FN(y)(uint8_t y0[BLOCKBYTES], uint8_t y1[BLOCKBYTES],
+            const uint8_t k[], const uint8_t n[], const uint8_t a[], uint8_t b,
+            const cipher_ctx_t* ctx)
+{
+    const void* rk = k;
+
+    memset(y0, 0x00, BLOCKBYTES);
+    memcpy(y0, n, CYMRIC_SHAPE_NLEN);
+    memcpy(y0 + CYMRIC_SHAPE_NLEN, a, CYMRIC_SHAPE_ALEN);
+    y0[CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_ALEN] = b | 0x20;
+    memcpy(y1, y0, BLOCKBYTES);
+    y1[CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_ALEN] = b | 0x60;
+
+    // compute round keys if online key expansion is required
+    if (ctx->kexpand != NULL) {
+        ctx->kexpand(ctx->roundkeys, k);
+        rk = ctx->roundkeys;
+    }
+#if defined(CIPHER_CTX_ENCRYPT_2BLOCKS)
+    ctx->encrypt(y0, y1, y0, y1, rk);
+#else
+    if (ctx->encrypt_x2 != NULL)
+        ctx->encrypt_x2(y0, y1, y0, y1, rk);
+    else {
+        ctx->encrypt(y0, y0, rk);
+        ctx->encrypt(y1, y1, rk);
+    }
+#endif
+}
+
+/**
+ * @brief T <- msb(E_K'(T)).
+ */
+static inline void CYMRIC_SHAPE_FN(tag)(uint8_t t[BLOCKBYTES], const uint8_t k[],
+            const cipher_ctx_t* ctx)
+{
+    if (ctx->kexpand != NULL) {
+        ctx->kexpand(ctx->roundkeys, k + KEYBYTES);
+#if defined(CIPHER_CTX_ENCRYPT_2BLOCKS)
+        ctx->encrypt(t, t, t, t, ctx->roundkeys);
+#else
+        ctx->encrypt(t, t, ctx->roundkeys);
+#endif
+    }
+    else {
+#if defined(CIPHER_CTX_ENCRYPT_2BLOCKS)
+        ctx->encrypt(t, t, t, t, k + ctx->rkeys_size);
+#else
+        ctx->encrypt(t, t, k + ctx->rkeys_size);
+#endif
+    }
+}
+
+#if CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_MLEN <= BLOCKBYTES
+/**
+ * @brief T <- Y0 ^ pad(N||M) for Cymric1.
+ */
+static inline void CYMRIC_SHAPE_FN(pad1)(uint8_t t[BLOCKBYTES],
+            const uint8_t n[], const uint8_t m[])
+{
+    xor_bytes(t, t, n, CYMRIC_SHAPE_NLEN);
+    xor_bytes(t + CYMRIC_SHAPE_NLEN, t + CYMRIC_SHAPE_NLEN, m, CYMRIC_SHAPE_MLEN);
+#if CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_MLEN != BLOCKBYTES
+    t[CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_MLEN] ^= 0x80;
+#endif
+}
+
+static inline void CYMRIC_SHAPE_FN(cymric1_enc)(uint8_t c[], const uint8_t k[],
+            const uint8_t n[], const uint8_t m[], const uint8_t a[],
+            const cipher_ctx_t* ctx)
+{
+    uint8_t y0[BLOCKBYTES], y1[BLOCKBYTES];
+
+    CYMRIC_SHAPE_FN(y)(y0, y1, k, n, a,
+        (CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_MLEN == BLOCKBYTES) << 7, ctx);
+
+    // C <- M ^ Y0 ^ Y1
+    xor_bytes(y1, y1, y0, CYMRIC_SHAPE_MLEN);
+    xor_bytes(c, y1, m, CYMRIC_SHAPE_MLEN);
+
+    // T <- msb(E_K'(Y0 ^ pad(N||M)))
+    CYMRIC_SHAPE_FN(pad1)(y0, n, m);
+    CYMRIC_SHAPE_FN(tag)(y0, k, ctx);
+    memcpy(c + CYMRIC_SHAPE_MLEN, y0, TAGBYTES);
+}
+
+static inline int CYMRIC_SHAPE_FN(cymric1_dec)(uint8_t m[], const uint8_t k[],
+            const uint8_t n[], const uint8_t c[], const uint8_t a[],
+            const cipher_ctx_t* ctx)
+{
+    uint8_t y0[BLOCKBYTES], y1[BLOCKBYTES];
+
+    CYMRIC_SHAPE_FN(y)(y0, y1, k, n, a,
+        (CYMRIC_SHAPE_NLEN + CYMRIC_SHAPE_MLEN == BLOCKBYTES) << 7, ctx);
+
+    // M <- C ^ Y0 ^ Y1
+    xor_bytes(y1, y1, y0, CYMRIC_SHAPE_MLEN);
+    xor_bytes(m, y1, c, CYMRIC_SHAPE_MLEN);
+
+    // T <- msb(E_K'(Y0 ^ pad(N||M)))
+    CYMRIC_SHAPE_FN(pad1)(y0, n, m);
+    CYMRIC_SHAPE_FN(tag)(y0, k, ctx);
+
+    // do not release plaintext if erroneous tag
+    if (sec_memcmp(y0, c + CYMRIC_SHAPE_MLEN, TAGBYTES) != 0) {
+        memset(m, 0x00, CYMRIC_SHAPE_MLEN);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * @brief T <- Y0 ^ pad(M) for Cymric2.
+ */
+static inline void CYMRIC_SHAPE_FN(pad2)(uint8_t t[BLOCKBYTES], const uint8_t m[])
+{
+    xor_bytes(t, t, m, CYMRIC_SHAPE_MLEN);
+#if CYMRIC_SHAPE_MLEN != BLOCKBYTES
+    t[CYMRIC_SHAPE_MLEN] ^= 0x80;
+#endif
+}
+
+static inline void CYMRIC_SHAPE_FN(cymric2_enc)(uint8_t c[], const uint8_t k[],
+            const uint8_t n[], const uint8_t m[], const uint8_t a[],
+            const cipher_ctx_t* ctx)
+{
+    uint8_t y0[BLOCKBYTES], y1[BLOCKBYTES];
+
+    CYMRIC_SHAPE_FN(y)(y0, y1, k, n, a, (CYMRIC_SHAPE_MLEN == BLOCKBYTES) << 7, ctx);
+
+    // C <- M ^ Y0 ^ Y1
+    xor_bytes(y1, y1, y0, CYMRIC_SHAPE_MLEN);
+    xor_bytes(c, y1, m, CYMRIC_SHAPE_MLEN);
+
+    // T <- msb(E_K'(Y0 ^ pad(M)))
+    CYMRIC_SHAPE_FN(pad2)(y0, m);
+    CYMRIC_SHAPE_FN(tag)(y0, k, ctx);
+    memcpy(c + CYMRIC_SHAPE_MLEN, y0, TAGBYTES);
+}
+
+static inline int CYMRIC_SHAPE_FN(cymric2_dec)(uint8_t m[], const uint8_t k[],
+            const uint8_t n[], const uint8_t c[], const uint8_t a[],
+            const cipher_ctx_t* ctx)
+{
+    uint8_t y0[BLOCKBYTES], y1[BLOCKBYTES];
+
+    CYMRIC_SHAPE_FN(y)(y0, y1, k, n, a, (CYMRIC_SHAPE_MLEN == BLOCKBYTES) << 7, ctx);
+
+    // M <- C ^ Y0 ^ Y1
+    xor_bytes(y1, y1, y0, CYMRIC_SHAPE_MLEN);
+    xor_bytes(m, y1, c, CYMRIC_SHAPE_MLEN);
+
+    // T <- msb(E_K'(Y0 ^ pad(M)))
+    CYMRIC_SHAPE_FN(pad2)(y0, m);
+    CYMRIC_SHAPE_FN(tag)(y0, k, ctx);
+
+    // do not release plaintext if erroneous tag
+    if (sec_memcmp(y0, c + CYMRIC_SHAPE_MLEN, TAGBYTES) != 0) {
+        memset(m, 0x00, CYMRIC_SHAPE_MLEN);
+        return 1;
+    }
+    return 0;
+}
+
+#undef CYMRIC_SHAPE_NAME
+#undef CYMRIC_SHAPE_NLEN
+#undef CYMRIC_SHAPE_ALEN
+#undef CYMRIC_SHAPE_MLEN
@@ -0,0 +1,63 @@
+#ifndef CYMRIC_TRACE_H
+#define CYMRIC_TRACE_H
+
+/**
+ * Optional USDT (user-level statically defined tracing) probes.
+ *
+ * The probes are enabled by defining CYMRIC_USDT at compile time on platforms
+ * providing <sys/sdt.h> (e.g. systemtap-sdt-dev on Linux). Each probe then
+ * compiles to a single NOP which is patched by the tracer (e.g. bpftrace)
+ * when attached, and costs nothing otherwise. The probes compile to nothing
+ * when CYMRIC_USDT is not defined.
+ *
+ * Probes (provider "cymric"):
+ *   enc_entry(variant, nlen, mlen, alen, key)   on entry of cymric*_enc
+ *   enc_return(variant, clen, ret)              on exit of cymric*_enc
+ *   dec_entry(variant, nlen, clen, alen, key)   on entry of cymric*_dec
+ *   dec_return(variant, mlen, ret)              on exit of cymric*_dec
+ *   tag_fail(variant, nlen, clen, alen, key)    on tag verification failure
+ *   batch_enc_entry(variant, count, key)        on entry of cymric*_batch_enc
+ *   batch_enc_return(variant, count, failed)    on exit of cymric*_batch_enc
+ *   batch_dec_entry(variant, count, key)        on entry of cymric*_batch_dec
+ *   batch_dec_return(variant, count, failed)    on exit of cymric*_batch_dec
+ *   key_miss(lane, key, epoch)                  on reload of the round keys of
+ *                                               a lane of the job manager
+ * where variant is 1 for Cymric1 and 2 for Cymric2, and key is the address of
+ * the key material, which identifies a key for as long as it stays in memory
+ * (along with the epoch of cymric_batch_key_t when there is one).
+ */
+
+#if defined(CYMRIC_USDT)
+
+#include <sys/sdt.h>
+
+#define CYMRIC_TRACE_ENTRY(probe, variant, nlen, len, alen, key) \
+    DTRACE_PROBE5(cymric, probe, variant, nlen, len, alen, key)
+
+#define CYMRIC_TRACE_RETURN(probe, variant, len, ret) \
+    DTRACE_PROBE3(cymric, probe, variant, len, ret)
+
+#define CYMRIC_TRACE_TAG_FAIL(variant, nlen, clen, alen, key) \
+    DTRACE_PROBE5(cymric, tag_fail, variant, nlen, clen, alen, key)
+
+#define CYMRIC_TRACE_BATCH_ENTRY(probe, variant, count, key) \
+    DTRACE_PROBE3(cymric, probe, variant, count, key)
+
+#define CYMRIC_TRACE_BATCH_RETURN(probe, variant, count, failed) \
+    DTRACE_PROBE3(cymric, probe, variant, count, failed)
+
+#define CYMRIC_TRACE_KEY_MISS(lane, key, epoch) \
+    DTRACE_PROBE3(cymric, key_miss, lane, key, epoch)
+
+#else
+
+#define CYMRIC_TRACE_ENTRY(probe, variant, nlen, len, alen, key)  do { (void)(variant); } while (0)
+#define CYMRIC_TRACE_RETURN(probe, variant, len, ret)             do { (void)(variant); } while (0)
+#define CYMRIC_TRACE_TAG_FAIL(variant, nlen, clen, alen, key)     do { (void)(variant); } while (0)
+#define CYMRIC_TRACE_BATCH_ENTRY(probe, variant, count, key)      do { (void)(variant); } while (0)
+#define CYMRIC_TRACE_BATCH_RETURN(probe, variant, count, failed)  do { (void)(variant); } while (0)
+#define CYMRIC_TRACE_KEY_MISS(lane, key, epoch)                   do { (void)(lane); } while (0)
+
+#endif /* CYMRIC_USDT */
+
+#endif /* CYMRIC_TRACE_H */